@@ -0,0 +1,146 @@
+#include "common.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __APPLE__
+# include <mach/mach.h>
+# include <mach/mach_time.h>
+#endif
+
+#ifdef __GLIBC__
+// glibc exports its allocator under these names, which lets us
+// count allocations by interposing the public symbols.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+}
+
+static volatile uint64_t alloc_count = 0;
+
+extern "C" void* malloc(size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_malloc(size);
+}
+
+
+extern "C" void* calloc(size_t n, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_calloc(n, size);
+}
+
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_realloc(ptr, size);
+}
+#endif // __GLIBC__
+
+namespace vock {
+namespace bench {
+
+uint64_t NowNs() {
+#ifdef __APPLE__
+  static mach_timebase_info_data_t info;
+  if (info.denom == 0) mach_timebase_info(&info);
+  return mach_absolute_time() * info.numer / info.denom;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+uint64_t ThreadCpuNs() {
+#ifdef __APPLE__
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  mach_port_t thread = mach_thread_self();
+  kern_return_t r = thread_info(thread,
+                                THREAD_BASIC_INFO,
+                                reinterpret_cast<thread_info_t>(&info),
+                                &count);
+  mach_port_deallocate(mach_task_self(), thread);
+  if (r != KERN_SUCCESS) return 0;
+
+  return (info.user_time.seconds + info.system_time.seconds) * 1000000000ULL +
+         (info.user_time.microseconds + info.system_time.microseconds) * 1000ULL;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+uint64_t ThreadCpuNs(pthread_t thread) {
+#ifdef __APPLE__
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  kern_return_t r = thread_info(pthread_mach_thread_np(thread),
+                                THREAD_BASIC_INFO,
+                                reinterpret_cast<thread_info_t>(&info),
+                                &count);
+  if (r != KERN_SUCCESS) return 0;
+
+  return (info.user_time.seconds + info.system_time.seconds) * 1000000000ULL +
+         (info.user_time.microseconds + info.system_time.microseconds) * 1000ULL;
+#else
+  clockid_t id;
+  struct timespec ts;
+  if (pthread_getcpuclockid(thread, &id) != 0) return 0;
+  if (clock_gettime(id, &ts) != 0) return 0;
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+uint64_t AllocCount() {
+#ifdef __GLIBC__
+  return alloc_count;
+#else
+  return 0;
+#endif
+}
+
+
+bool AllocCountSupported() {
+#ifdef __GLIBC__
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+Report::Report(const char* bench) : out_(stdout) {
+  fprintf(out_, "{\"bench\":\"%s\"", bench);
+}
+
+
+Report::~Report() {
+  fprintf(out_, "}\n");
+  fflush(out_);
+}
+
+
+void Report::Str(const char* key, const char* value) {
+  fprintf(out_, ",\"%s\":\"%s\"", key, value);
+}
+
+
+void Report::Int(const char* key, int64_t value) {
+  fprintf(out_, ",\"%s\":%lld", key, static_cast<long long>(value));
+}
+
+
+void Report::Num(const char* key, double value) {
+  fprintf(out_, ",\"%s\":%.3f", key, value);
+}
+
+} // namespace bench
+} // namespace vock
@@ -0,0 +1,41 @@
+#ifndef _BENCH_COMMON_H_
+#define _BENCH_COMMON_H_
+
+#include <stdint.h>
+#include <stdio.h> // FILE
+#include <pthread.h>
+
+namespace vock {
+namespace bench {
+
+// Monotonic wall clock, in nanoseconds
+uint64_t NowNs();
+
+// CPU time consumed by the calling (or given) thread, in nanoseconds
+uint64_t ThreadCpuNs();
+uint64_t ThreadCpuNs(pthread_t thread);
+
+// Number of malloc/calloc/realloc calls made so far by the process
+// (always 0 where allocations can't be intercepted, see common.cc)
+uint64_t AllocCount();
+bool AllocCountSupported();
+
+// Results are printed as one JSON object per line, so they can be
+// collected and compared by scripts
+class Report {
+ public:
+  explicit Report(const char* bench);
+  ~Report();
+
+  void Str(const char* key, const char* value);
+  void Int(const char* key, int64_t value);
+  void Num(const char* key, double value);
+
+ protected:
+  FILE* out_;
+};
+
+} // namespace bench
+} // namespace vock
+
+#endif // _BENCH_COMMON_H_
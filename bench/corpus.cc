@@ -0,0 +1,144 @@
+#include "corpus.h"
+
+#include <math.h>
+#include <string.h> // memset
+
+namespace vock {
+namespace bench {
+
+// Tiny LCG, good enough for noise and reproducible everywhere
+static inline uint32_t Random(uint32_t* state) {
+  *state = *state * 1664525 + 1013904223;
+  return *state;
+}
+
+
+static inline double Uniform(uint32_t* state) {
+  return (Random(state) >> 8) / 8388608.0 - 1.0;
+}
+
+
+Corpus::Corpus(Kind kind, int rate, double seconds)
+    : rate_(rate),
+      length_(static_cast<size_t>(rate * seconds)) {
+  data_ = new int16_t[length_];
+  float_data_ = new float[length_];
+  memset(data_, 0, length_ * sizeof(*data_));
+
+  if (kind == kSpeech) {
+    Speech(data_, length_, 1, 120.0);
+  } else if (kind == kNoise) {
+    Noise(data_, length_, 7);
+  } else if (kind == kBabble) {
+    int16_t* tmp = new int16_t[length_];
+    static const double pitches[] = { 110.0, 150.0, 210.0, 95.0 };
+
+    for (int i = 0; i < 4; i++) {
+      Speech(tmp, length_, 100 + i, pitches[i]);
+      for (size_t j = 0; j < length_; j++) data_[j] += tmp[j] / 4;
+    }
+    delete[] tmp;
+  }
+
+  for (size_t i = 0; i < length_; i++) {
+    float_data_[i] = data_[i] / 32768.0f;
+  }
+}
+
+
+Corpus::~Corpus() {
+  delete[] data_;
+  delete[] float_data_;
+}
+
+
+const char* Corpus::Name(Kind kind) {
+  switch (kind) {
+   case kSpeech: return "speech";
+   case kNoise: return "noise";
+   case kBabble: return "babble";
+   case kSilence: return "silence";
+   default: return "unknown";
+  }
+}
+
+
+// Glottal pulse train with slowly varying pitch, filtered by three
+// formant resonators that move every syllable (~200ms). Every third
+// syllable is unvoiced (fricative noise) and every fifth is a pause.
+void Corpus::Speech(int16_t* out, size_t len, uint32_t seed, double pitch) {
+  static const double formants[][3] = {
+    { 730, 1090, 2440 },  // a
+    { 270, 2290, 3010 },  // i
+    { 300, 870, 2240 },  // u
+    { 530, 1840, 2480 },  // e
+    { 570, 840, 2410 }  // o
+  };
+  uint32_t state = seed;
+  size_t syllable = rate_ / 5;
+  double phase = 0;
+  double y1[3] = { 0, 0, 0 };
+  double y2[3] = { 0, 0, 0 };
+
+  for (size_t i = 0; i < len; i++) {
+    size_t index = i / syllable;
+    double t = static_cast<double>(i % syllable) / syllable;
+    const double* f = formants[(index * 7 + seed) % 5];
+
+    // Syllabic envelope
+    double env = sin(M_PI * t);
+    if (index % 5 == 4) env = 0;
+
+    // Excitation
+    double excitation;
+    if (index % 3 == 2) {
+      excitation = Uniform(&state) * 0.3;
+    } else {
+      double f0 = pitch * (1.0 + 0.1 * sin(2 * M_PI * i / (rate_ * 1.3)));
+      phase += f0 / rate_;
+      excitation = 0;
+      if (phase >= 1.0) {
+        phase -= 1.0;
+        excitation = 1.0;
+      }
+    }
+
+    // Formant filters in parallel
+    double sample = 0;
+    for (int k = 0; k < 3; k++) {
+      double r = exp(-M_PI * 80.0 * (k + 1) / rate_);
+      double c = 2 * r * cos(2 * M_PI * f[k] / rate_);
+      double y = excitation + c * y1[k] - r * r * y2[k];
+      y2[k] = y1[k];
+      y1[k] = y;
+      sample += y / (k + 1);
+    }
+
+    sample *= env * 1200.0;
+    if (sample > 32767) sample = 32767;
+    if (sample < -32768) sample = -32768;
+    out[i] = static_cast<int16_t>(sample);
+  }
+}
+
+
+// Paul Kellet's economy pink noise filter over white noise
+void Corpus::Noise(int16_t* out, size_t len, uint32_t seed) {
+  uint32_t state = seed;
+  double b0 = 0;
+  double b1 = 0;
+  double b2 = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    double white = Uniform(&state);
+    b0 = 0.99765 * b0 + white * 0.0990460;
+    b1 = 0.96300 * b1 + white * 0.2965164;
+    b2 = 0.57000 * b2 + white * 1.0526913;
+    double pink = b0 + b1 + b2 + white * 0.1848;
+
+    out[i] = static_cast<int16_t>(pink * 2000.0);
+  }
+}
+
+} // namespace bench
+} // namespace vock
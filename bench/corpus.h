@@ -0,0 +1,45 @@
+#ifndef _BENCH_CORPUS_H_
+#define _BENCH_CORPUS_H_
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace bench {
+
+// Deterministic test signals. Shipping recordings would bloat the npm
+// package, so the corpus is synthesized: it is reproducible bit-for-bit
+// on every machine, which is what regression gating needs.
+class Corpus {
+ public:
+  enum Kind {
+    kSpeech,  // voiced/unvoiced segments with pauses
+    kNoise,   // pink-ish background noise
+    kBabble,  // several overlapping talkers
+    kSilence  // digital silence (DTX/VAD path)
+  };
+
+  Corpus(Kind kind, int rate, double seconds);
+  ~Corpus();
+
+  static const char* Name(Kind kind);
+
+  inline const int16_t* data() const { return data_; }
+  inline const float* float_data() const { return float_data_; }
+  inline size_t length() const { return length_; }
+  inline int rate() const { return rate_; }
+
+ protected:
+  void Speech(int16_t* out, size_t len, uint32_t seed, double pitch);
+  void Noise(int16_t* out, size_t len, uint32_t seed);
+
+  int rate_;
+  size_t length_;
+  int16_t* data_;
+  float* float_data_;
+};
+
+} // namespace bench
+} // namespace vock
+
+#endif // _BENCH_CORPUS_H_
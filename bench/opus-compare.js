@@ -0,0 +1,71 @@
+#!/usr/bin/env node
+// vim:syntax=javascript
+
+//
+// Runs vock_bench (default opus build, float with SIMD kernels on x86) and
+// vock_bench_fixed (fixed point opus) with the same arguments and prints
+// their throughput side by side, one JSON object per configuration.
+//
+// Usage: bench/opus-compare.js [seconds-of-audio] [--quick]
+//
+var path = require('path'),
+    execFile = require('child_process').execFile;
+
+var build = path.resolve(__dirname, '..', 'build', 'Release'),
+    args = process.argv.slice(2);
+
+// Settings that identify one configuration in both outputs
+var keys = [ 'api', 'corpus', 'bitrate', 'complexity', 'frame_ms', 'fec' ];
+
+function run(name, callback) {
+  execFile(path.join(build, name), args, {
+    maxBuffer: 16 * 1024 * 1024
+  }, function(err, stdout) {
+    if (err) return callback(err);
+
+    var results = {};
+    stdout.split(/\n/g).forEach(function(line) {
+      if (!line) return;
+      var r = JSON.parse(line);
+      results[keys.map(function(key) { return r[key]; }).join(':')] = r;
+    });
+    callback(null, results);
+  });
+}
+
+function ratio(a, b) {
+  return Math.round(a / b * 1000) / 1000;
+}
+
+run('vock_bench', function(err, fast) {
+  if (err) throw err;
+
+  run('vock_bench_fixed', function(err, fixed) {
+    if (err) throw err;
+
+    Object.keys(fast).forEach(function(id) {
+      var a = fast[id],
+          b = fixed[id];
+      if (!b) return;
+
+      var out = { bench: 'opus_compare' };
+      keys.forEach(function(key) {
+        out[key] = a[key];
+      });
+      out.build = a.build;
+      out.simd = a.simd;
+      out.encode_ns = a.encode_ns;
+      out.fixed_encode_ns = b.encode_ns;
+      out.decode_ns = a.decode_ns;
+      out.fixed_decode_ns = b.decode_ns;
+
+      // > 1 when the default build is faster than fixed point one
+      out.encode_speedup = ratio(b.encode_ns, a.encode_ns);
+      out.decode_speedup = ratio(b.decode_ns, a.decode_ns);
+      out.speedup = ratio(b.encode_ns + b.decode_ns,
+                          a.encode_ns + a.decode_ns);
+
+      console.log(JSON.stringify(out));
+    });
+  });
+});
@@ -0,0 +1,219 @@
+#include "common.h"
+#include "corpus.h"
+#include "codec.h"
+#include "opus.h"
+
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> // atof, abort
+#include <string.h> // strcmp, strstr
+
+namespace vock {
+namespace bench {
+
+using vock::opus::Codec;
+
+static const int kRate = 48000;
+
+struct Settings {
+  opus_int32 bitrate;
+  int complexity;
+  int frame_ms;
+  int fec;
+};
+
+enum Api {
+  kCodecApi,       // vock::opus::Codec, what `Opus` binding uses
+  kCodecFloatApi,  // same, float entry points
+  kRawApi          // libopus directly
+};
+
+static const char* ApiName(Api api) {
+  switch (api) {
+   case kCodecApi: return "codec";
+   case kCodecFloatApi: return "codec_float";
+   case kRawApi: return "raw";
+   default: return "unknown";
+  }
+}
+
+
+static const char* SimdName() {
+#ifdef OPUS_X86_SIMD
+  return opus_simd_get()->name;
+#else
+  return "none";
+#endif
+}
+
+
+// "fixed" or "float", libopus tags fixed point builds in its version string
+static const char* BuildName() {
+  return strstr(opus_get_version_string(), "-fixed") != NULL ? "fixed" :
+                                                               "float";
+}
+
+
+static void Configure(OpusEncoder* enc, const Settings& s) {
+  if (opus_encoder_ctl(enc, OPUS_SET_BITRATE(s.bitrate)) != OPUS_OK ||
+      opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(s.complexity)) != OPUS_OK ||
+      opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(s.fec)) != OPUS_OK ||
+      opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(s.fec ? 10 : 0)) !=
+          OPUS_OK) {
+    fprintf(stderr, "Failed to configure encoder!\n");
+    abort();
+  }
+}
+
+
+static void Run(const Corpus& corpus,
+                Corpus::Kind kind,
+                Api api,
+                const Settings& s) {
+  Codec codec(kRate, 1);
+  OpusEncoder* enc;
+  OpusDecoder* dec;
+  int err;
+
+  if (api == kRawApi) {
+    enc = opus_encoder_create(kRate, 1, OPUS_APPLICATION_VOIP, &err);
+    if (err != OPUS_OK) abort();
+    dec = opus_decoder_create(kRate, 1, &err);
+    if (err != OPUS_OK) abort();
+  } else {
+    if (codec.Init() != OPUS_OK) abort();
+    enc = codec.encoder();
+    dec = codec.decoder();
+  }
+  Configure(enc, s);
+
+  int frame = kRate * s.frame_ms / 1000;
+  size_t frames = corpus.length() / frame;
+  unsigned char packet[4000];
+  opus_int16 pcm[kRate * 60 / 1000];
+  float fpcm[kRate * 60 / 1000];
+
+  uint64_t enc_ns = 0;
+  uint64_t dec_ns = 0;
+  uint64_t bytes = 0;
+  uint64_t allocs = AllocCount();
+  uint64_t cpu = ThreadCpuNs();
+
+  for (size_t i = 0; i < frames; i++) {
+    const opus_int16* in = corpus.data() + i * frame;
+    const float* fin = corpus.float_data() + i * frame;
+    opus_int32 len;
+    int samples;
+
+    uint64_t start = NowNs();
+    if (api == kCodecApi) {
+      len = codec.Encode(in, frame, packet, sizeof(packet));
+    } else if (api == kCodecFloatApi) {
+      len = codec.EncodeFloat(fin, frame, packet, sizeof(packet));
+    } else {
+      len = opus_encode(enc, in, frame, packet, sizeof(packet));
+    }
+    uint64_t mid = NowNs();
+    if (api == kCodecApi) {
+      samples = codec.Decode(packet, len, pcm, frame);
+    } else if (api == kCodecFloatApi) {
+      samples = codec.DecodeFloat(packet, len, fpcm, frame);
+    } else {
+      samples = opus_decode(dec, packet, len, pcm, frame, 0);
+    }
+    uint64_t end = NowNs();
+
+    if (len < 0 || samples != frame) {
+      fprintf(stderr, "Opus failed: %s\n", opus_strerror(len));
+      abort();
+    }
+
+    enc_ns += mid - start;
+    dec_ns += end - mid;
+    bytes += len;
+  }
+
+  cpu = ThreadCpuNs() - cpu;
+  allocs = AllocCount() - allocs;
+  double audio_ns = 1e9 * frames * frame / kRate;
+
+  {
+    Report r("opus");
+    r.Str("api", ApiName(api));
+    r.Str("corpus", Corpus::Name(kind));
+    r.Str("build", BuildName());
+    r.Str("simd", SimdName());
+    r.Int("rate", kRate);
+    r.Int("bitrate", s.bitrate);
+    r.Int("complexity", s.complexity);
+    r.Int("frame_ms", s.frame_ms);
+    r.Int("fec", s.fec);
+    r.Int("frames", frames);
+    r.Num("encode_ns", static_cast<double>(enc_ns) / frames);
+    r.Num("decode_ns", static_cast<double>(dec_ns) / frames);
+    r.Num("rtf", (enc_ns + dec_ns) / audio_ns);
+    r.Num("cpu_rtf", cpu / audio_ns);
+    r.Num("kbps", bytes * 8.0 / (audio_ns / 1e9) / 1000.0);
+    if (AllocCountSupported()) {
+      r.Int("allocs", allocs);
+    }
+  }
+
+  if (api == kRawApi) {
+    opus_encoder_destroy(enc);
+    opus_decoder_destroy(dec);
+  }
+}
+
+} // namespace bench
+} // namespace vock
+
+
+int main(int argc, char** argv) {
+  using namespace vock::bench;
+
+  // Usage: vock_bench [seconds-of-audio] [--quick]
+  double seconds = 10;
+  bool quick = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      quick = true;
+    } else {
+      seconds = atof(argv[i]);
+    }
+  }
+  if (seconds <= 0) seconds = 10;
+
+  // Settings vock runs with (see lib/vock/audio.js and rate controller)
+  static const opus_int32 bitrates[] = { OPUS_AUTO, 16000, 32000 };
+  static const int complexities[] = { 5, 10 };
+  static const int frame_sizes[] = { 10, 20, 40, 60 };
+  static const int fecs[] = { 0, 1 };
+  static const Api apis[] = { kCodecApi, kCodecFloatApi, kRawApi };
+  static const Corpus::Kind kinds[] = { Corpus::kSpeech, Corpus::kNoise };
+
+  for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+    Corpus corpus(kinds[k], kRate, seconds);
+
+    for (size_t a = 0; a < sizeof(apis) / sizeof(apis[0]); a++)
+    for (size_t b = 0; b < sizeof(bitrates) / sizeof(bitrates[0]); b++)
+    for (size_t c = 0; c < sizeof(complexities) / sizeof(complexities[0]); c++)
+    for (size_t f = 0; f < sizeof(frame_sizes) / sizeof(frame_sizes[0]); f++)
+    for (size_t e = 0; e < sizeof(fecs) / sizeof(fecs[0]); e++) {
+      Settings s = { bitrates[b], complexities[c], frame_sizes[f], fecs[e] };
+
+      // Only the default configuration in quick mode
+      if (quick && (s.bitrate != OPUS_AUTO || s.complexity != 10 ||
+                    s.frame_ms != 20 || s.fec != 0)) {
+        continue;
+      }
+
+      Run(corpus, kinds[k], apis[a], s);
+    }
+  }
+
+  return 0;
+}
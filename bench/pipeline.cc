@@ -0,0 +1,339 @@
+#include "common.h"
+#include "unit.h"
+#include "uv.h"
+
+#include <algorithm> // std::sort
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h> // atof, abort
+#include <string.h> // memset
+
+namespace vock {
+namespace bench {
+
+using vock::audio::HALUnit;
+using vock::audio::PlatformUnit;
+using vock::audio::SampleFormat;
+using vock::audio::kInt16Format;
+using vock::audio::kFloat32Format;
+
+// Built against system libuv (see binding.gyp): callbacks lost their
+// status argument in 1.x
+#if UV_VERSION_MAJOR >= 1
+# define UV_CB_STATUS
+#else
+# define UV_CB_STATUS , int status
+#endif
+
+// Mirrors lib/vock/audio.js
+static const int kRate = 48000;
+
+// Capture and playback impulses alternate, each one every 400ms. The
+// 200ms offset is beyond the 150ms echo tail, so the canceller can't
+// take the capture impulse for an echo of the playback one.
+static const int kImpulseIntervalMs = 400;
+
+// Impulse: 2ms of loud square wave. The preprocessor attenuates it to
+// roughly -20dB, while silence stays below -50dB. Capture and playback
+// ones have different frequencies (3kHz and 4.8kHz) to not correlate.
+static const int kImpulseSamples = kRate / 500;
+static const int kCaptureHalfPeriod = 8;
+static const int kPlaybackHalfPeriod = 5;
+static const double kImpulseLevel = 0.5;
+static const double kThreshold = 0.02;
+
+class Harness {
+ public:
+  Harness(SampleFormat format, double seconds, double cancel_rate);
+  ~Harness();
+
+  void Run();
+
+ protected:
+  static void Capture(void* arg, char* out, size_t size);
+  static void Playback(void* arg, const char* data, size_t size);
+  static void OnInput(uv_async_t* async UV_CB_STATUS);
+  static void OnReady(uv_async_t* async UV_CB_STATUS);
+  static void OnTick(uv_timer_t* timer UV_CB_STATUS);
+  static void OnClose(uv_handle_t* handle);
+
+  void FillImpulse(char* out, size_t samples, int half_period);
+  bool HasImpulse(const char* data, size_t samples);
+  void ReportLatency(Report* r, const char* name, std::vector<uint64_t>* v);
+
+  SampleFormat format_;
+  double cancel_rate_;
+  size_t sample_size_;
+  size_t frame_size_;
+  uint64_t duration_;
+  uint64_t started_;
+  int ticks_;
+
+  uv_loop_t* loop_;
+  uv_async_t in_async_;
+  uv_async_t inready_async_;
+  uv_async_t outready_async_;
+  uv_timer_t timer_;
+  HALUnit* unit_;
+  char* frame_;
+
+  // Shared with device threads
+  uint64_t capture_stamp_;
+  bool capture_request_;
+  uv_mutex_t capture_mutex_;
+  uint64_t playback_stamp_;
+  uv_mutex_t playback_mutex_;
+
+  std::vector<uint64_t> capture_latency_;
+  std::vector<uint64_t> playback_latency_;
+};
+
+
+Harness::Harness(SampleFormat format, double seconds, double cancel_rate)
+    : format_(format),
+      cancel_rate_(cancel_rate),
+      sample_size_(audio::SampleSize(format)),
+      frame_size_(kRate / 50 * audio::SampleSize(format)),
+      duration_(static_cast<uint64_t>(seconds * 1e9)),
+      ticks_(0),
+      loop_(uv_default_loop()),
+      capture_stamp_(0),
+      capture_request_(false),
+      playback_stamp_(0) {
+  if (uv_async_init(loop_, &in_async_, OnInput) ||
+      uv_async_init(loop_, &inready_async_, OnReady) ||
+      uv_async_init(loop_, &outready_async_, OnReady) ||
+      uv_timer_init(loop_, &timer_)) {
+    abort();
+  }
+  in_async_.data = this;
+  timer_.data = this;
+  uv_mutex_init(&capture_mutex_);
+  uv_mutex_init(&playback_mutex_);
+
+  frame_ = new char[frame_size_];
+  unit_ = new HALUnit(kRate,
+                      frame_size_,
+                      kRate / 500 * sample_size_,
+                      format,
+                      cancel_rate_,
+                      &in_async_,
+                      &inready_async_,
+                      &outready_async_);
+  unit_->input_unit()->SetCaptureSource(Capture, this);
+  unit_->output_unit()->SetPlaybackSink(Playback, this);
+}
+
+
+Harness::~Harness() {
+  delete unit_;
+  delete[] frame_;
+  uv_mutex_destroy(&capture_mutex_);
+  uv_mutex_destroy(&playback_mutex_);
+}
+
+
+void Harness::FillImpulse(char* out, size_t samples, int half_period) {
+  for (size_t i = 0; i < samples; i++) {
+    double v = (i / half_period) % 2 == 0 ? kImpulseLevel : -kImpulseLevel;
+    if (format_ == kFloat32Format) {
+      reinterpret_cast<float*>(out)[i] = v;
+    } else {
+      reinterpret_cast<int16_t*>(out)[i] = static_cast<int16_t>(v * 32767);
+    }
+  }
+}
+
+
+bool Harness::HasImpulse(const char* data, size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    double v;
+    if (format_ == kFloat32Format) {
+      v = reinterpret_cast<const float*>(data)[i];
+    } else {
+      v = reinterpret_cast<const int16_t*>(data)[i] / 32768.0;
+    }
+    if (v > kThreshold || v < -kThreshold) return true;
+  }
+  return false;
+}
+
+
+// Input device thread
+void Harness::Capture(void* arg, char* out, size_t size) {
+  Harness* h = reinterpret_cast<Harness*>(arg);
+
+  memset(out, 0, size);
+
+  uv_mutex_lock(&h->capture_mutex_);
+  if (h->capture_request_) {
+    h->capture_request_ = false;
+    h->capture_stamp_ = NowNs();
+    h->FillImpulse(out, kImpulseSamples, kCaptureHalfPeriod);
+  }
+  uv_mutex_unlock(&h->capture_mutex_);
+}
+
+
+// Output device thread, right after HALUnit::OutputCallback
+void Harness::Playback(void* arg, const char* data, size_t size) {
+  Harness* h = reinterpret_cast<Harness*>(arg);
+  uint64_t now = NowNs();
+
+  if (!h->HasImpulse(data, size / h->sample_size_)) return;
+
+  uv_mutex_lock(&h->playback_mutex_);
+  if (h->playback_stamp_ != 0) {
+    h->playback_latency_.push_back(now - h->playback_stamp_);
+    h->playback_stamp_ = 0;
+  }
+  uv_mutex_unlock(&h->playback_mutex_);
+}
+
+
+// Event loop: frame delivered by canceller thread via uv_async_send
+void Harness::OnInput(uv_async_t* async UV_CB_STATUS) {
+  Harness* h = reinterpret_cast<Harness*>(async->data);
+  uint64_t now = NowNs();
+
+  while (h->unit_->Read(h->frame_, h->frame_size_)) {
+    if (!h->HasImpulse(h->frame_, h->frame_size_ / h->sample_size_)) continue;
+
+    uv_mutex_lock(&h->capture_mutex_);
+    if (h->capture_stamp_ != 0) {
+      h->capture_latency_.push_back(now - h->capture_stamp_);
+      h->capture_stamp_ = 0;
+    }
+    uv_mutex_unlock(&h->capture_mutex_);
+  }
+}
+
+
+void Harness::OnReady(uv_async_t* async UV_CB_STATUS) {
+}
+
+
+void Harness::OnTick(uv_timer_t* timer UV_CB_STATUS) {
+  Harness* h = reinterpret_cast<Harness*>(timer->data);
+
+  // Let AEC and AGC settle before first measurement
+  int tick = h->ticks_++;
+  if (tick < 5) return;
+
+  if (NowNs() - h->started_ > h->duration_) {
+    h->unit_->Stop();
+    uv_timer_stop(&h->timer_);
+    uv_close(reinterpret_cast<uv_handle_t*>(&h->timer_), OnClose);
+    uv_close(reinterpret_cast<uv_handle_t*>(&h->in_async_), OnClose);
+    uv_close(reinterpret_cast<uv_handle_t*>(&h->inready_async_), OnClose);
+    uv_close(reinterpret_cast<uv_handle_t*>(&h->outready_async_), OnClose);
+    return;
+  }
+
+  // Capture impulse, stamped on the device thread
+  if (tick % 2 == 1) {
+    uv_mutex_lock(&h->capture_mutex_);
+    h->capture_request_ = true;
+    uv_mutex_unlock(&h->capture_mutex_);
+    return;
+  }
+
+  // Playback impulse
+  memset(h->frame_, 0, h->frame_size_);
+  h->FillImpulse(h->frame_, kImpulseSamples, kPlaybackHalfPeriod);
+  uv_mutex_lock(&h->playback_mutex_);
+  h->playback_stamp_ = NowNs();
+  uv_mutex_unlock(&h->playback_mutex_);
+  h->unit_->Put(0, h->frame_, h->frame_size_);
+}
+
+
+void Harness::OnClose(uv_handle_t* handle) {
+}
+
+
+void Harness::ReportLatency(Report* r,
+                            const char* name,
+                            std::vector<uint64_t>* v) {
+  char key[64];
+
+  std::sort(v->begin(), v->end());
+  snprintf(key, sizeof(key), "%s_count", name);
+  r->Int(key, v->size());
+  if (v->empty()) return;
+
+  snprintf(key, sizeof(key), "%s_p50_us", name);
+  r->Num(key, (*v)[v->size() / 2] / 1e3);
+  snprintf(key, sizeof(key), "%s_p95_us", name);
+  r->Num(key, (*v)[v->size() * 95 / 100] / 1e3);
+  snprintf(key, sizeof(key), "%s_max_us", name);
+  r->Num(key, v->back() / 1e3);
+}
+
+
+void Harness::Run() {
+  pthread_t in_thread = *unit_->input_unit()->thread();
+  pthread_t out_thread = *unit_->output_unit()->thread();
+  pthread_t aec_thread = *unit_->canceller_thread();
+
+  uint64_t cpu_in = ThreadCpuNs(in_thread);
+  uint64_t cpu_out = ThreadCpuNs(out_thread);
+  uint64_t cpu_aec = ThreadCpuNs(aec_thread);
+  uint64_t cpu_loop = ThreadCpuNs();
+
+  started_ = NowNs();
+  unit_->Start();
+  uv_timer_start(&timer_,
+                 OnTick,
+                 kImpulseIntervalMs / 2,
+                 kImpulseIntervalMs / 2);
+  uv_run(loop_, UV_RUN_DEFAULT);
+
+  double seconds = (NowNs() - started_) / 1e9;
+  cpu_in = ThreadCpuNs(in_thread) - cpu_in;
+  cpu_out = ThreadCpuNs(out_thread) - cpu_out;
+  cpu_aec = ThreadCpuNs(aec_thread) - cpu_aec;
+  cpu_loop = ThreadCpuNs() - cpu_loop;
+
+  Report r("pipeline");
+  r.Str("format", format_ == kFloat32Format ? "float" : "int16");
+  r.Int("rate", kRate);
+  r.Int("frame_size", frame_size_);
+  r.Num("cancel_rate", cancel_rate_);
+  ReportLatency(&r, "capture", &capture_latency_);
+  ReportLatency(&r, "playback", &playback_latency_);
+
+  // CPU milliseconds per second of audio, per thread
+  r.Num("cpu_input_ms", cpu_in / 1e6 / seconds);
+  r.Num("cpu_output_ms", cpu_out / 1e6 / seconds);
+  r.Num("cpu_canceller_ms", cpu_aec / 1e6 / seconds);
+  r.Num("cpu_loop_ms", cpu_loop / 1e6 / seconds);
+}
+
+} // namespace bench
+} // namespace vock
+
+
+int main(int argc, char** argv) {
+  using namespace vock::bench;
+
+  // Usage: vock_bench_pipeline [seconds]
+  double seconds = argc > 1 ? atof(argv[1]) : 10;
+  if (seconds <= 0) seconds = 10;
+
+  {
+    Harness h(vock::audio::kInt16Format, seconds, kRate);
+    h.Run();
+  }
+  {
+    Harness h(vock::audio::kFloat32Format, seconds, kRate);
+    h.Run();
+  }
+  {
+    // Echo canceller on the 16kHz low band
+    Harness h(vock::audio::kInt16Format, seconds, kRate / 3);
+    h.Run();
+  }
+
+  return 0;
+}
@@ -13,15 +13,31 @@
         "src/audio",
         "deps/opus/opus/include",
         "deps/speex/speex/include",
+        # OpenSSL bundled with node, its symbols are exported by node binary
+        "<(node_root_dir)/deps/openssl/openssl/include",
       ],
 
       "libraries": [ "-lpthread" ],
 
       "sources": [
+        "src/frame/aead.cc",
+        "src/opus/codec.cc",
         "src/opus/binding.cc",
         "src/audio/portaudio/pa_ringbuffer.c",
         "src/audio/unit.cc",
+        "src/audio/delay.cc",
+        "src/audio/band.cc",
+        "src/audio/playout.cc",
+        "src/audio/stretch.cc",
         "src/audio/binding.cc",
+        "src/frame/binding.cc",
+        "src/udp/socket.cc",
+        "src/udp/binding.cc",
+        "src/relay/relay.cc",
+        "src/relay/binding.cc",
+        "src/mcu/room.cc",
+        "src/mcu/mixer.cc",
+        "src/mcu/binding.cc",
         "src/vock.cc",
       ],
       "conditions": [
@@ -36,6 +52,93 @@
           "defines": [ "__PLATFORM_LINUX__" ]
         }]
       ]
+    },
+    {
+      "target_name": "vock_bench",
+      "type": "executable",
+      "dependencies": [
+        "deps/opus/opus.gyp:opus",
+      ],
+
+      "include_dirs": [
+        "src/opus",
+        "deps/opus/opus/include",
+      ],
+
+      "sources": [
+        "bench/common.cc",
+        "bench/corpus.cc",
+        "bench/opus.cc",
+        "src/opus/codec.cc",
+      ],
+      "conditions": [
+        ["OS=='linux'", {
+          "libraries": [ "-lm", "-lrt" ],
+        }]
+      ]
+    },
+    {
+      # Same benchmark on top of fixed point opus, to compare against
+      # vock_bench (float with SIMD kernels on x86)
+      "target_name": "vock_bench_fixed",
+      "type": "executable",
+      "dependencies": [
+        "deps/opus/opus.gyp:opus_fixed",
+      ],
+
+      "include_dirs": [
+        "src/opus",
+        "deps/opus/opus/include",
+      ],
+
+      "sources": [
+        "bench/common.cc",
+        "bench/corpus.cc",
+        "bench/opus.cc",
+        "src/opus/codec.cc",
+      ],
+      "conditions": [
+        ["OS=='linux'", {
+          "libraries": [ "-lm", "-lrt" ],
+        }]
+      ]
+    },
+    {
+      "target_name": "vock_bench_pipeline",
+      "type": "executable",
+      "dependencies": [
+        "deps/speex/speex.gyp:speex",
+      ],
+
+      "include_dirs": [
+        "src",
+        "src/audio",
+        "deps/speex/speex/include",
+      ],
+
+      # Runs HALUnit outside of node, on top of system libuv. Its headers
+      # must be used too: node's uv.h (added by node-gyp to every target)
+      # doesn't match the library.
+      "include_dirs/": [
+        [ "exclude", "(deps/uv/include|include/node)$" ],
+      ],
+      "libraries": [ "-luv", "-lpthread" ],
+      "defines": [ "__PLATFORM_NULL__" ],
+
+      "sources": [
+        "bench/common.cc",
+        "bench/pipeline.cc",
+        "src/audio/portaudio/pa_ringbuffer.c",
+        "src/audio/unit.cc",
+        "src/audio/delay.cc",
+        "src/audio/band.cc",
+        "src/audio/platform/null.cc",
+      ],
+      "conditions": [
+        ["OS=='linux'", {
+          "libraries": [ "-lm", "-lrt" ],
+        }]
+      ]
     }
   ]
 }
@@ -51,6 +51,10 @@
 #include <math.h>
 #include "os_support.h"
 #include "mathops.h"
+
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
 #include "stack_alloc.h"
 
 #ifdef CUSTOM_MODES
@@ -163,6 +167,9 @@ void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar
       }
    }
    /* Pre-rotation */
+#ifdef OPUS_X86_SIMD
+   opus_simd_get()->mdct_rotate(f, &l->trig[0], N4, shift, sine, 1);
+#else
    {
       kiss_fft_scalar * OPUS_RESTRICT yp = f;
       const kiss_twiddle_scalar *t = &l->trig[0];
@@ -178,6 +185,7 @@ void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar
          *yp++ = yi - S_MUL(yr,sine);
       }
    }
+#endif
 
    /* N/4 complex FFT, down-scales by 4/N */
    opus_fft(l->kfft[shift], (kiss_fft_cpx *)f, (kiss_fft_cpx *)in);
@@ -252,6 +260,9 @@ void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scala
    opus_ifft(l->kfft[shift], (kiss_fft_cpx *)f2, (kiss_fft_cpx *)f);
 
    /* Post-rotate */
+#ifdef OPUS_X86_SIMD
+   opus_simd_get()->mdct_rotate(f, &l->trig[0], N4, shift, sine, 0);
+#else
    {
       kiss_fft_scalar * OPUS_RESTRICT fp = f;
       const kiss_twiddle_scalar *t = &l->trig[0];
@@ -269,6 +280,7 @@ void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scala
          *fp++ = yi + S_MUL(yr,sine);
       }
    }
+#endif
    /* De-shuffle the components for the middle of the window only */
    {
       const kiss_fft_scalar * OPUS_RESTRICT fp1 = f;
@@ -42,6 +42,10 @@
 #include "mathops.h"
 #include "celt_lpc.h"
 
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
+
 static void find_best_pitch(opus_val32 *xcorr, opus_val16 *y, int len,
                             int max_pitch, int *best_pitch
 #ifdef FIXED_POINT
@@ -220,6 +224,11 @@ void pitch_search(const opus_val16 * OPUS_RESTRICT x_lp, opus_val16 * OPUS_RESTR
 
    /* Coarse search with 4x decimation */
 
+#ifdef OPUS_X86_SIMD
+   opus_simd_get()->pitch_xcorr(x_lp4, y_lp4, xcorr, len>>2, max_pitch>>2);
+   for (i=0;i<max_pitch>>2;i++)
+      xcorr[i] = MAX32(-1, xcorr[i]);
+#else
    for (i=0;i<max_pitch>>2;i++)
    {
       opus_val32 sum = 0;
@@ -230,6 +239,7 @@ void pitch_search(const opus_val16 * OPUS_RESTRICT x_lp, opus_val16 * OPUS_RESTR
       maxcorr = MAX32(maxcorr, sum);
 #endif
    }
+#endif
    find_best_pitch(xcorr, y_lp4, len>>2, max_pitch>>2, best_pitch
 #ifdef FIXED_POINT
                    , 0, maxcorr
@@ -246,8 +256,12 @@ void pitch_search(const opus_val16 * OPUS_RESTRICT x_lp, opus_val16 * OPUS_RESTR
       xcorr[i] = 0;
       if (abs(i-2*best_pitch[0])>2 && abs(i-2*best_pitch[1])>2)
          continue;
+#ifdef OPUS_X86_SIMD
+      sum = opus_simd_get()->inner_prod(x_lp, y+i, len>>1);
+#else
       for (j=0;j<len>>1;j++)
          sum += SHR32(MULT16_16(x_lp[j],y[i+j]), shift);
+#endif
       xcorr[i] = MAX32(-1, sum);
 #ifdef FIXED_POINT
       maxcorr = MAX32(maxcorr, sum);
@@ -31,12 +31,19 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "SigProc_FLP.h"
 
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
+
 /* sum of squares of a silk_float array, with result as double */
 double silk_energy_FLP(
     const silk_float    *data,
     opus_int            dataSize
 )
 {
+#ifdef OPUS_X86_SIMD
+    return opus_simd_get()->energy_flp( data, dataSize );
+#else
     opus_int  i, dataSize4;
     double   result;
 
@@ -57,4 +64,5 @@ double silk_energy_FLP(
 
     silk_assert( result >= 0.0 );
     return result;
+#endif
 }
@@ -31,6 +31,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "SigProc_FLP.h"
 
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
+
 /* inner product of two silk_float arrays, with result as double */
 double silk_inner_product_FLP(
     const silk_float    *data1,
@@ -38,6 +42,9 @@ double silk_inner_product_FLP(
     opus_int            dataSize
 )
 {
+#ifdef OPUS_X86_SIMD
+    return opus_simd_get()->inner_product_flp( data1, data2, dataSize );
+#else
     opus_int  i, dataSize4;
     double   result;
 
@@ -57,4 +64,5 @@ double silk_inner_product_FLP(
     }
 
     return result;
+#endif
 }
@@ -0,0 +1,177 @@
+#include "simd.h"
+
+#include <stddef.h> /* NULL */
+#include <stdlib.h> /* getenv */
+#include <string.h> /* strcmp */
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#else
+# include <cpuid.h>
+#endif
+
+/* Plain C kernels, these match the original loops in celt/silk */
+
+static void pitch_xcorr_c(const float* x,
+                          const float* y,
+                          float* xcorr,
+                          int len,
+                          int max_pitch) {
+  int i;
+  int j;
+
+  for (i = 0; i < max_pitch; i++) {
+    float sum = 0;
+    for (j = 0; j < len; j++)
+      sum += x[j] * y[i + j];
+    xcorr[i] = sum;
+  }
+}
+
+
+static float inner_prod_c(const float* x, const float* y, int len) {
+  int i;
+  float sum = 0;
+
+  for (i = 0; i < len; i++)
+    sum += x[i] * y[i];
+
+  return sum;
+}
+
+
+static void mdct_rotate_c(float* f,
+                          const float* trig,
+                          int n4,
+                          int shift,
+                          float sine,
+                          int forward) {
+  int i;
+
+  for (i = 0; i < n4; i++) {
+    float re = f[0];
+    float im = f[1];
+    float a = trig[i << shift];
+    float b = trig[(n4 - i) << shift];
+    float yr;
+    float yi;
+
+    if (forward) {
+      yr = -re * a - im * b;
+      yi = -im * a + re * b;
+      f[0] = yr + yi * sine;
+      f[1] = yi - yr * sine;
+    } else {
+      yr = re * a - im * b;
+      yi = im * a + re * b;
+      f[0] = yr - yi * sine;
+      f[1] = yi + yr * sine;
+    }
+    f += 2;
+  }
+}
+
+
+static double inner_product_flp_c(const float* x, const float* y, int len) {
+  int i;
+  double result = 0.0;
+
+  for (i = 0; i < len; i++)
+    result += x[i] * (double) y[i];
+
+  return result;
+}
+
+
+static double energy_flp_c(const float* x, int len) {
+  int i;
+  double result = 0.0;
+
+  for (i = 0; i < len; i++)
+    result += x[i] * (double) x[i];
+
+  return result;
+}
+
+
+const opus_simd_t opus_simd_c = {
+  pitch_xcorr_c,
+  inner_prod_c,
+  mdct_rotate_c,
+  inner_product_flp_c,
+  energy_flp_c,
+  "c"
+};
+
+
+static void cpuid(int leaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, leaf);
+  regs[0] = r[0];
+  regs[1] = r[1];
+  regs[2] = r[2];
+  regs[3] = r[3];
+#else
+  if (!__get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+
+static int os_saves_ymm(void) {
+  unsigned int lo;
+
+#if defined(_MSC_VER)
+  lo = (unsigned int) _xgetbv(0);
+#else
+  unsigned int hi;
+  __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+#endif
+
+  /* XMM and YMM state are enabled */
+  return (lo & 6) == 6;
+}
+
+
+static const opus_simd_t* opus_simd_detect(void) {
+  unsigned int regs[4];
+  const char* force;
+
+  /* Allow benchmarks to compare implementations */
+  force = getenv("OPUS_SIMD");
+  if (force != NULL && strcmp(force, "c") == 0)
+    return &opus_simd_c;
+  if (force != NULL && strcmp(force, "sse2") == 0)
+    return &opus_simd_sse2;
+
+  cpuid(0, regs);
+  if (regs[0] < 1)
+    return &opus_simd_c;
+
+  cpuid(1, regs);
+
+  /* ECX: AVX (bit 28) and OSXSAVE (bit 27) */
+  if ((regs[2] & (1 << 28)) && (regs[2] & (1 << 27)) && os_saves_ymm())
+    return &opus_simd_avx;
+
+  /* EDX: SSE2 (bit 26) */
+  if (regs[3] & (1 << 26))
+    return &opus_simd_sse2;
+
+  return &opus_simd_c;
+}
+
+
+const opus_simd_t* opus_simd_get(void) {
+  /*
+   * Detection is idempotent, so racing threads will just store the same
+   * pointer.
+   */
+  static const opus_simd_t* volatile selected = NULL;
+
+  if (selected == NULL)
+    selected = opus_simd_detect();
+
+  return selected;
+}
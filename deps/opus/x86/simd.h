@@ -0,0 +1,58 @@
+#ifndef _DEPS_OPUS_X86_SIMD_H_
+#define _DEPS_OPUS_X86_SIMD_H_
+
+/*
+ * Runtime dispatched float kernels for opus on x86.
+ * Only used when opus is built with `opus_build_type=float` on ia32/x64,
+ * see opus.gyp (OPUS_X86_SIMD define).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct opus_simd_s opus_simd_t;
+
+struct opus_simd_s {
+  /* xcorr[i] = sum(x[j] * y[i + j], j < len), for i < max_pitch */
+  void (*pitch_xcorr)(const float* x,
+                      const float* y,
+                      float* xcorr,
+                      int len,
+                      int max_pitch);
+
+  /* sum(x[j] * y[j], j < len) */
+  float (*inner_prod)(const float* x, const float* y, int len);
+
+  /*
+   * In-place MDCT pre-rotation (forward transform, `forward` = 1) or
+   * post-rotation (backward transform, `forward` = 0) of N4 complex values.
+   */
+  void (*mdct_rotate)(float* f,
+                      const float* trig,
+                      int n4,
+                      int shift,
+                      float sine,
+                      int forward);
+
+  /* SILK float analysis, accumulated in double precision */
+  double (*inner_product_flp)(const float* x, const float* y, int len);
+  double (*energy_flp)(const float* x, int len);
+
+  /* "c", "sse2" or "avx" */
+  const char* name;
+};
+
+/* Returns kernels for the current CPU (detected once by CPUID) */
+const opus_simd_t* opus_simd_get(void);
+
+/* Implementations, in simd.c, simd_sse.c and simd_avx.c */
+extern const opus_simd_t opus_simd_c;
+extern const opus_simd_t opus_simd_sse2;
+extern const opus_simd_t opus_simd_avx;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DEPS_OPUS_X86_SIMD_H_ */
@@ -0,0 +1,112 @@
+#include "simd.h"
+
+#include <immintrin.h>
+
+/* Compiled without -mavx, selected only when CPUID reports AVX support */
+#if defined(__GNUC__)
+# define AVX_TARGET __attribute__((target("avx")))
+#else
+# define AVX_TARGET
+#endif
+
+AVX_TARGET
+static float inner_prod_avx(const float* x, const float* y, int len) {
+  int i;
+  float res;
+  __m256 sum = _mm256_setzero_ps();
+  __m128 half;
+
+  for (i = 0; i + 7 < len; i += 8) {
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(x + i),
+                                           _mm256_loadu_ps(y + i)));
+  }
+
+  /* Horizontal add */
+  half = _mm_add_ps(_mm256_castps256_ps128(sum),
+                    _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+  res = _mm_cvtss_f32(half);
+
+  for (; i < len; i++)
+    res += x[i] * y[i];
+
+  return res;
+}
+
+
+AVX_TARGET
+static void pitch_xcorr_avx(const float* x,
+                            const float* y,
+                            float* xcorr,
+                            int len,
+                            int max_pitch) {
+  int i;
+  int j;
+
+  /* Eight lags at once: broadcast x[j] against y[i + j .. i + j + 7] */
+  for (i = 0; i + 7 < max_pitch; i += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (j = 0; j < len; j++) {
+      __m256 xj = _mm256_set1_ps(x[j]);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(xj, _mm256_loadu_ps(y + i + j)));
+    }
+    _mm256_storeu_ps(xcorr + i, sum);
+  }
+
+  for (; i < max_pitch; i++)
+    xcorr[i] = inner_prod_avx(x, y + i, len);
+}
+
+
+AVX_TARGET
+static double inner_product_flp_avx(const float* x, const float* y, int len) {
+  int i;
+  double res;
+  __m256d sum = _mm256_setzero_pd();
+  __m128d half;
+
+  for (i = 0; i + 3 < len; i += 4) {
+    __m256d a = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+    __m256d b = _mm256_cvtps_pd(_mm_loadu_ps(y + i));
+
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(a, b));
+  }
+
+  half = _mm_add_pd(_mm256_castpd256_pd128(sum),
+                    _mm256_extractf128_pd(sum, 1));
+  half = _mm_add_sd(half, _mm_unpackhi_pd(half, half));
+  res = _mm_cvtsd_f64(half);
+
+  for (; i < len; i++)
+    res += x[i] * (double) y[i];
+
+  return res;
+}
+
+
+AVX_TARGET
+static double energy_flp_avx(const float* x, int len) {
+  return inner_product_flp_avx(x, x, len);
+}
+
+
+/* MDCT rotation gathers strided twiddles, SSE2 is as good as it gets there */
+static void mdct_rotate_avx(float* f,
+                            const float* trig,
+                            int n4,
+                            int shift,
+                            float sine,
+                            int forward) {
+  opus_simd_sse2.mdct_rotate(f, trig, n4, shift, sine, forward);
+}
+
+
+const opus_simd_t opus_simd_avx = {
+  pitch_xcorr_avx,
+  inner_prod_avx,
+  mdct_rotate_avx,
+  inner_product_flp_avx,
+  energy_flp_avx,
+  "avx"
+};
@@ -0,0 +1,174 @@
+#include "simd.h"
+
+#include <emmintrin.h>
+
+/*
+ * x64 always has SSE2, ia32 builds are compiled without -msse2:
+ * selected only when CPUID reports SSE2 support (see simd.c)
+ */
+#if defined(__GNUC__)
+# define SSE2_TARGET __attribute__((target("sse2")))
+#else
+# define SSE2_TARGET
+#endif
+
+SSE2_TARGET
+static void pitch_xcorr_sse2(const float* x,
+                             const float* y,
+                             float* xcorr,
+                             int len,
+                             int max_pitch) {
+  int i;
+  int j;
+
+  /* Four lags at once: broadcast x[j] against y[i + j .. i + j + 3] */
+  for (i = 0; i + 3 < max_pitch; i += 4) {
+    __m128 sum = _mm_setzero_ps();
+    for (j = 0; j < len; j++) {
+      __m128 xj = _mm_set1_ps(x[j]);
+      sum = _mm_add_ps(sum, _mm_mul_ps(xj, _mm_loadu_ps(y + i + j)));
+    }
+    _mm_storeu_ps(xcorr + i, sum);
+  }
+
+  for (; i < max_pitch; i++)
+    xcorr[i] = opus_simd_sse2.inner_prod(x, y + i, len);
+}
+
+
+SSE2_TARGET
+static float inner_prod_sse2(const float* x, const float* y, int len) {
+  int i;
+  float res;
+  __m128 sum = _mm_setzero_ps();
+
+  for (i = 0; i + 3 < len; i += 4)
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+
+  /* Horizontal add */
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+  res = _mm_cvtss_f32(sum);
+
+  for (; i < len; i++)
+    res += x[i] * y[i];
+
+  return res;
+}
+
+
+SSE2_TARGET
+static void mdct_rotate_sse2(float* f,
+                             const float* trig,
+                             int n4,
+                             int shift,
+                             float sine,
+                             int forward) {
+  int i;
+  __m128 s = _mm_set1_ps(sine);
+
+  /* Four complex values (eight floats) per iteration */
+  for (i = 0; i + 3 < n4; i += 4) {
+    __m128 v0 = _mm_loadu_ps(f);
+    __m128 v1 = _mm_loadu_ps(f + 4);
+    __m128 re = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 im = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 a = _mm_setr_ps(trig[i << shift],
+                           trig[(i + 1) << shift],
+                           trig[(i + 2) << shift],
+                           trig[(i + 3) << shift]);
+    __m128 b = _mm_setr_ps(trig[(n4 - i) << shift],
+                           trig[(n4 - i - 1) << shift],
+                           trig[(n4 - i - 2) << shift],
+                           trig[(n4 - i - 3) << shift]);
+    __m128 yr;
+    __m128 yi;
+    __m128 o0;
+    __m128 o1;
+
+    if (forward) {
+      yr = _mm_sub_ps(_mm_setzero_ps(),
+                      _mm_add_ps(_mm_mul_ps(re, a), _mm_mul_ps(im, b)));
+      yi = _mm_sub_ps(_mm_mul_ps(re, b), _mm_mul_ps(im, a));
+      o0 = _mm_add_ps(yr, _mm_mul_ps(yi, s));
+      o1 = _mm_sub_ps(yi, _mm_mul_ps(yr, s));
+    } else {
+      yr = _mm_sub_ps(_mm_mul_ps(re, a), _mm_mul_ps(im, b));
+      yi = _mm_add_ps(_mm_mul_ps(im, a), _mm_mul_ps(re, b));
+      o0 = _mm_sub_ps(yr, _mm_mul_ps(yi, s));
+      o1 = _mm_add_ps(yi, _mm_mul_ps(yr, s));
+    }
+
+    /* Interleave back */
+    _mm_storeu_ps(f, _mm_unpacklo_ps(o0, o1));
+    _mm_storeu_ps(f + 4, _mm_unpackhi_ps(o0, o1));
+    f += 8;
+  }
+
+  /* Tail, note that trig offsets are relative to the original n4 */
+  for (; i < n4; i++) {
+    float re = f[0];
+    float im = f[1];
+    float a = trig[i << shift];
+    float b = trig[(n4 - i) << shift];
+    float yr;
+    float yi;
+
+    if (forward) {
+      yr = -re * a - im * b;
+      yi = -im * a + re * b;
+      f[0] = yr + yi * sine;
+      f[1] = yi - yr * sine;
+    } else {
+      yr = re * a - im * b;
+      yi = im * a + re * b;
+      f[0] = yr - yi * sine;
+      f[1] = yi + yr * sine;
+    }
+    f += 2;
+  }
+}
+
+
+SSE2_TARGET
+static double inner_product_flp_sse2(const float* x, const float* y, int len) {
+  int i;
+  double res;
+  __m128d sum0 = _mm_setzero_pd();
+  __m128d sum1 = _mm_setzero_pd();
+
+  for (i = 0; i + 3 < len; i += 4) {
+    __m128 a = _mm_loadu_ps(x + i);
+    __m128 b = _mm_loadu_ps(y + i);
+
+    sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_cvtps_pd(a), _mm_cvtps_pd(b)));
+    sum1 = _mm_add_pd(sum1,
+                      _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)),
+                                 _mm_cvtps_pd(_mm_movehl_ps(b, b))));
+  }
+
+  sum0 = _mm_add_pd(sum0, sum1);
+  sum0 = _mm_add_sd(sum0, _mm_unpackhi_pd(sum0, sum0));
+  res = _mm_cvtsd_f64(sum0);
+
+  for (; i < len; i++)
+    res += x[i] * (double) y[i];
+
+  return res;
+}
+
+
+SSE2_TARGET
+static double energy_flp_sse2(const float* x, int len) {
+  return inner_product_flp_sse2(x, x, len);
+}
+
+
+const opus_simd_t opus_simd_sse2 = {
+  pitch_xcorr_sse2,
+  inner_prod_sse2,
+  mdct_rotate_sse2,
+  inner_product_flp_sse2,
+  energy_flp_sse2,
+  "sse2"
+};
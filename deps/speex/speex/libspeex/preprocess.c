@@ -251,6 +251,12 @@ struct SpeexPreprocessState_ {
 #endif
 };
 
+/* SSE2 is there on every x86_64 CPU. Only the preprocessor is switched
+   here, _USE_SSE would also move the codec and resampler to SSE paths */
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(FIXED_POINT)
+#include "preprocess_sse.h"
+#endif
+
 
 static void conj_window(spx_word16_t *w, int len)
 {
@@ -377,6 +383,7 @@ static inline spx_word16_t qcurve(spx_word16_t x)
    return 1.f/(1.f+.15f/(SNR_SCALING_1*x));
 }
 
+#ifndef OVERRIDE_COMPUTE_GAIN_FLOOR
 static void compute_gain_floor(int noise_suppress, int effective_echo_suppress, spx_word32_t *noise, spx_word32_t *echo, spx_word16_t *gain_floor, int len)
 {
    int i;
@@ -390,6 +397,7 @@ static void compute_gain_floor(int noise_suppress, int effective_echo_suppress,
    for (i=0;i<len;i++)
       gain_floor[i] = FRAC_SCALING*sqrt(noise_floor*PSHR32(noise[i],NOISE_SHIFT) + echo_floor*echo[i])/sqrt(1+PSHR32(noise[i],NOISE_SHIFT) + echo[i]);
 }
+#endif /* OVERRIDE_COMPUTE_GAIN_FLOOR */
 
 #endif
 EXPORT SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sampling_rate)
@@ -615,6 +623,25 @@ static void speex_compute_agc(SpeexPreprocessState *st, spx_word16_t Pframe, spx
 }
 #endif
 
+#ifndef OVERRIDE_WINDOW_FRAME
+static void window_frame(spx_word16_t *frame, const spx_word16_t *window, int len)
+{
+   int i;
+   for (i=0;i<len;i++)
+      frame[i] = MULT16_16_Q15(frame[i], window[i]);
+}
+#endif
+
+#ifndef OVERRIDE_POWER_SPECTRUM
+static void power_spectrum(const spx_word16_t *ft, spx_word32_t *ps, int N)
+{
+   int i;
+   ps[0]=MULT16_16(ft[0],ft[0]);
+   for (i=1;i<N;i++)
+      ps[i]=MULT16_16(ft[2*i-1],ft[2*i-1]) + MULT16_16(ft[2*i],ft[2*i]);
+}
+#endif
+
 static void preprocess_analysis(SpeexPreprocessState *st, spx_int16_t *x)
 {
    int i;
@@ -634,8 +661,7 @@ static void preprocess_analysis(SpeexPreprocessState *st, spx_int16_t *x)
       st->inbuf[i]=x[N4+i];
 
    /* Windowing */
-   for (i=0;i<2*N;i++)
-      st->frame[i] = MULT16_16_Q15(st->frame[i], st->window[i]);
+   window_frame(st->frame, st->window, 2*N);
 
 #ifdef FIXED_POINT
    {
@@ -652,15 +678,14 @@ static void preprocess_analysis(SpeexPreprocessState *st, spx_int16_t *x)
    spx_fft(st->fft_lookup, st->frame, st->ft);
          
    /* Power spectrum */
-   ps[0]=MULT16_16(st->ft[0],st->ft[0]);
-   for (i=1;i<N;i++)
-      ps[i]=MULT16_16(st->ft[2*i-1],st->ft[2*i-1]) + MULT16_16(st->ft[2*i],st->ft[2*i]);
+   power_spectrum(st->ft, ps, N);
    for (i=0;i<N;i++)
       st->ps[i] = PSHR32(st->ps[i], 2*st->frame_shift);
 
    filterbank_compute_bank32(st->bank, ps, ps+N);
 }
 
+#ifndef OVERRIDE_UPDATE_NOISE_PROB
 static void update_noise_prob(SpeexPreprocessState *st)
 {
    int i;
@@ -713,6 +738,113 @@ static void update_noise_prob(SpeexPreprocessState *st)
    }
 
 }
+#endif /* OVERRIDE_UPDATE_NOISE_PROB */
+
+#ifndef OVERRIDE_UPDATE_NOISE
+/* Update the noise estimate for the frequencies where it can be */
+static void update_noise(SpeexPreprocessState *st, spx_word16_t beta, spx_word16_t beta_1)
+{
+   int i;
+   for (i=0;i<st->ps_size;i++)
+   {
+      if (!st->update_prob[i] || st->ps[i] < PSHR32(st->noise[i], NOISE_SHIFT))
+         st->noise[i] = MAX32(EXTEND32(0),MULT16_32_Q15(beta_1,st->noise[i]) + MULT16_32_Q15(beta,SHL32(st->ps[i],NOISE_SHIFT)));
+   }
+}
+#endif
+
+#ifndef OVERRIDE_COMPUTE_SNR
+/* A posteriori and a priori SNR of `len` bins and bands */
+static void compute_snr(SpeexPreprocessState *st, int len)
+{
+   int i;
+   spx_word32_t *ps=st->ps;
+   for (i=0;i<len;i++)
+   {
+      spx_word16_t gamma;
+
+      /* Total noise estimate including residual echo and reverberation */
+      spx_word32_t tot_noise = ADD32(ADD32(ADD32(EXTEND32(1), PSHR32(st->noise[i],NOISE_SHIFT)) , st->echo_noise[i]) , st->reverb_estimate[i]);
+
+      /* A posteriori SNR = ps/noise - 1*/
+      st->post[i] = SUB16(DIV32_16_Q8(ps[i],tot_noise), QCONST16(1.f,SNR_SHIFT));
+      st->post[i]=MIN16(st->post[i], QCONST16(100.f,SNR_SHIFT));
+
+      /* Computing update gamma = .1 + .9*(old/(old+noise))^2 */
+      gamma = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.89f,15),SQR16_Q15(DIV32_16_Q15(st->old_ps[i],ADD32(st->old_ps[i],tot_noise))));
+
+      /* A priori SNR update = gamma*max(0,post) + (1-gamma)*old/noise */
+      st->prior[i] = EXTRACT16(PSHR32(ADD32(MULT16_16(gamma,MAX16(0,st->post[i])), MULT16_16(Q15_ONE-gamma,DIV32_16_Q8(st->old_ps[i],tot_noise))), 15));
+      st->prior[i]=MIN16(st->prior[i], QCONST16(100.f,SNR_SHIFT));
+   }
+}
+#endif
+
+#ifndef OVERRIDE_COMPUTE_LINEAR_GAIN
+/* Compute gain according to the Ephraim-Malah algorithm -- linear frequency */
+static void compute_linear_gain(SpeexPreprocessState *st, int N)
+{
+   int i;
+   spx_word32_t *ps=st->ps;
+   for (i=0;i<N;i++)
+   {
+      spx_word32_t MM;
+      spx_word32_t theta;
+      spx_word16_t prior_ratio;
+      spx_word16_t tmp;
+      spx_word16_t p;
+      spx_word16_t g;
+
+      /* Wiener filter gain */
+      prior_ratio = PDIV32_16(SHL32(EXTEND32(st->prior[i]), 15), ADD16(st->prior[i], SHL32(1,SNR_SHIFT)));
+      theta = MULT16_32_P15(prior_ratio, QCONST32(1.f,EXPIN_SHIFT)+SHL32(EXTEND32(st->post[i]),EXPIN_SHIFT-SNR_SHIFT));
+
+      /* Optimal estimator for loudness domain */
+      MM = hypergeom_gain(theta);
+      /* EM gain with bound */
+      g = EXTRACT16(MIN32(Q15_ONE, MULT16_32_Q15(prior_ratio, MM)));
+      /* Interpolated speech probability of presence */
+      p = st->gain2[i];
+
+      /* Constrain the gain to be close to the Bark scale gain */
+      if (MULT16_16_Q15(QCONST16(.333f,15),g) > st->gain[i])
+         g = MULT16_16(3,st->gain[i]);
+      st->gain[i] = g;
+
+      /* Save old power spectrum */
+      st->old_ps[i] = MULT16_32_P15(QCONST16(.2f,15),st->old_ps[i]) + MULT16_32_P15(MULT16_16_P15(QCONST16(.8f,15),SQR16_Q15(st->gain[i])),ps[i]);
+
+      /* Apply gain floor */
+      if (st->gain[i] < st->gain_floor[i])
+         st->gain[i] = st->gain_floor[i];
+
+      /* Exponential decay model for reverberation (unused) */
+      /*st->reverb_estimate[i] = st->reverb_decay*st->reverb_estimate[i] + st->reverb_decay*st->reverb_level*st->gain[i]*st->gain[i]*st->ps[i];*/
+
+      /* Take into account speech probability of presence (loudness domain MMSE estimator) */
+      /* gain2 = [p*sqrt(gain)+(1-p)*sqrt(gain _floor) ]^2 */
+      tmp = MULT16_16_P15(p,spx_sqrt(SHL32(EXTEND32(st->gain[i]),15))) + MULT16_16_P15(SUB16(Q15_ONE,p),spx_sqrt(SHL32(EXTEND32(st->gain_floor[i]),15)));
+      st->gain2[i]=SQR16_Q15(tmp);
+
+      /* Use this if you want a log-domain MMSE estimator instead */
+      /*st->gain2[i] = pow(st->gain[i], p) * pow(st->gain_floor[i],1.f-p);*/
+   }
+}
+#endif
+
+#ifndef OVERRIDE_APPLY_GAIN
+static void apply_gain(spx_word16_t *ft, const spx_word16_t *gain2, int N)
+{
+   int i;
+   for (i=1;i<N;i++)
+   {
+      ft[2*i-1] = MULT16_16_P15(gain2[i],ft[2*i-1]);
+      ft[2*i] = MULT16_16_P15(gain2[i],ft[2*i]);
+   }
+   ft[0] = MULT16_16_P15(gain2[0],ft[0]);
+   ft[2*N-1] = MULT16_16_P15(gain2[N-1],ft[2*N-1]);
+}
+#endif
 
 #define NOISE_OVERCOMPENS 1.
 
@@ -776,11 +908,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
    */
    
    /* Update the noise estimate for the frequencies where it can be */
-   for (i=0;i<N;i++)
-   {
-      if (!st->update_prob[i] || st->ps[i] < PSHR32(st->noise[i], NOISE_SHIFT))
-         st->noise[i] = MAX32(EXTEND32(0),MULT16_32_Q15(beta_1,st->noise[i]) + MULT16_32_Q15(beta,SHL32(st->ps[i],NOISE_SHIFT)));
-   }
+   update_noise(st, beta, beta_1);
    filterbank_compute_bank32(st->bank, st->noise, st->noise+N);
 
    /* Special case for first frame */
@@ -789,24 +917,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
          st->old_ps[i] = ps[i];
 
    /* Compute a posteriori SNR */
-   for (i=0;i<N+M;i++)
-   {
-      spx_word16_t gamma;
-      
-      /* Total noise estimate including residual echo and reverberation */
-      spx_word32_t tot_noise = ADD32(ADD32(ADD32(EXTEND32(1), PSHR32(st->noise[i],NOISE_SHIFT)) , st->echo_noise[i]) , st->reverb_estimate[i]);
-      
-      /* A posteriori SNR = ps/noise - 1*/
-      st->post[i] = SUB16(DIV32_16_Q8(ps[i],tot_noise), QCONST16(1.f,SNR_SHIFT));
-      st->post[i]=MIN16(st->post[i], QCONST16(100.f,SNR_SHIFT));
-      
-      /* Computing update gamma = .1 + .9*(old/(old+noise))^2 */
-      gamma = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.89f,15),SQR16_Q15(DIV32_16_Q15(st->old_ps[i],ADD32(st->old_ps[i],tot_noise))));
-      
-      /* A priori SNR update = gamma*max(0,post) + (1-gamma)*old/noise */
-      st->prior[i] = EXTRACT16(PSHR32(ADD32(MULT16_16(gamma,MAX16(0,st->post[i])), MULT16_16(Q15_ONE-gamma,DIV32_16_Q8(st->old_ps[i],tot_noise))), 15));
-      st->prior[i]=MIN16(st->prior[i], QCONST16(100.f,SNR_SHIFT));
-   }
+   compute_snr(st, N+M);
 
    /*print_vec(st->post, N+M, "");*/
 
@@ -878,49 +989,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
       filterbank_compute_psd16(st->bank,st->gain_floor+N, st->gain_floor);
    
       /* Compute gain according to the Ephraim-Malah algorithm -- linear frequency */
-      for (i=0;i<N;i++)
-      {
-         spx_word32_t MM;
-         spx_word32_t theta;
-         spx_word16_t prior_ratio;
-         spx_word16_t tmp;
-         spx_word16_t p;
-         spx_word16_t g;
-         
-         /* Wiener filter gain */
-         prior_ratio = PDIV32_16(SHL32(EXTEND32(st->prior[i]), 15), ADD16(st->prior[i], SHL32(1,SNR_SHIFT)));
-         theta = MULT16_32_P15(prior_ratio, QCONST32(1.f,EXPIN_SHIFT)+SHL32(EXTEND32(st->post[i]),EXPIN_SHIFT-SNR_SHIFT));
-
-         /* Optimal estimator for loudness domain */
-         MM = hypergeom_gain(theta);
-         /* EM gain with bound */
-         g = EXTRACT16(MIN32(Q15_ONE, MULT16_32_Q15(prior_ratio, MM)));
-         /* Interpolated speech probability of presence */
-         p = st->gain2[i];
-                  
-         /* Constrain the gain to be close to the Bark scale gain */
-         if (MULT16_16_Q15(QCONST16(.333f,15),g) > st->gain[i])
-            g = MULT16_16(3,st->gain[i]);
-         st->gain[i] = g;
-         
-         /* Save old power spectrum */
-         st->old_ps[i] = MULT16_32_P15(QCONST16(.2f,15),st->old_ps[i]) + MULT16_32_P15(MULT16_16_P15(QCONST16(.8f,15),SQR16_Q15(st->gain[i])),ps[i]);
-         
-         /* Apply gain floor */
-         if (st->gain[i] < st->gain_floor[i])
-            st->gain[i] = st->gain_floor[i];
-
-         /* Exponential decay model for reverberation (unused) */
-         /*st->reverb_estimate[i] = st->reverb_decay*st->reverb_estimate[i] + st->reverb_decay*st->reverb_level*st->gain[i]*st->gain[i]*st->ps[i];*/
-         
-         /* Take into account speech probability of presence (loudness domain MMSE estimator) */
-         /* gain2 = [p*sqrt(gain)+(1-p)*sqrt(gain _floor) ]^2 */
-         tmp = MULT16_16_P15(p,spx_sqrt(SHL32(EXTEND32(st->gain[i]),15))) + MULT16_16_P15(SUB16(Q15_ONE,p),spx_sqrt(SHL32(EXTEND32(st->gain_floor[i]),15)));
-         st->gain2[i]=SQR16_Q15(tmp);
-
-         /* Use this if you want a log-domain MMSE estimator instead */
-         /*st->gain2[i] = pow(st->gain[i], p) * pow(st->gain_floor[i],1.f-p);*/
-      }
+      compute_linear_gain(st, N);
    } else {
       for (i=N;i<N+M;i++)
       {
@@ -941,13 +1010,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
    }
       
    /* Apply computed gain */
-   for (i=1;i<N;i++)
-   {
-      st->ft[2*i-1] = MULT16_16_P15(st->gain2[i],st->ft[2*i-1]);
-      st->ft[2*i] = MULT16_16_P15(st->gain2[i],st->ft[2*i]);
-   }
-   st->ft[0] = MULT16_16_P15(st->gain2[0],st->ft[0]);
-   st->ft[2*N-1] = MULT16_16_P15(st->gain2[N-1],st->ft[2*N-1]);
+   apply_gain(st->ft, st->gain2, N);
    
    /*FIXME: This *will* not work for fixed-point */
 #ifndef FIXED_POINT
@@ -979,8 +1042,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
 #endif
    
    /* Synthesis window (for WOLA) */
-   for (i=0;i<2*N;i++)
-      st->frame[i] = MULT16_16_Q15(st->frame[i], st->window[i]);
+   window_frame(st->frame, st->window, 2*N);
 
    /* Perform overlap and add */
    for (i=0;i<N3;i++)
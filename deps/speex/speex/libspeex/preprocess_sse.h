@@ -0,0 +1,320 @@
+/**
+   @file preprocess_sse.h
+   @brief Per-bin loops of the preprocessor (SSE2 version, float only)
+
+   Included by preprocess.c after the state definition, each OVERRIDE_*
+   replaces the generic loop of the same name. Results match the generic
+   code up to float rounding (sqrt is computed in single precision).
+   The filterbank isn't vectorized: it scatters and gathers bins by
+   index, which SSE can't do.
+*/
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#define OVERRIDE_WINDOW_FRAME
+static void window_frame(float *frame, const float *window, int len)
+{
+   int i;
+   for (i=0;i+3<len;i+=4)
+      _mm_storeu_ps(frame+i, _mm_mul_ps(_mm_loadu_ps(frame+i), _mm_loadu_ps(window+i)));
+   for (;i<len;i++)
+      frame[i] *= window[i];
+}
+
+#define OVERRIDE_POWER_SPECTRUM
+static void power_spectrum(const float *ft, float *ps, int N)
+{
+   int i;
+   ps[0]=ft[0]*ft[0];
+   for (i=1;i+3<N;i+=4)
+   {
+      /* Interleaved re/im of bins i..i+3 */
+      __m128 a = _mm_loadu_ps(ft+2*i-1);
+      __m128 b = _mm_loadu_ps(ft+2*i+3);
+      a = _mm_mul_ps(a, a);
+      b = _mm_mul_ps(b, b);
+      _mm_storeu_ps(ps+i, _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)),
+                                     _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1))));
+   }
+   for (;i<N;i++)
+      ps[i]=ft[2*i-1]*ft[2*i-1] + ft[2*i]*ft[2*i];
+}
+
+#define OVERRIDE_UPDATE_NOISE_PROB
+static void update_noise_prob(SpeexPreprocessState *st)
+{
+   int i;
+   int min_range;
+   int N = st->ps_size;
+   float *S = st->S;
+   float *Smin = st->Smin;
+   float *Stmp = st->Stmp;
+   const float *ps = st->ps;
+   const __m128 c8 = _mm_set1_ps(.8f);
+   const __m128 c05 = _mm_set1_ps(.05f);
+   const __m128 c1 = _mm_set1_ps(.1f);
+   const __m128 c4 = _mm_set1_ps(.4f);
+
+   /* Smoothing reads only ps, so neighbours can be loaded unaligned */
+   for (i=1;i+3<N-1;i+=4)
+   {
+      __m128 s = _mm_mul_ps(c8, _mm_loadu_ps(S+i));
+      s = _mm_add_ps(s, _mm_mul_ps(c05, _mm_loadu_ps(ps+i-1)));
+      s = _mm_add_ps(s, _mm_mul_ps(c1, _mm_loadu_ps(ps+i)));
+      s = _mm_add_ps(s, _mm_mul_ps(c05, _mm_loadu_ps(ps+i+1)));
+      _mm_storeu_ps(S+i, s);
+   }
+   for (;i<N-1;i++)
+      S[i] = .8f*S[i] + .05f*ps[i-1] + .1f*ps[i] + .05f*ps[i+1];
+   S[0] = .8f*S[0] + .2f*ps[0];
+   S[N-1] = .8f*S[N-1] + .2f*ps[N-1];
+
+   if (st->nb_adapt==1)
+   {
+      for (i=0;i<N;i++)
+         Smin[i] = Stmp[i] = 0;
+   }
+
+   if (st->nb_adapt < 100)
+      min_range = 15;
+   else if (st->nb_adapt < 1000)
+      min_range = 50;
+   else if (st->nb_adapt < 10000)
+      min_range = 150;
+   else
+      min_range = 300;
+   if (st->min_count > min_range)
+   {
+      st->min_count = 0;
+      for (i=0;i+3<N;i+=4)
+      {
+         __m128 s = _mm_loadu_ps(S+i);
+         _mm_storeu_ps(Smin+i, _mm_min_ps(_mm_loadu_ps(Stmp+i), s));
+         _mm_storeu_ps(Stmp+i, s);
+      }
+      for (;i<N;i++)
+      {
+         Smin[i] = MIN32(Stmp[i], S[i]);
+         Stmp[i] = S[i];
+      }
+   } else {
+      for (i=0;i+3<N;i+=4)
+      {
+         __m128 s = _mm_loadu_ps(S+i);
+         _mm_storeu_ps(Smin+i, _mm_min_ps(_mm_loadu_ps(Smin+i), s));
+         _mm_storeu_ps(Stmp+i, _mm_min_ps(_mm_loadu_ps(Stmp+i), s));
+      }
+      for (;i<N;i++)
+      {
+         Smin[i] = MIN32(Smin[i], S[i]);
+         Stmp[i] = MIN32(Stmp[i], S[i]);
+      }
+   }
+
+   for (i=0;i+3<N;i+=4)
+   {
+      __m128 gt = _mm_cmpgt_ps(_mm_mul_ps(c4, _mm_loadu_ps(S+i)), _mm_loadu_ps(Smin+i));
+      _mm_storeu_si128((__m128i *)(st->update_prob+i),
+                       _mm_srli_epi32(_mm_castps_si128(gt), 31));
+   }
+   for (;i<N;i++)
+      st->update_prob[i] = .4f*S[i] > Smin[i];
+}
+
+#define OVERRIDE_UPDATE_NOISE
+static void update_noise(SpeexPreprocessState *st, float beta, float beta_1)
+{
+   int i;
+   int N = st->ps_size;
+   float *noise = st->noise;
+   const float *ps = st->ps;
+   const __m128 b = _mm_set1_ps(beta);
+   const __m128 b1 = _mm_set1_ps(beta_1);
+   const __m128 zero = _mm_setzero_ps();
+
+   for (i=0;i+3<N;i+=4)
+   {
+      __m128 n = _mm_loadu_ps(noise+i);
+      __m128 p = _mm_loadu_ps(ps+i);
+      __m128i up = _mm_loadu_si128((const __m128i *)(st->update_prob+i));
+      __m128 mask = _mm_or_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(up, _mm_setzero_si128())),
+                              _mm_cmplt_ps(p, n));
+      __m128 next = _mm_max_ps(zero, _mm_add_ps(_mm_mul_ps(b1, n), _mm_mul_ps(b, p)));
+      _mm_storeu_ps(noise+i, _mm_or_ps(_mm_and_ps(mask, next), _mm_andnot_ps(mask, n)));
+   }
+   for (;i<N;i++)
+   {
+      if (!st->update_prob[i] || ps[i] < noise[i])
+         noise[i] = MAX32(0, beta_1*noise[i] + beta*ps[i]);
+   }
+}
+
+#define OVERRIDE_COMPUTE_SNR
+static void compute_snr(SpeexPreprocessState *st, int len)
+{
+   int i;
+   const __m128 one = _mm_set1_ps(1.f);
+   const __m128 hundred = _mm_set1_ps(100.f);
+   const __m128 zero = _mm_setzero_ps();
+
+   for (i=0;i+3<len;i+=4)
+   {
+      __m128 old = _mm_loadu_ps(st->old_ps+i);
+      __m128 tot = _mm_add_ps(one, _mm_loadu_ps(st->noise+i));
+      __m128 post, ratio, gamma, prior;
+      tot = _mm_add_ps(tot, _mm_loadu_ps(st->echo_noise+i));
+      tot = _mm_add_ps(tot, _mm_loadu_ps(st->reverb_estimate+i));
+
+      post = _mm_sub_ps(_mm_div_ps(_mm_loadu_ps(st->ps+i), tot), one);
+      post = _mm_min_ps(post, hundred);
+
+      ratio = _mm_div_ps(old, _mm_add_ps(old, tot));
+      gamma = _mm_add_ps(_mm_set1_ps(.1f), _mm_mul_ps(_mm_set1_ps(.89f), _mm_mul_ps(ratio, ratio)));
+
+      prior = _mm_add_ps(_mm_mul_ps(gamma, _mm_max_ps(zero, post)),
+                         _mm_mul_ps(_mm_sub_ps(one, gamma), _mm_div_ps(old, tot)));
+      _mm_storeu_ps(st->post+i, post);
+      _mm_storeu_ps(st->prior+i, _mm_min_ps(prior, hundred));
+   }
+   for (;i<len;i++)
+   {
+      float gamma;
+      float tot_noise = 1.f + st->noise[i] + st->echo_noise[i] + st->reverb_estimate[i];
+      st->post[i] = MIN16(st->ps[i]/tot_noise - 1.f, 100.f);
+      gamma = .1f + .89f*SQR(st->old_ps[i]/(st->old_ps[i] + tot_noise));
+      st->prior[i] = gamma*MAX16(0, st->post[i]) + (1.f-gamma)*(st->old_ps[i]/tot_noise);
+      st->prior[i] = MIN16(st->prior[i], 100.f);
+   }
+}
+
+#define OVERRIDE_COMPUTE_GAIN_FLOOR
+static void compute_gain_floor(int noise_suppress, int effective_echo_suppress, float *noise, float *echo, float *gain_floor, int len)
+{
+   int i;
+   float echo_floor;
+   float noise_floor;
+   __m128 nf, ef;
+
+   noise_floor = exp(.2302585f*noise_suppress);
+   echo_floor = exp(.2302585f*effective_echo_suppress);
+   nf = _mm_set1_ps(noise_floor);
+   ef = _mm_set1_ps(echo_floor);
+
+   for (i=0;i+3<len;i+=4)
+   {
+      __m128 n = _mm_loadu_ps(noise+i);
+      __m128 e = _mm_loadu_ps(echo+i);
+      __m128 num = _mm_add_ps(_mm_mul_ps(nf, n), _mm_mul_ps(ef, e));
+      __m128 den = _mm_add_ps(_mm_add_ps(_mm_set1_ps(1.f), n), e);
+      _mm_storeu_ps(gain_floor+i, _mm_div_ps(_mm_sqrt_ps(num), _mm_sqrt_ps(den)));
+   }
+   for (;i<len;i++)
+      gain_floor[i] = sqrt(noise_floor*noise[i] + echo_floor*echo[i])/sqrt(1+noise[i] + echo[i]);
+}
+
+/* hypergeom_gain() of four values, table is looked up per lane */
+static inline __m128 hypergeom_gain4(__m128 x)
+{
+   static const float table[21] = {
+      0.82157f, 1.02017f, 1.20461f, 1.37534f, 1.53363f, 1.68092f, 1.81865f,
+      1.94811f, 2.07038f, 2.18638f, 2.29688f, 2.40255f, 2.50391f, 2.60144f,
+      2.69551f, 2.78647f, 2.87458f, 2.96015f, 3.04333f, 3.12431f, 3.20326f};
+   __m128 x2 = _mm_add_ps(x, x);
+   __m128i ind = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x2, _mm_setzero_ps()), _mm_set1_ps(19.f)));
+   __m128 frac = _mm_sub_ps(x2, _mm_cvtepi32_ps(ind));
+   __m128 lo, hi, in_table, above;
+   int k[4];
+
+   _mm_storeu_si128((__m128i *)k, ind);
+   lo = _mm_setr_ps(table[k[0]], table[k[1]], table[k[2]], table[k[3]]);
+   hi = _mm_setr_ps(table[k[0]+1], table[k[1]+1], table[k[2]+1], table[k[3]+1]);
+
+   in_table = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.f), frac), lo), _mm_mul_ps(frac, hi));
+   in_table = _mm_div_ps(in_table, _mm_sqrt_ps(_mm_add_ps(x, _mm_set1_ps(.0001f))));
+   above = _mm_add_ps(_mm_set1_ps(1.f), _mm_div_ps(_mm_set1_ps(.1296f), x));
+
+   /* ind>19 and ind<0 cases of the scalar version (NaNs of other lanes are dropped) */
+   in_table = _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(x2, _mm_set1_ps(20.f)), above),
+                        _mm_andnot_ps(_mm_cmpge_ps(x2, _mm_set1_ps(20.f)), in_table));
+   return _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(x2, _mm_setzero_ps()), _mm_set1_ps(1.f)),
+                    _mm_andnot_ps(_mm_cmplt_ps(x2, _mm_setzero_ps()), in_table));
+}
+
+#define OVERRIDE_COMPUTE_LINEAR_GAIN
+static void compute_linear_gain(SpeexPreprocessState *st, int N)
+{
+   int i;
+   const __m128 one = _mm_set1_ps(1.f);
+
+   for (i=0;i+3<N;i+=4)
+   {
+      __m128 prior = _mm_loadu_ps(st->prior+i);
+      __m128 bark = _mm_loadu_ps(st->gain+i);
+      __m128 floor = _mm_loadu_ps(st->gain_floor+i);
+      __m128 p = _mm_loadu_ps(st->gain2+i);
+      __m128 prior_ratio, theta, g, old, constrain, tmp;
+
+      /* Wiener filter gain and EM gain with bound */
+      prior_ratio = _mm_div_ps(prior, _mm_add_ps(prior, one));
+      theta = _mm_mul_ps(prior_ratio, _mm_add_ps(one, _mm_loadu_ps(st->post+i)));
+      g = _mm_min_ps(one, _mm_mul_ps(prior_ratio, hypergeom_gain4(theta)));
+
+      /* Constrain the gain to be close to the Bark scale gain */
+      constrain = _mm_cmpgt_ps(_mm_mul_ps(_mm_set1_ps(.333f), g), bark);
+      g = _mm_or_ps(_mm_and_ps(constrain, _mm_mul_ps(_mm_set1_ps(3.f), bark)),
+                    _mm_andnot_ps(constrain, g));
+
+      /* Save old power spectrum */
+      old = _mm_mul_ps(_mm_set1_ps(.2f), _mm_loadu_ps(st->old_ps+i));
+      old = _mm_add_ps(old, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(.8f), _mm_mul_ps(g, g)),
+                                       _mm_loadu_ps(st->ps+i)));
+      _mm_storeu_ps(st->old_ps+i, old);
+
+      /* Apply gain floor */
+      g = _mm_max_ps(g, floor);
+      _mm_storeu_ps(st->gain+i, g);
+
+      /* gain2 = [p*sqrt(gain)+(1-p)*sqrt(gain _floor) ]^2 */
+      tmp = _mm_add_ps(_mm_mul_ps(p, _mm_sqrt_ps(g)),
+                       _mm_mul_ps(_mm_sub_ps(one, p), _mm_sqrt_ps(floor)));
+      _mm_storeu_ps(st->gain2+i, _mm_mul_ps(tmp, tmp));
+   }
+   for (;i<N;i++)
+   {
+      float prior_ratio = st->prior[i]/(st->prior[i] + 1.f);
+      float theta = prior_ratio*(1.f + st->post[i]);
+      float g = MIN32(1.f, prior_ratio*_mm_cvtss_f32(hypergeom_gain4(_mm_set1_ps(theta))));
+      float tmp;
+      float p = st->gain2[i];
+
+      if (.333f*g > st->gain[i])
+         g = 3*st->gain[i];
+      st->gain[i] = g;
+      st->old_ps[i] = .2f*st->old_ps[i] + (.8f*(g*g))*st->ps[i];
+      if (st->gain[i] < st->gain_floor[i])
+         st->gain[i] = st->gain_floor[i];
+      tmp = p*sqrt(st->gain[i]) + (1.f-p)*sqrt(st->gain_floor[i]);
+      st->gain2[i]=tmp*tmp;
+   }
+}
+
+#define OVERRIDE_APPLY_GAIN
+static void apply_gain(float *ft, const float *gain2, int N)
+{
+   int i;
+   for (i=1;i+3<N;i+=4)
+   {
+      /* Each gain applies to the re/im pair of its bin */
+      __m128 g = _mm_loadu_ps(gain2+i);
+      _mm_storeu_ps(ft+2*i-1, _mm_mul_ps(_mm_unpacklo_ps(g, g), _mm_loadu_ps(ft+2*i-1)));
+      _mm_storeu_ps(ft+2*i+3, _mm_mul_ps(_mm_unpackhi_ps(g, g), _mm_loadu_ps(ft+2*i+3)));
+   }
+   for (;i<N;i++)
+   {
+      ft[2*i-1] *= gain2[i];
+      ft[2*i] *= gain2[i];
+   }
+   ft[0] *= gain2[0];
+   ft[2*N-1] *= gain2[N-1];
+}
@@ -3,6 +3,13 @@ var vock = exports;
 vock.cli = require('./vock/cli');
 
 vock.audio = require('./vock/audio');
+vock.frame = require('./vock/frame');
+vock.repacketizer = require('./vock/repacketizer');
+vock.rate = require('./vock/rate');
+vock.udp = require('./vock/udp');
+vock.rtp = require('./vock/rtp');
+vock.relay = require('./vock/relay');
+vock.mcu = require('./vock/mcu');
 vock.socket = require('./vock/socket');
 vock.api = require('./vock/api');
 vock.jitter = require('./vock/jitter');
@@ -6,29 +6,73 @@ var vock = require('../vock'),
 
 var audio = exports;
 
+// Frame durations (msec) supported by Opus and the pipeline
+audio.FRAME_DURATIONS = [ 10, 20, 40, 60 ];
+
 //
-// ### function Audio (rate)
+// ### function Audio (rate, options)
 // #### @rate {Number} Sample rate for input/output
+// #### @options {Object} **optional** Audio options
 // Creates wrapper for binding
 //
-function Audio(rate) {
+function Audio(rate, options) {
   EventEmitter.call(this);
 
-  this.audio = new binding.Audio(rate, rate / 25, rate / 250);
+  options = options || {};
+
+  // Internal sample format: 'int16' or 'float'
+  this.format = options.format || 'int16';
+  var sampleSize = this.format === 'float' ? 4 : 2;
+
+  // Codec frame duration, echo canceller and preprocessor work
+  // with at most 20 msec frames (longer ones hurt their adaptation)
+  this.frameDuration = options.frameDuration || 20;
+  if (audio.FRAME_DURATIONS.indexOf(this.frameDuration) === -1) {
+    throw new Error('Unsupported frame duration: ' + this.frameDuration);
+  }
+  this.cancelDuration = options.cancelDuration ||
+                        Math.min(this.frameDuration, 20);
+
+  // Echo canceller and preprocessor may run on the decimated low band
+  // (i.e. 16000 of 48000), high band gets the gain they applied to it
+  this.cancelRate = options.cancelRate || rate;
+
+  this.audio = new binding.Audio(rate,
+                                 rate * this.frameDuration / 1000 * sampleSize,
+                                 rate / 500 * sampleSize,
+                                 this.format,
+                                 rate * this.cancelDuration / 1000 * sampleSize,
+                                 this.cancelRate);
   this.opus = new binding.Opus(rate, 1);
   this.active = false;
+  this.captureMuted = false;
+
+  // Native preprocessor's features (see setPreprocess)
+  this.preprocess = {
+    denoise: true,
+    agc: true,
+    vad: false,
+    dereverb: false,
+    echoSuppress: true
+  };
+  if (options.preprocess) this.setPreprocess(options.preprocess);
+
+  // Packets received in one event loop tick are decoded in one batch
+  this.pending = { channels: [], packets: [], fecs: [] };
+  this.flushScheduled = false;
 
   this._removeCallbacks();
 };
 util.inherits(Audio, EventEmitter);
 
 //
-// ### function create (rate)
+// ### function create (rate, options)
 // #### @rate {Number} Sample rate for input/output
+// #### @options {Object} **optional** Audio options
 // Wrapper for constructor
 //
-exports.create = function create(rate) {
-  return new Audio(rate);
+exports.create = function create(rate, options) {
+  return new Audio(rate, options);
 };
 
 //
@@ -60,30 +104,195 @@ Audio.prototype.stop = function stop() {
   this.audio.stop();
 };
 
+//
+// ### function getStats ()
+// Returns native pipeline counters and histograms, cumulative since creation:
+// * ring overruns and underruns
+// * echo reference realignments
+// * frames that bypassed echo cancellation (silent playback)
+// * frames that bypassed preprocessing (muted capture, or all its features
+//   are off)
+// * frames VAD considered silent
+// * native playout's concealed, recovered, late and dropped packets
+// * native playout's time-stretched (compressed or expanded) packets
+// * echo canceller (with preprocessor) time, in nanoseconds
+// * preprocessor time, in nanoseconds
+// * resampler time, in nanoseconds
+// * event-loop handoff time, in nanoseconds
+// * device callback sizes, in bytes
+// Histogram bucket `i` counts values in [2^i, 2^(i+1)).
+//
+Audio.prototype.getStats = function getStats() {
+  return this.audio.getStats();
+};
+
+//
+// ### function getLevel (pcm)
+// #### @pcm {Buffer} PCM buffer
+// Returns audio level in -dBov (0 - loudest, 127 - silence)
+//
+Audio.prototype.getLevel = function getLevel(pcm) {
+  var rms = this.audio.getRms(pcm);
+  if (rms === 0) return 127;
+
+  var level = Math.round(-20 * Math.log(rms / 32768) / Math.LN10);
+  return Math.max(0, Math.min(127, level));
+};
+
+//
+// ### function configure (settings)
+// #### @settings {Object} Encoder settings
+// Applies { bitrate, fec, loss, complexity } picked by rate controller
+//
+Audio.prototype.configure = function configure(settings) {
+  try {
+    this.opus.setBitrate(settings.bitrate);
+    this.opus.setFec(settings.fec);
+    this.opus.setPacketLoss(settings.loss);
+    this.opus.setComplexity(settings.complexity);
+  } catch (e) {
+    this.emit('error', e);
+  }
+};
+
 //
 // ### function ondata (pcm)
 // #### @pcm {Buffer} PCM buffer
 // Called when recorded some data from microphone
-// (NOTE: pcm has fixed size there, rate/50 samples)
+// (NOTE: pcm has fixed size there, one frame of `frameDuration` msec).
+// Emits opus packet and its level
 //
 Audio.prototype.ondata = function ondata(pcm) {
+  // Nobody is going to hear it
+  if (this.captureMuted) return;
+
+  try {
+    var level = this.getLevel(pcm);
+    if (this.format === 'float') {
+      this.emit('data', this.opus.encodeFloat(pcm), level);
+    } else {
+      this.emit('data', this.opus.encode(pcm), level);
+    }
+  } catch (e) {
+    this.emit('error', e);
+  }
+};
+
+//
+// ### function play (channel, data, fec)
+// #### @channel {Number} Channel index
+// #### @data {Buffer} Opus buffer (null - conceal lost frame)
+// #### @fec {Boolean} **optional** Recover previous frame from data
+// Queues opus packet for playback, packets of all channels are decoded
+// by the binding right into playback rings at the end of the tick
+//
+Audio.prototype.play = function play(channel, data, fec) {
+  var self = this;
+
+  this.pending.channels.push(channel);
+  this.pending.packets.push(data ? data : null);
+  this.pending.fecs.push(!!fec);
+
+  if (this.flushScheduled) return;
+  this.flushScheduled = true;
+  setImmediate(function() {
+    self.flush();
+  });
+};
+
+//
+// ### function push (channel, seq, data)
+// #### @channel {Number} Channel index
+// #### @seq {Number} Packet's sequence number
+// #### @data {Buffer} Opus packet
+// Queues packet to the native jitter buffer of channel, output thread
+// decodes (or conceals) it when it's time to play
+//
+Audio.prototype.push = function push(channel, seq, data) {
   try {
-    this.emit('data', this.opus.encode(pcm));
+    this.audio.playoutPush(channel, seq >>> 0, data);
   } catch (e) {
     this.emit('error', e);
   }
 };
 
 //
-// ### function play (channel, data)
-// #### @data {Buffer} Opus buffer
-// Enqueue some PCM data for playback
+// ### function flush ()
+// Decodes and enqueues pending packets
 //
-Audio.prototype.play = function play(channel, data) {
+Audio.prototype.flush = function flush() {
+  var pending = this.pending;
+
+  this.flushScheduled = false;
+  if (pending.packets.length === 0) return;
+  this.pending = { channels: [], packets: [], fecs: [] };
+
   try {
-    var pcm = this.opus.decode(data ? data : null);
-    this.audio.enqueue(channel, pcm);
+    var failed = this.audio.decodeAndEnqueueBatch(pending.channels,
+                                                  pending.packets,
+                                                  pending.fecs);
+    if (failed !== 0) {
+      this.emit('error', new Error('Failed to decode ' + failed + ' packets'));
+    }
   } catch (e) {
     this.emit('error', e);
   }
 };
+
+//
+// ### function setGain (channel, gain)
+// #### @channel {Number} Channel index
+// #### @gain {Number} Linear gain (1 - unchanged)
+// Sets channel's playback volume, applied by the native mixer
+//
+Audio.prototype.setGain = function setGain(channel, gain) {
+  this.audio.setGain(channel, gain);
+};
+
+//
+// ### function setMute (channel, muted)
+// #### @channel {Number} Channel index
+// #### @muted {Boolean} Mute or unmute
+// Mutes channel's playback (its packets are still decoded)
+//
+Audio.prototype.setMute = function setMute(channel, muted) {
+  this.audio.setMute(channel, !!muted);
+};
+
+//
+// ### function setCaptureMute (muted)
+// #### @muted {Boolean} Mute or unmute
+// Stops encoding microphone's data, native preprocessor keeps only
+// its noise estimate meanwhile
+//
+Audio.prototype.setCaptureMute = function setCaptureMute(muted) {
+  this.captureMuted = !!muted;
+  this.audio.setCaptureMute(this.captureMuted);
+};
+
+//
+// ### function setPreprocess (options)
+// #### @options {Object} Features to change: `denoise`, `agc`, `vad`,
+// `dereverb` and `echoSuppress` (residual echo suppression) booleans
+// Switches native preprocessor's features. They share one spectral
+// analysis, which is the bulk of the cost (see `preprocessTime` in
+// getStats()), so it's saved only when all of them are off. `dereverb`
+// has no effect with the bundled speex.
+//
+Audio.prototype.setPreprocess = function setPreprocess(options) {
+  var preprocess = this.preprocess;
+  Object.keys(preprocess).forEach(function(name) {
+    if (options.hasOwnProperty(name)) preprocess[name] = !!options[name];
+  });
+  this.audio.setPreprocess(preprocess);
+};
+
+//
+// ### function reset (channel)
+// #### @channel {Number} Channel index
+// Drops channel's decoder state (i.e. once its peer is gone)
+//
+Audio.prototype.reset = function reset(channel) {
+  this.flush();
+  this.audio.resetChannel(channel);
+};
@@ -20,6 +20,7 @@ function Cli(argv) {
        .file({ file: path.resolve(process.env.HOME, '.vock.json') });
 
   this.argv.keyFile = argv['key-file'] || nconf.get('key-file');
+  this.argv.cancelRate = argv['cancel-rate'];
 
   this.cmd = argv._[0],
   this.serverHost = argv.server || argv.s || 'vock.in:43210';
@@ -80,11 +81,40 @@ Cli.prototype.run = function run() {
     self.initEncryption(function(err) {
       if (err) throw err;
 
-      self.onServerAddr(info.address, info.port);
+      self.initRelays(function() {
+        self.onServerAddr(info.address, info.port);
+      });
     });
   });
 };
 
+// Resolves SFU relay and MCU addresses
+Cli.prototype.initRelays = function initRelays(callback) {
+  var self = this,
+      keys = [ 'sfu', 'mcu' ].filter(function(key) {
+        return typeof self.argv[key] === 'string';
+      });
+
+  this.argv.sfu = this.argv.sfu || null;
+  this.argv.mcu = this.argv.mcu || null;
+
+  if (keys.length === 0) return callback();
+
+  var key = keys[0];
+  vock.cli.utils.getAddress(this.argv[key], function(err, info) {
+    if (err) {
+      self.logger.write('Failed to find %s\'s IP address %s'.red,
+                        key.toUpperCase(),
+                        info);
+      process.exit(1);
+      return;
+    }
+
+    self.argv[key] = { address: info.address, port: +info.port };
+    self.initRelays(callback);
+  });
+};
+
 Cli.prototype.notify = function notify(text) {
   growl(text, {
     title: 'Vock'
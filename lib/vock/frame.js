@@ -0,0 +1,285 @@
+var binding = require('bindings')('vock.node'),
+    crypto = require('crypto'),
+    Buffer = require('buffer').Buffer;
+
+var frame = exports;
+
+frame.MAGIC = 0xc1;
+frame.HEADER_SIZE = binding.frameHeaderSize;
+frame.TAG_SIZE = binding.sealerTagSize;
+frame.RTP_HEADER_SIZE = binding.rtpHeaderSize;
+
+frame.flags = {
+  encrypted: 1
+};
+
+// Frames are carved out of this slab, sliced buffers keep it alive
+// until sent
+var slabSize = 64 * 1024,
+    slab = null,
+    slabOffset = 0;
+
+//
+// ### function alloc (size)
+// Internal, returns slab offset to write `size` bytes at
+//
+function alloc(size) {
+  if (slab === null || slabOffset + size > slab.length) {
+    slab = new Buffer(Math.max(slabSize, size));
+    slabOffset = 0;
+  }
+
+  return slabOffset;
+}
+
+//
+// ### function isFrame (raw)
+// #### @raw {Buffer} Incoming datagram
+// Returns true if raw is a binary frame (and not a msgpack packet)
+//
+frame.isFrame = function isFrame(raw) {
+  return raw.length >= frame.HEADER_SIZE && raw[0] === frame.MAGIC;
+};
+
+//
+// ### function encode (group, flags, seq, ts, payload, headroom)
+// #### @group {Number} Group ID
+// #### @flags {Number} Frame flags
+// #### @seq {Number} Sequence number
+// #### @ts {Number} Timestamp
+// #### @payload {Buffer} Frame payload
+// #### @headroom {Number} **optional** Bytes to reserve before frame
+// Serializes frame into a preallocated slab
+//
+frame.encode = function encode(group, flags, seq, ts, payload, headroom) {
+  headroom = headroom || 0;
+
+  var start = alloc(headroom + frame.HEADER_SIZE + payload.length);
+  slabOffset += headroom;
+  slabOffset += binding.encodeFrame(slab,
+                                    slabOffset,
+                                    group,
+                                    flags,
+                                    seq >>> 0,
+                                    ts >>> 0,
+                                    payload);
+
+  return slab.slice(start, slabOffset);
+};
+
+//
+// ### function decode (raw)
+// #### @raw {Buffer} Binary frame
+// Returns { group, flags, seq, ts, data } or null if raw isn't a frame
+//
+frame.decode = function decode(raw) {
+  var packet = {
+    group: 0,
+    flags: 0,
+    seq: 0,
+    ts: 0,
+    data: null
+  };
+
+  if (!binding.decodeFrame(raw, packet)) return null;
+  packet.data = raw.slice(frame.HEADER_SIZE);
+
+  return packet;
+};
+
+//
+// ### function Sealer (txKey, rxKey)
+// #### @txKey {Buffer} 32-byte key for sealing outgoing frames
+// #### @rxKey {Buffer} 32-byte key for opening incoming frames
+// AES-256-GCM frame sealer
+//
+function Sealer(txKey, rxKey) {
+  this.sealer = new binding.Sealer(txKey, rxKey);
+};
+frame.Sealer = Sealer;
+
+//
+// ### function createSealer (secret, ownKey, remoteKey)
+// #### @secret {Buffer} Diffie-Hellman secret
+// #### @ownKey {String|Buffer} Our Diffie-Hellman public key
+// #### @remoteKey {String|Buffer} Remote side's Diffie-Hellman public key
+// Creates sealer for peer session, keys for both directions are derived once
+//
+frame.createSealer = function createSealer(secret, ownKey, remoteKey) {
+  return new Sealer(Sealer.deriveKey(secret, ownKey),
+                    Sealer.deriveKey(secret, remoteKey));
+};
+
+//
+// ### function createKeySealer (txKey, rxKey)
+// Constructor wrapper, for frames sealed with explicit keys
+// (i.e. sender's media key in SFU mode)
+//
+frame.createKeySealer = function createKeySealer(txKey, rxKey) {
+  return new Sealer(txKey, rxKey);
+};
+
+//
+// ### function deriveKey (secret, publicKey)
+// #### @secret {Buffer} Diffie-Hellman secret
+// #### @publicKey {String|Buffer} Sender's Diffie-Hellman public key
+// Returns sending key of the side owning `publicKey`
+//
+Sealer.deriveKey = function deriveKey(secret, publicKey) {
+  return new Buffer(crypto.createHash('sha256')
+                          .update(secret)
+                          .update(publicKey)
+                          .digest('binary'), 'binary');
+};
+
+//
+// ### function seal (group, seq, ts, payload, headroom)
+// #### @group {Number} Group ID
+// #### @seq {Number} Sequence number
+// #### @ts {Number} Timestamp
+// #### @payload {Buffer} Frame payload
+// #### @headroom {Number} **optional** Bytes to reserve before frame
+// Returns sealed frame (preceded by `headroom` uninitialized bytes)
+//
+Sealer.prototype.seal = function seal(group, seq, ts, payload, headroom) {
+  headroom = headroom || 0;
+
+  var start = alloc(headroom +
+                    frame.HEADER_SIZE +
+                    payload.length +
+                    frame.TAG_SIZE);
+  slabOffset += headroom;
+  slabOffset += this.sealer.seal(slab,
+                                 slabOffset,
+                                 group,
+                                 seq >>> 0,
+                                 ts >>> 0,
+                                 payload);
+
+  return slab.slice(start, slabOffset);
+};
+
+//
+// ### function sealBatch (group, seq, ts, payloads)
+// #### @group {Number} Group ID
+// #### @seq {Number} Sequence number of the first frame
+// #### @ts {Number} Timestamp
+// #### @payloads {Array} Frame payloads
+// Returns Array of sealed frames with consecutive sequence numbers
+//
+Sealer.prototype.sealBatch = function sealBatch(group, seq, ts, payloads) {
+  var total = 0;
+  for (var i = 0; i < payloads.length; i++) {
+    total += frame.HEADER_SIZE + payloads[i].length + frame.TAG_SIZE;
+  }
+
+  var start = alloc(total),
+      sizes = this.sealer.sealBatch(slab,
+                                    start,
+                                    group,
+                                    seq >>> 0,
+                                    ts >>> 0,
+                                    payloads);
+
+  return sizes.map(function(size) {
+    var res = slab.slice(slabOffset, slabOffset + size);
+    slabOffset += size;
+    return res;
+  });
+};
+
+//
+// ### function open (raw)
+// #### @raw {Buffer} Sealed frame
+// Decrypts frame in place.
+// Returns { group, flags, seq, ts, data } or null if frame is forged
+//
+Sealer.prototype.open = function open(raw) {
+  var packet = {
+    group: 0,
+    flags: 0,
+    seq: 0,
+    ts: 0,
+    data: null
+  };
+
+  var size = this.sealer.open(raw, packet);
+  if (size < 0) return null;
+  packet.data = raw.slice(frame.HEADER_SIZE, frame.HEADER_SIZE + size);
+
+  return packet;
+};
+
+//
+// ### function openBatch (raws)
+// #### @raws {Array} Sealed frames
+// Same as open() for multiple frames at once
+//
+Sealer.prototype.openBatch = function openBatch(raws) {
+  var packets = raws.map(function() {
+    return { group: 0, flags: 0, seq: 0, ts: 0, data: null, length: -1 };
+  });
+
+  this.sealer.openBatch(raws, packets);
+
+  return packets.map(function(packet, i) {
+    if (packet.length < 0) return null;
+
+    packet.data = raws[i].slice(frame.HEADER_SIZE,
+                                frame.HEADER_SIZE + packet.length);
+    delete packet.length;
+    return packet;
+  });
+};
+
+//
+// ### function sealRtp (marker, seq, ts, ssrc, roc, payload)
+// #### @marker {Boolean} RTP marker bit (first packet after silence)
+// #### @seq {Number} 16bit sequence number
+// #### @ts {Number} Media timestamp
+// #### @ssrc {Number} Synchronization source
+// #### @roc {Number} Rollover counter of sequence numbers
+// #### @payload {Buffer} Opus packet
+// Returns sealed RTP packet
+//
+Sealer.prototype.sealRtp = function sealRtp(marker,
+                                            seq,
+                                            ts,
+                                            ssrc,
+                                            roc,
+                                            payload) {
+  var start = alloc(frame.RTP_HEADER_SIZE + payload.length + frame.TAG_SIZE);
+  slabOffset += this.sealer.sealRtp(slab,
+                                    slabOffset,
+                                    marker,
+                                    seq & 0xffff,
+                                    ts >>> 0,
+                                    ssrc >>> 0,
+                                    roc >>> 0,
+                                    payload);
+
+  return slab.slice(start, slabOffset);
+};
+
+//
+// ### function openRtp (raw, roc)
+// #### @raw {Buffer} Sealed RTP packet
+// #### @roc {Number} Rollover counter estimated by receiver
+// Decrypts packet in place.
+// Returns { marker, seq, ts, ssrc, data } or null if packet is forged
+//
+Sealer.prototype.openRtp = function openRtp(raw, roc) {
+  var packet = {
+    marker: false,
+    seq: 0,
+    ts: 0,
+    ssrc: 0,
+    data: null
+  };
+
+  var size = this.sealer.openRtp(raw, packet, roc >>> 0);
+  if (size < 0) return null;
+  packet.data = raw.slice(frame.RTP_HEADER_SIZE, frame.RTP_HEADER_SIZE + size);
+
+  return packet;
+};
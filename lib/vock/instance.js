@@ -20,24 +20,49 @@ function Instance(options) {
   this.options = options;
   this.muted = options.mute || false;
 
+  // Mixer works with 20 msec frames only
+  if (this.options.mcu) this.options.frame = 20;
+
   // Create audio unit
-  this.audio = vock.audio.create(this.options.rate || 48000);
+  this.audio = vock.audio.create(this.options.rate || 48000, {
+    format: this.options.float ? 'float' : 'int16',
+    frameDuration: this.options.frame || 20,
+    cancelRate: this.options.cancelRate
+  });
+  this.audio.setCaptureMute(this.muted);
   this.audio.start();
 
   this.socket = vock.socket.create(this.options);
   this.api = vock.api.create(this, this.options.server);
 
+  // SFU relay client, voice is published once instead of sending it
+  // to every peer
+  this.sfu = this.options.sfu ? vock.relay.createClient() : null;
+  this.sources = {};
+
+  // MCU client, voice of all peers comes back as a single mixed stream
+  this.mcu = this.options.mcu ? vock.mcu.createClient() : null;
+  this.mixJitter = vock.jitter.create(33);
+  this.mixSeq = -1;
+
+  // Encoder settings follow receivers' reports
+  this.rate = vock.rate.createController();
+
   this.authActive = false;
   this.authQueue = [];
   this.authCache = {};
 
   // Peers hashmap
   this.peers = {};
+  this.channels = {};
   this.peerIndexes = [];
   for (var i = 0; i < 64; i++) {
     this.peerIndexes.push(i);
   }
 
+  // Mixed stream is played on its own channel
+  this.mixIndex = this.mcu ? this.peerIndexes.shift() : null;
+
   // DHT
   this.dht = null;
   this.adIds = {};
@@ -97,6 +122,56 @@ Instance.prototype.init = function init() {
     peer.receive(packet);
   });
 
+  // Voice forwarded by SFU relay or mixed by MCU
+  this.socket.on('relay', function(raw, rinfo) {
+    if (self.sfu &&
+        rinfo.address === self.options.sfu.address &&
+        rinfo.port == self.options.sfu.port) {
+      var peer = self.sources[raw.readUInt32BE(4)];
+      if (peer) {
+        peer.receiveMedia(raw.slice(vock.relay.HEADER_SIZE),
+                          raw[2] === vock.relay.ops.resume);
+      }
+    } else if (self.mcu &&
+               rinfo.address === self.options.mcu.address &&
+               rinfo.port == self.options.mcu.port) {
+      var packet = vock.mcu.decode(raw);
+      if (packet) self.mixJitter.write(packet);
+    }
+  });
+
+  [ this.sfu, this.mcu ].forEach(function(client) {
+    if (!client) return;
+
+    var target = client === self.sfu ? self.options.sfu : self.options.mcu;
+    client.on('data', function(packet) {
+      self.socket.send(packet, target);
+    });
+
+    this.audio.on('data', function(data, level) {
+      if (!self.muted) client.publish(data, level);
+    });
+  }, this);
+
+  // Apply encoder settings
+  this.rate.on('change', function(settings) {
+    self.audio.configure(settings);
+    Object.keys(self.peers).forEach(function(id) {
+      self.peers[id].aggregator.setMinFrames(settings.frames);
+    });
+  });
+
+  // Play mixed stream, concealing lost frames
+  this.mixJitter.on('data', function(packet) {
+    // Late frame (but not a restarted stream)
+    if (packet.seq <= self.mixSeq && self.mixSeq - packet.seq < 50) return;
+    if (self.mixSeq !== -1 && packet.seq !== self.mixSeq + 1) {
+      self.audio.play(self.mixIndex, null);
+    }
+    self.mixSeq = packet.seq;
+    self.audio.play(self.mixIndex, packet.data);
+  });
+
   // Initiate dht
   this.socket.once('init', function() {
     self.dht = dht.node.create(utile.mixin({}, self.options.dht || {}, {
@@ -178,18 +253,35 @@ Instance.prototype.getPeer = function getPeer(info) {
   }
 
   this.peers[id] = peer;
+  this.channels[id] = index;
 
   // Attach audio to peer
+  // (unless remote side receives it from SFU relay or MCU)
   function onAudio(data) {
-    if (!self.muted) {
-      peer.sendVoice(data);
-    }
+    if (self.muted || self.mcu) return;
+    if (!self.sfu || peer.mediaSource === null) peer.sendVoice(data);
   }
   this.audio.on('data', onAudio);
 
   // Mix in peer's voice data
-  peer.on('voice', function(frame) {
-    self.audio.play(index, frame);
+  peer.on('voice', function(frame, fec) {
+    self.audio.play(index, frame, fec);
+  });
+  peer.on('packet', function(seq, data) {
+    self.audio.push(index, seq, data);
+  });
+
+  // Remote side's report on our voice
+  peer.on('report', function(report) {
+    self.rate.update(peer.id, report);
+  });
+  if (this.rate.settings !== null) {
+    peer.aggregator.setMinFrames(this.rate.settings.frames);
+  }
+
+  // Remote side publishes its voice through SFU relay
+  peer.on('media', function(source) {
+    self.sources[source] = peer;
   });
 
   // Broadcast instance's text
@@ -222,9 +314,13 @@ Instance.prototype.getPeer = function getPeer(info) {
   // Detach peer on close
   peer.once('close', function(reason) {
     delete self.peers[id];
+    delete self.channels[id];
     self.peerIndexes.push(index);
+    self.audio.reset(index);
     self.audio.removeListener('data', onAudio);
     self.removeListener('text', onText);
+    self.rate.remove(peer.id);
+    if (peer.mediaSource !== null) delete self.sources[peer.mediaSource];
 
     self.emit('peer:close', info, reason, peer.id);
   });
@@ -236,6 +332,12 @@ Instance.prototype.getPeer = function getPeer(info) {
   });
 
   peer.once('connect', function() {
+    if (self.sfu) {
+      self.sfu.join(peer.roomId);
+      peer.sendMediaKey(self.sfu.source, self.sfu.key);
+    }
+    if (self.mcu) self.mcu.join(peer.roomId);
+
     self.emit('peer:connect', info, {
       id: peer.id,
       mode: peer.mode
@@ -260,9 +362,26 @@ Instance.prototype.sendText = function sendText(text) {
 //
 Instance.prototype.toggleMute = function toggleMute() {
   this.muted = !this.muted;
+  this.audio.setCaptureMute(this.muted);
   return this.muted;
 };
 
+//
+// ### function setVolume (fingerprint, gain, muted)
+// #### @fingerprint {String} Peer's hex fingerprint
+// #### @gain {Number} Linear gain (1 - unchanged)
+// #### @muted {Boolean} **optional** Mute peer's voice
+// Sets playback volume of peer's voice
+//
+Instance.prototype.setVolume = function setVolume(fingerprint, gain, muted) {
+  Object.keys(this.peers).forEach(function(id) {
+    if (this.peers[id].fingerprint !== fingerprint) return;
+
+    this.audio.setGain(this.channels[id], gain);
+    this.audio.setMute(this.channels[id], !!muted);
+  }, this);
+};
+
 //
 // ### function isAuthorized (fingerprint, callback)
 // #### @fingerprint {String} Hex fingerprint
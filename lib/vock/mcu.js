@@ -0,0 +1,52 @@
+var vock = require('../vock'),
+    binding = require('bindings')('vock.node'),
+    os = require('os'),
+    util = require('util');
+
+var mcu = exports;
+
+//
+// ### function Server (options)
+// #### @options {Object} **optional** Server options
+// Headless mixer. Every listener receives a single stream: mix of the
+// room's active speakers without its own voice. Rooms are mixed by native
+// worker threads (one per CPU by default), only control messages reach JS.
+// Clients talk to it with relay packets, see `vock.relay`.
+//
+function Server(options) {
+  options = options || {};
+
+  vock.relay.Server.call(this,
+                         options,
+                         new binding.Mcu(options.rate || 48000,
+                                         options.threads || os.cpus().length));
+  this.protocol = 'mcu';
+};
+util.inherits(Server, vock.relay.Server);
+mcu.Server = Server;
+
+//
+// ### function createServer (options)
+// Constructor wrapper
+//
+mcu.createServer = function createServer(options) {
+  return new Server(options);
+};
+
+//
+// ### function createClient ()
+// Returns relay client publishing unsealed voice frames to the mixer
+//
+mcu.createClient = function createClient() {
+  return vock.relay.createClient({ protocol: 'mcu' });
+};
+
+//
+// ### function decode (raw)
+// #### @raw {Buffer} Relay packet
+// Returns mixed voice frame { group, flags, seq, ts, data } or null
+//
+mcu.decode = function decode(raw) {
+  if (!vock.relay.isPacket(raw) || raw[2] !== vock.relay.ops.mix) return null;
+  return vock.frame.decode(raw.slice(vock.relay.HEADER_SIZE));
+};
@@ -12,7 +12,8 @@ var groups = {
   'handshake': 0,
   'voice': 1,
   'text': 2,
-  'ackn': 3
+  'ackn': 3,
+  'media': 4
 };
 
 var id = 0;
@@ -47,11 +48,17 @@ function Peer(options) {
   this.options = options;
 
   // Protocol configurations
-  this.version = [0,1];
+  this.version = [0,3];
   this.seqs = {};
   this.recSeqs = {};
   this.lastVoice = 0;
 
+  // Frames in the last received voice packet
+  this.voiceFrames = 1;
+
+  // Frame timestamps are milliseconds since peer creation
+  this.epoch = Date.now();
+
   // Timeouts
   this.intervals = {
     ping: 500,
@@ -60,7 +67,8 @@ function Peer(options) {
     death: 15000,
     wait: 600,
     rel: 1000,
-    relCleanup: 60 * 1000
+    relCleanup: 60 * 1000,
+    rtcp: 5000
   };
 
   // Timers
@@ -69,7 +77,8 @@ function Peer(options) {
     handshake: null,
     connect: null,
     death: null,
-    wait: null
+    wait: null,
+    rtcp: null
   };
 
   // Communication options
@@ -77,6 +86,22 @@ function Peer(options) {
   this.jitter = vock.jitter.create(33);
   this.connecting = false;
 
+  // Voice skips JS jitter buffer, native playout reorders and paces it
+  this.nativePlayout = options.playout === 'native';
+
+  // Smoothed round-trip time (msec), measured with ping/pong
+  this.rtt = null;
+
+  // Loss, jitter and delay of incoming voice, sent back with pings
+  this.report = vock.rate.createReport();
+
+  // Voice frames are merged into bigger packets on slow links
+  this.aggregator = vock.repacketizer.createAggregator({
+    max: options.aggregate === false ? 1 :
+         typeof options.aggregate === 'number' ? options.aggregate : 3,
+    duration: options.frame || 20
+  });
+
   // Encryption options
   this.pripub = pripub.create({
     pri: options.keyFile && fs.readFileSync(options.keyFile),
@@ -86,6 +111,15 @@ function Peer(options) {
   this.dh = crypto.getDiffieHellman('modp14');
   this.dh.generateKeys();
   this.secret = null;
+  this.sealer = null;
+
+  // RTP mode: used for voice only if both sides have enabled it
+  this.rtp = null;
+  this.remoteRtp = false;
+
+  // SFU mode: remote side's media source id and key
+  this.mediaSource = null;
+  this.mediaSealer = null;
 
   this.init();
   this.resetSeqs();
@@ -174,15 +208,28 @@ Peer.prototype.init = function init() {
 
   this.on('connect', function() {
     self.setInterval(function() {
-      self.write('handshake', { type: 'ping' });
+      var packet = { type: 'ping', ts: self.timestamp() },
+          report = self.report.take();
+
+      if (report !== null) packet.rr = report;
+      self.write('handshake', packet);
     }, 'ping');
 
+    // RTCP reports, remote side won't understand them otherwise
+    if (self.options.rtp && self.remoteRtp) {
+      self.setInterval(function() {
+        self.emit('data', self.rtp.report());
+      }, 'rtcp');
+    }
+
     resetTimeout();
   });
   this.on('keepalive', resetTimeout);
 
   this.on('close', function(reason) {
+    self.aggregator.reset();
     self.clearInterval('ping');
+    self.clearInterval('rtcp');
     self.clearTimeout('death');
 
     self.clearInterval('wait');
@@ -190,6 +237,20 @@ Peer.prototype.init = function init() {
     self.clearInterval('handshake');
   });
 
+  // Seal merged voice packets
+  this.aggregator.on('data', function(data, frames) {
+    if (self.options.rtp && self.remoteRtp) {
+      var samples = frames * self.aggregator.duration * vock.rtp.CLOCK_RATE;
+      return self.emit('data', self.rtp.seal(data, samples / 1000));
+    }
+
+    // Voice goes straight into a binary frame, without msgpack
+    var group = groups.voice,
+        seq = self.seqs[group]++;
+
+    self.emit('data', self.sealer.seal(group, seq, self.timestamp(), data));
+  });
+
   // Use packets that jitter has emitted out
   this.jitter.on('data', function(packet) {
     try {
@@ -210,19 +271,26 @@ Peer.prototype.write = function write(group, packet) {
   packet.group = groups[group];
   packet.seq = this.seqs[packet.group]++;
 
-  if (!this.secret || group === 'handshake') {
+  if (!this.sealer || group === 'handshake') {
     this.emit('data', packet);
   } else {
-    var cipher = crypto.createCipher('aes256', 'hakamada'),
-        packed = msgpack.encode(packet),
-        enc = Buffer.concat([ cipher.update(packed), cipher.final() ]);
-
-    this.emit('data', enc);
+    this.emit('data', this.sealer.seal(packet.group,
+                                       packet.seq,
+                                       this.timestamp(),
+                                       msgpack.encode(packet)));
   }
 
   return packet.seq;
 };
 
+//
+// ### function timestamp ()
+// Returns frame timestamp
+//
+Peer.prototype.timestamp = function timestamp() {
+  return Date.now() - this.epoch;
+};
+
 //
 // ### function rwrite (group, packet, callback)
 // #### @group {String} Group ID
@@ -263,14 +331,27 @@ Peer.prototype.rwrite = function rwrite(group, packet, callback) {
 
 //
 // ### function sendVoice (data)
-// #### @data {Buffer} PCM data
-// Send voice data
+// #### @data {Buffer} Opus packet
+// Send voice data (possibly merged with the next frames)
 //
 Peer.prototype.sendVoice = function sendVoice(data) {
   if (this.state !== 'accepted') return;
-  this.write('voice', {
-    type: 'voic',
-    data: data
+
+  this.aggregator.write(data);
+};
+
+//
+// ### function sendMediaKey (source, key)
+// #### @source {Number} Our source id on the SFU relay
+// #### @key {Buffer} Key our relayed voice frames are sealed with
+// Lets remote side open voice frames we publish through the relay
+//
+Peer.prototype.sendMediaKey = function sendMediaKey(source, key) {
+  if (this.state !== 'accepted') return;
+  this.rwrite('media', {
+    type: 'mkey',
+    source: source,
+    key: key
   });
 };
 
@@ -310,19 +391,90 @@ Peer.prototype.receive = function receive(packet) {
 
   if (packet instanceof Buffer) {
     // Ignore encrypted packets before handshake is finished
-    if (!this.secret) return;
-
-    // Decrypt packet
-    var decipher = crypto.createDecipher('aes256', 'hakamada'),
-        dec = Buffer.concat([ decipher.update(packet), decipher.final() ]);
+    if (!this.sealer) return;
+
+    if (vock.rtp.isControl(packet)) return this.handleControl(packet);
+
+    // Voice in RTP packets, media timestamps are converted to msec
+    if (vock.rtp.isPacket(packet)) {
+      var p = this.rtp.open(packet);
+      if (p === null) return;
+
+      var ts = Math.round(p.ts * 1000 / vock.rtp.CLOCK_RATE);
+      this.report.onPacket(p.seq, ts);
+      return this.writeVoice({
+        group: groups.voice,
+        seq: p.seq,
+        ts: ts,
+        type: 'voic',
+        data: p.data
+      });
+    }
 
-    packet = msgpack.decode(dec);
+    // Only sealed frames are allowed after handshake,
+    // forged and corrupted ones are ignored
+    var f = this.sealer.open(packet);
+    if (f === null) return;
+
+    if (f.group === groups.voice) {
+      this.report.onPacket(f.seq, f.ts);
+      return this.writeVoice({
+        group: f.group,
+        seq: f.seq,
+        ts: f.ts,
+        type: 'voic',
+        data: f.data
+      });
+    } else {
+      packet = msgpack.decode(f.data);
+      if (!packet) return;
+      packet.group = f.group;
+      packet.seq = f.seq;
+      packet.ts = f.ts;
+    }
   }
 
   // Put packet into jitter buffer
   this.jitter.write(packet);
 };
 
+//
+// ### function receiveMedia (raw, resume)
+// #### @raw {Buffer} Voice frame forwarded by SFU relay
+// #### @resume {Boolean} **optional** Relay has filtered out frames before it
+// Handle voice published by remote side through the relay
+//
+Peer.prototype.receiveMedia = function receiveMedia(raw, resume) {
+  if (!this.mediaSealer) return;
+
+  var f = this.mediaSealer.open(raw);
+  if (f === null) return;
+
+  this.report.onPacket(f.seq, f.ts, resume);
+
+  this.writeVoice({
+    group: groups.voice,
+    seq: f.seq,
+    ts: f.ts,
+    type: 'voic',
+    data: f.data
+  });
+};
+
+//
+// ### function writeVoice (packet)
+// #### @packet {Object} Voice packet
+// Puts voice packet into jitter buffer, or with native playout
+// emits 'packet' with its seq and data right away
+//
+Peer.prototype.writeVoice = function writeVoice(packet) {
+  if (!this.nativePlayout) return this.jitter.write(packet);
+
+  if (this.state !== 'accepted') return;
+  this.emit('keepalive');
+  this.emit('packet', packet.seq, packet.data);
+};
+
 //
 // ### function onJitterData (packet)
 // #### @packet {Object} Protocol packet
@@ -348,8 +500,10 @@ Peer.prototype.onJitterData = function onJitterData(packet) {
   // Voice packets should come in a strict order
   if (packet.group === groups.voice &&
       this.recSeqs[packet.group] + 1 !== packet.seq) {
-    // Oh, we lost some voice packets - notify backend about it
-    this.emit('voice', null);
+    // Oh, we lost some voice packets - notify backend about it,
+    // the last lost frame may be recovered from this packet's FEC data
+    for (var i = 1; i < this.voiceFrames; i++) this.emit('voice', null);
+    packet.fec = true;
   }
 
   // Seq should be monotonic
@@ -384,11 +538,13 @@ Peer.prototype.onJitterData = function onJitterData(packet) {
   } else if (packet.type === 'ping') {
     this.handlePing(packet);
   } else if (packet.type === 'pong') {
-    // Ignore pongs
+    this.handlePong(packet);
   } else if (packet.type === 'voic') {
     this.handleVoice(packet);
   } else if (packet.type === 'text') {
     this.handleText(packet);
+  } else if (packet.type === 'mkey') {
+    this.handleMediaKey(packet);
   } else if (packet.type === 'ackn') {
     this.handleAck(packet);
   } else if (packet.type === 'clse') {
@@ -443,7 +599,8 @@ Peer.prototype.handleHello = function handleHello(packet) {
       self.fingerprint = fingerprint;
       self.write('handshake', {
         type: 'acpt',
-        dh: new Buffer(p.encrypt(self.dh.getPublicKey()), 'binary')
+        dh: new Buffer(p.encrypt(self.dh.getPublicKey()), 'binary'),
+        rtp: !!self.options.rtp
       });
 
       if (!self.connecting) self.connect(self.roomId);
@@ -473,12 +630,15 @@ Peer.prototype.handleAccept = function handleAccept(packet) {
   if (!packet.dh) return this.reset();
 
   // Compute diffie-hellman secret
-  this.secret = new Buffer(
-    this.dh.computeSecret(
-      this.pripub.decrypt(packet.dh).toString()
-    ),
-    'binary'
-  );
+  var remoteKey = this.pripub.decrypt(packet.dh).toString();
+  this.secret = new Buffer(this.dh.computeSecret(remoteKey), 'binary');
+
+  // Derive per-direction frame keys from it
+  this.sealer = vock.frame.createSealer(this.secret,
+                                        this.dh.getPublicKey(),
+                                        remoteKey);
+  this.rtp = vock.rtp.createSession(this.sealer);
+  this.remoteRtp = packet.rtp === true;
 
   this.state = 'accepted';
   this.emit('connect');
@@ -490,18 +650,80 @@ Peer.prototype.handleAccept = function handleAccept(packet) {
 // Handle PING packet
 //
 Peer.prototype.handlePing = function handlePing(packet) {
-  this.write('handshake', { type: 'pong' });
+  this.write('handshake', { type: 'pong', ts: packet.ts });
+
+  // Remote side's report on our voice
+  var rr = packet.rr;
+  if (rr && typeof rr.loss === 'number' &&
+      typeof rr.jitter === 'number' &&
+      typeof rr.delay === 'number') {
+    this.emit('report', rr);
+  }
+};
+
+//
+// ### function handlePong (packet)
+// #### @packet {Object} Packet
+// Handle PONG packet, updates round-trip time estimate (RFC 6298)
+//
+Peer.prototype.handlePong = function handlePong(packet) {
+  // Older peers don't echo timestamp
+  if (typeof packet.ts !== 'number') return;
+
+  var sample = this.timestamp() - packet.ts;
+  if (sample < 0) return;
+
+  this.updateRtt(sample);
+};
+
+//
+// ### function updateRtt (sample)
+// #### @sample {Number} Measured round-trip time (msec)
+// Internal
+//
+Peer.prototype.updateRtt = function updateRtt(sample) {
+  if (this.rtt === null) {
+    this.rtt = sample;
+  } else {
+    this.rtt = 0.875 * this.rtt + 0.125 * sample;
+  }
+
+  this.aggregator.setRtt(this.rtt, this.mode === 'relay');
+};
+
+//
+// ### function handleControl (raw)
+// #### @raw {Buffer} RTCP packet
+// Handle RTCP reports, remote side's view of our RTP stream is emitted
+// as 'rtcp' event (ping reports still drive encoder settings)
+//
+Peer.prototype.handleControl = function handleControl(raw) {
+  if (this.state !== 'accepted' || this.rtp === null) return;
+
+  var report = this.rtp.receiveControl(raw);
+  if (report === null) return;
+
+  if (report.rtt !== null) this.updateRtt(report.rtt);
+  this.emit('rtcp', report);
 };
 
 //
 // ### function handleVoice (packet)
 // #### @packet {Object} packet
-// Handle VOIC packet
+// Handle VOIC packet.
+// Emits 'voice' with every frame, and with `fec` flag set when the
+// frame should be used to recover the previous one
 //
 Peer.prototype.handleVoice = function handleVoice(packet) {
   if (this.state !== 'accepted') return;
 
-  this.emit('voice', packet.data);
+  // Feed merged frames to decoder one by one
+  var frames = vock.repacketizer.split(packet.data);
+  if (frames === null) return;
+
+  this.voiceFrames = frames.length;
+  if (packet.fec) this.emit('voice', frames[0], true);
+  for (var i = 0; i < frames.length; i++) this.emit('voice', frames[i]);
 };
 
 //
@@ -515,6 +737,24 @@ Peer.prototype.handleText = function handleText(packet) {
   this.emit('text', packet.text);
 };
 
+//
+// ### function handleMediaKey (packet)
+// #### @packet {Object} packet
+// Handle MKEY packet
+//
+Peer.prototype.handleMediaKey = function handleMediaKey(packet) {
+  if (this.state !== 'accepted') return;
+  if (typeof packet.source !== 'number' ||
+      !Buffer.isBuffer(packet.key) ||
+      packet.key.length !== 32) {
+    return;
+  }
+
+  this.mediaSource = packet.source;
+  this.mediaSealer = vock.frame.createKeySealer(packet.key, packet.key);
+  this.emit('media', packet.source);
+};
+
 //
 // ### function handleAck (packet)
 // #### @packet {Object} packet
@@ -0,0 +1,231 @@
+var util = require('util'),
+    EventEmitter = require('events').EventEmitter;
+
+var rate = exports;
+
+//
+// ### function Report ()
+// Receiver side statistics of one incoming voice stream,
+// summarized and reset in every report
+//
+function Report() {
+  this.jitter = 0;
+  this.lastTransit = null;
+
+  // Minimal transits of the recent reports, queuing delay is measured
+  // relative to the lowest of them (clocks of peers aren't synchronized)
+  this.minTransits = [];
+  this.historySize = 20;
+
+  this.reset();
+};
+rate.Report = Report;
+
+//
+// ### function createReport ()
+// Constructor wrapper
+//
+rate.createReport = function createReport() {
+  return new Report();
+};
+
+//
+// ### function reset ()
+// Internal
+//
+Report.prototype.reset = function reset() {
+  this.baseSeq = null;
+  this.maxSeq = null;
+  this.received = 0;
+  this.skipped = 0;
+  this.transitSum = 0;
+  this.minTransit = null;
+};
+
+//
+// ### function onPacket (seq, ts, resume)
+// #### @seq {Number} Frame sequence number
+// #### @ts {Number} Frame timestamp
+// #### @resume {Boolean} **optional** Frames before it were dropped on purpose
+// Accounts voice frame as soon as it arrives (before jitter buffer).
+// Frames skipped before a `resume` one (SFU relay's filter) aren't lost.
+//
+Report.prototype.onPacket = function onPacket(seq, ts, resume) {
+  if (this.baseSeq === null) {
+    this.baseSeq = seq;
+    this.maxSeq = seq;
+  } else if (seq > this.maxSeq) {
+    if (resume) this.skipped += seq - this.maxSeq - 1;
+    this.maxSeq = seq;
+  } else if (seq < this.baseSeq) {
+    // Late frame from the previous report
+    if (this.baseSeq - seq < 100) return;
+
+    // Or sender has restarted
+    this.reset();
+    this.baseSeq = seq;
+    this.maxSeq = seq;
+  }
+  this.received++;
+
+  // Interarrival jitter (RFC 3550)
+  var transit = Date.now() - ts;
+  if (this.lastTransit !== null) {
+    var d = Math.abs(transit - this.lastTransit);
+    this.jitter += (d - this.jitter) / 16;
+  }
+  this.lastTransit = transit;
+
+  this.transitSum += transit;
+  if (this.minTransit === null || transit < this.minTransit) {
+    this.minTransit = transit;
+  }
+};
+
+//
+// ### function take ()
+// Returns { loss, jitter, delay } since the previous call,
+// or null if nothing was received:
+// loss is a fraction of lost frames, jitter and queuing delay are in msec
+//
+Report.prototype.take = function take() {
+  if (this.received === 0) return null;
+
+  this.minTransits.push(this.minTransit);
+  if (this.minTransits.length > this.historySize) this.minTransits.shift();
+
+  var expected = this.maxSeq - this.baseSeq + 1 - this.skipped,
+      base = Math.min.apply(Math, this.minTransits),
+      report = {
+        loss: Math.max(0, expected - this.received) / expected,
+        jitter: Math.round(this.jitter),
+        delay: Math.round(this.transitSum / this.received - base)
+      },
+      next = this.maxSeq + 1;
+
+  this.reset();
+  this.baseSeq = next;
+  this.maxSeq = next - 1;
+
+  return report;
+};
+
+//
+// ### function Controller (options)
+// #### @options {Object} **optional** Controller options
+// Sender side controller, picks encoder settings from reports of all
+// receivers. Since voice is encoded once for everyone, the worst
+// receiver drives it.
+// Emits 'change' with { bitrate, fec, loss, complexity, frames }.
+//
+function Controller(options) {
+  EventEmitter.call(this);
+
+  options = options || {};
+
+  this.min = options.min || 8000;
+  this.max = options.max || 64000;
+  this.bitrate = options.bitrate || 32000;
+
+  // Smoothed worst loss
+  this.loss = 0;
+  this.reports = {};
+
+  // Back off at once, but probe upwards slowly
+  this.lastIncrease = 0;
+  this.increaseInterval = 1000;
+
+  this.settings = null;
+};
+util.inherits(Controller, EventEmitter);
+rate.Controller = Controller;
+
+//
+// ### function createController (options)
+// Constructor wrapper
+//
+rate.createController = function createController(options) {
+  return new Controller(options);
+};
+
+//
+// ### function update (id, report)
+// #### @id {String|Number} Receiver id
+// #### @report {Object} Receiver report
+// Accounts report and updates encoder settings. Only the new report can
+// back off, so every report cuts bitrate at most once. Stored reports of
+// other receivers only hold back increases.
+//
+Controller.prototype.update = function update(id, report) {
+  this.reports[id] = report;
+
+  var worst = { loss: 0, jitter: 0, delay: 0 };
+  Object.keys(this.reports).forEach(function(id) {
+    var r = this.reports[id];
+    worst.loss = Math.max(worst.loss, r.loss);
+    worst.jitter = Math.max(worst.jitter, r.jitter);
+    worst.delay = Math.max(worst.delay, r.delay);
+  }, this);
+
+  this.loss = 0.75 * this.loss + 0.25 * worst.loss;
+
+  var now = Date.now();
+  if (report.loss > 0.1) {
+    // Heavy loss - congestion
+    this.bitrate *= 1 - 0.5 * report.loss;
+  } else if (report.delay > 100 || report.jitter > 50) {
+    // Queues are growing
+    this.bitrate *= 0.85;
+  } else if (worst.loss < 0.02 &&
+             worst.delay < 30 &&
+             worst.jitter <= 50 &&
+             now - this.lastIncrease >= this.increaseInterval) {
+    this.bitrate = this.bitrate * 1.08 + 1000;
+    this.lastIncrease = now;
+  }
+  this.bitrate = Math.round(Math.max(this.min,
+                                     Math.min(this.max, this.bitrate)));
+
+  this.apply();
+};
+
+//
+// ### function remove (id)
+// #### @id {String|Number} Receiver id
+// Forgets receiver (i.e. peer has disconnected)
+//
+Controller.prototype.remove = function remove(id) {
+  delete this.reports[id];
+};
+
+//
+// ### function apply ()
+// Internal, derives encoder settings from bitrate and loss
+//
+Controller.prototype.apply = function apply() {
+  var loss = Math.round(this.loss * 100),
+      settings = {
+        bitrate: this.bitrate,
+
+        // Redundancy is worth its bits only when something is lost
+        fec: loss >= 1,
+        loss: Math.min(loss, 30),
+
+        // Spend CPU where every bit counts
+        complexity: this.bitrate < 16000 ? 10 : 8,
+
+        // Headers take a noticeable share of small packets
+        frames: this.bitrate < 12000 ? 3 : this.bitrate < 20000 ? 2 : 1
+      },
+      old = this.settings;
+
+  if (old !== null &&
+      Object.keys(settings).every(function(key) {
+        return settings[key] === old[key];
+      })) {
+    return;
+  }
+
+  this.settings = settings;
+  this.emit('change', settings);
+};
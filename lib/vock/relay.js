@@ -0,0 +1,313 @@
+var vock = require('../vock'),
+    binding = require('bindings')('vock.node'),
+    crypto = require('crypto'),
+    util = require('util'),
+    msgpack = require('msgpack-js'),
+    Buffer = require('buffer').Buffer,
+    EventEmitter = require('events').EventEmitter;
+
+var relay = exports;
+
+relay.MAGIC = 0xc2;
+relay.VERSION = 1;
+relay.HEADER_SIZE = 8;
+
+// Speaker level is in -dBov (RFC 6464)
+relay.SILENCE = 127;
+
+relay.ops = {
+  publish: 1,
+  forward: 2,
+  mix: 3,
+
+  // Forward after some frames of the source were filtered out
+  resume: 4
+};
+
+// Media frames are sealed as voice
+relay.GROUP = 1;
+
+//
+// ### function isPacket (raw)
+// #### @raw {Buffer} Incoming datagram
+// Returns true if raw is a relay packet
+//
+relay.isPacket = function isPacket(raw) {
+  return raw.length >= relay.HEADER_SIZE &&
+         raw[0] === relay.MAGIC &&
+         raw[1] === relay.VERSION;
+};
+
+//
+// ### function Server (options, handle)
+// #### @options {Object} **optional** Server options
+// #### @handle {Object} **optional** Binding handle (RelayServer by default)
+// Selective forwarding unit. Every voice frame published by a room member
+// is forwarded by the native code to all other members of the room, only
+// control messages (join/leave) reach JS.
+//
+function Server(options, handle) {
+  EventEmitter.call(this);
+
+  options = options || {};
+
+  this.protocol = 'sfu';
+  this.handle = handle || new binding.RelayServer();
+  this.handle.onmessages = this.onmessages.bind(this);
+  this.port = null;
+
+  // Members which haven't sent join for that long are removed
+  this.timeout = options.timeout || 15000;
+  this.members = {};
+  this.expireTimer = null;
+
+  this.setFilter(options.maxLevel, options.maxSpeakers);
+};
+util.inherits(Server, EventEmitter);
+relay.Server = Server;
+
+//
+// ### function createServer (options)
+// Constructor wrapper
+//
+relay.createServer = function createServer(options) {
+  return new Server(options);
+};
+
+//
+// ### function listen (port, callback)
+// #### @port {Number} Port to bind to (0 - random)
+// #### @callback {Function} **optional** Invoked once server is listening
+// Binds server, throws on failure
+//
+Server.prototype.listen = function listen(port, callback) {
+  var self = this;
+
+  this.port = this.handle.bind(port || 0);
+  this.expireTimer = setInterval(function() {
+    self.expire();
+  }, this.timeout);
+
+  if (callback) this.once('listening', callback);
+  process.nextTick(function() {
+    self.emit('listening');
+  });
+};
+
+//
+// ### function address ()
+// Returns bound address
+//
+Server.prototype.address = function address() {
+  return { address: '0.0.0.0', family: 'IPv4', port: this.port };
+};
+
+//
+// ### function setFilter (maxLevel, maxSpeakers)
+// #### @maxLevel {Number} **optional** Frames quieter than it are dropped
+// #### @maxSpeakers {Number} **optional** Forward only N loudest speakers
+// Sets speaker level filter
+//
+Server.prototype.setFilter = function setFilter(maxLevel, maxSpeakers) {
+  this.handle.setFilter(maxLevel === undefined ? relay.SILENCE : maxLevel,
+                        maxSpeakers || 0);
+};
+
+//
+// ### function getStats ()
+// Returns forwarding counters
+//
+Server.prototype.getStats = function getStats() {
+  var stats = this.handle.getStats();
+  stats.members = Object.keys(this.members).length;
+  return stats;
+};
+
+//
+// ### function close ()
+// Closes server
+//
+Server.prototype.close = function close() {
+  clearInterval(this.expireTimer);
+  this.handle.close();
+  this.members = {};
+  this.port = null;
+  this.emit('close');
+};
+
+//
+// ### function onmessages (buffers, addresses, ports)
+// #### @buffers {Array} Received datagrams
+// #### @addresses {Array} Sender addresses
+// #### @ports {Array} Sender ports
+// Invoked by binding with control messages
+//
+Server.prototype.onmessages = function onmessages(buffers, addresses, ports) {
+  for (var i = 0; i < buffers.length; i++) {
+    try {
+      var msg = msgpack.decode(buffers[i]);
+    } catch (e) {
+      // Ignore decode errors
+      continue;
+    }
+
+    if (!msg || msg.protocol !== this.protocol) continue;
+    this.handleControl(msg, addresses[i], ports[i]);
+  }
+};
+
+//
+// ### function handleControl (msg, address, port)
+// #### @msg {Object} Control message
+// #### @address {String} Sender address
+// #### @port {Number} Sender port
+// Internal
+//
+Server.prototype.handleControl = function handleControl(msg, address, port) {
+  var id = address + '#' + port;
+
+  if (msg.type === 'join') {
+    if (typeof msg.room !== 'string' || typeof msg.source !== 'number') return;
+
+    if (!this.members.hasOwnProperty(id)) this.emit('join', address, port);
+    this.handle.join(address, port, msg.room, msg.source >>> 0);
+    this.members[id] = {
+      address: address,
+      port: port,
+      lastSeen: Date.now()
+    };
+  } else if (msg.type === 'leave') {
+    this.leave(id);
+  }
+};
+
+//
+// ### function leave (id)
+// #### @id {String} Member id
+// Internal
+//
+Server.prototype.leave = function leave(id) {
+  var member = this.members[id];
+  if (!member) return;
+
+  delete this.members[id];
+  this.handle.leave(member.address, member.port);
+  this.emit('leave', member.address, member.port);
+};
+
+//
+// ### function expire ()
+// Removes members that went away without leaving
+//
+Server.prototype.expire = function expire() {
+  var now = Date.now();
+
+  Object.keys(this.members).forEach(function(id) {
+    if (now - this.members[id].lastSeen > this.timeout) this.leave(id);
+  }, this);
+};
+
+//
+// ### function Client (options)
+// #### @options {Object} **optional** Client options
+// SFU client: publishes own voice once to the relay.
+// Frames are sealed with a random media key, which is handed to peers
+// over their encrypted sessions, so relay can't read them.
+// (With `protocol: 'mcu'` frames are sent unsealed, since mixer has to
+// decode them)
+//
+function Client(options) {
+  EventEmitter.call(this);
+
+  options = options || {};
+
+  this.protocol = options.protocol || 'sfu';
+  this.key = crypto.randomBytes(32);
+  this.source = crypto.randomBytes(4).readUInt32BE(0);
+  this.sealer = this.protocol === 'sfu' ?
+      vock.frame.createKeySealer(this.key, this.key) :
+      null;
+  this.seq = 0;
+  this.epoch = Date.now();
+
+  this.room = null;
+  this.joinInterval = 5000;
+  this.joinTimer = null;
+};
+util.inherits(Client, EventEmitter);
+relay.Client = Client;
+
+//
+// ### function createClient (options)
+// Constructor wrapper
+//
+relay.createClient = function createClient(options) {
+  return new Client(options);
+};
+
+//
+// ### function join (roomId)
+// #### @roomId {String} Room id
+// Joins room on relay and keeps membership alive
+//
+Client.prototype.join = function join(roomId) {
+  var self = this,
+      room = crypto.createHash('sha1').update(roomId).digest('hex');
+
+  if (this.room === room) return;
+  this.room = room;
+
+  function send() {
+    self.emit('data', {
+      protocol: self.protocol,
+      type: 'join',
+      room: room,
+      source: self.source
+    });
+  }
+  clearInterval(this.joinTimer);
+  this.joinTimer = setInterval(send, this.joinInterval);
+  send();
+};
+
+//
+// ### function leave ()
+// Leaves room
+//
+Client.prototype.leave = function leave() {
+  if (this.room === null) return;
+
+  clearInterval(this.joinTimer);
+  this.room = null;
+  this.emit('data', { protocol: this.protocol, type: 'leave' });
+};
+
+//
+// ### function publish (data, level)
+// #### @data {Buffer} Opus packet
+// #### @level {Number} **optional** Speaker level in -dBov
+// Seals voice frame and sends it to relay (or mixer)
+//
+Client.prototype.publish = function publish(data, level) {
+  if (this.room === null) return;
+
+  var seq = this.seq++,
+      ts = Date.now() - this.epoch,
+      raw;
+
+  if (this.sealer) {
+    raw = this.sealer.seal(relay.GROUP, seq, ts, data, relay.HEADER_SIZE);
+  } else {
+    raw = vock.frame.encode(relay.GROUP, 0, seq, ts, data, relay.HEADER_SIZE);
+  }
+
+  raw[0] = relay.MAGIC;
+  raw[1] = relay.VERSION;
+  raw[2] = relay.ops.publish;
+  raw[3] = level === undefined ? 0 : Math.min(level, relay.SILENCE);
+
+  // Source is set by relay
+  raw.writeUInt32BE(0, 4);
+
+  this.emit('data', raw);
+};
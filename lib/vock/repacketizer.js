@@ -0,0 +1,167 @@
+var binding = require('bindings')('vock.node'),
+    util = require('util'),
+    EventEmitter = require('events').EventEmitter;
+
+var repacketizer = exports;
+
+// Round-trip times (msec) from which 2 and 3 frames are merged into one
+// packet. Extra 20-40 msec of delay hardly matters on such links, but
+// header overhead (IP, UDP, frame header and tag) is halved or more.
+repacketizer.thresholds = [ 150, 300 ];
+
+//
+// ### function framesFor (rtt, relayed, max)
+// #### @rtt {Number} Smoothed round-trip time or null if not measured yet
+// #### @relayed {Boolean} True if packets go through relay server
+// #### @max {Number} Upper limit
+// Returns number of frames to put in one packet
+//
+repacketizer.framesFor = function framesFor(rtt, relayed, max) {
+  var frames = 1;
+
+  if (rtt !== null) {
+    for (var i = 0; i < repacketizer.thresholds.length; i++) {
+      if (rtt >= repacketizer.thresholds[i]) frames = i + 2;
+    }
+  }
+
+  // Relay adds a hop anyway, and its bandwidth is shared by everyone
+  if (relayed) frames = Math.max(frames, 2);
+
+  return Math.max(1, Math.min(frames, max));
+};
+
+//
+// ### function split (packet)
+// #### @packet {Buffer} Opus packet
+// Returns array of single frame packets or null if packet is corrupted
+//
+repacketizer.split = function split(packet) {
+  return binding.opusSplit(packet);
+};
+
+//
+// ### function Aggregator (options)
+// #### @options {Object} **optional** Aggregator options
+// Merges consecutive Opus frames into multi-frame packets,
+// the number of frames is picked by `setRtt()`.
+// Emits 'data' with packet and number of frames in it
+//
+function Aggregator(options) {
+  EventEmitter.call(this);
+
+  options = options || {};
+
+  this.duration = options.duration || 20;
+
+  // Opus packet can't be longer than 120 msec
+  this.max = Math.min(options.max === undefined ? 3 : options.max,
+                      Math.floor(120 / this.duration));
+  this.frames = 1;
+  this.minFrames = 1;
+  this.rtt = null;
+  this.relayed = false;
+  this.queue = [];
+  this.timer = null;
+};
+util.inherits(Aggregator, EventEmitter);
+repacketizer.Aggregator = Aggregator;
+
+//
+// ### function createAggregator (options)
+// Constructor wrapper
+//
+repacketizer.createAggregator = function createAggregator(options) {
+  return new Aggregator(options);
+};
+
+//
+// ### function setRtt (rtt, relayed)
+// #### @rtt {Number} Smoothed round-trip time
+// #### @relayed {Boolean} True if packets go through relay server
+// Updates number of frames per packet
+//
+Aggregator.prototype.setRtt = function setRtt(rtt, relayed) {
+  this.rtt = rtt;
+  this.relayed = relayed;
+  this.update();
+};
+
+//
+// ### function setMinFrames (frames)
+// #### @frames {Number} Lower limit of frames per packet
+// Lets rate controller trade latency for header overhead
+//
+Aggregator.prototype.setMinFrames = function setMinFrames(frames) {
+  this.minFrames = frames;
+  this.update();
+};
+
+//
+// ### function update ()
+// Internal
+//
+Aggregator.prototype.update = function update() {
+  this.frames = Math.min(this.max,
+                         Math.max(this.minFrames,
+                                  repacketizer.framesFor(this.rtt,
+                                                         this.relayed,
+                                                         this.max)));
+  if (this.queue.length >= this.frames) this.flush();
+};
+
+//
+// ### function write (frame)
+// #### @frame {Buffer} Opus packet with a single frame
+// Queues frame, emits 'data' once enough frames are collected
+//
+Aggregator.prototype.write = function write(frame) {
+  var self = this;
+
+  this.queue.push(frame);
+  if (this.queue.length >= this.frames) return this.flush();
+
+  // Don't hold frames if the next ones aren't coming (i.e. muted)
+  if (this.timer === null) {
+    this.timer = setTimeout(function() {
+      self.timer = null;
+      self.flush();
+    }, this.duration * this.frames);
+  }
+};
+
+//
+// ### function flush ()
+// Emits queued frames
+//
+Aggregator.prototype.flush = function flush() {
+  if (this.timer !== null) {
+    clearTimeout(this.timer);
+    this.timer = null;
+  }
+  if (this.queue.length === 0) return;
+
+  var queue = this.queue,
+      packet = queue.length === 1 ? queue[0] : binding.opusMerge(queue);
+  this.queue = [];
+
+  // Encoder has switched mode or bandwidth in between
+  if (packet === null) {
+    queue.forEach(function(frame) {
+      this.emit('data', frame, 1);
+    }, this);
+    return;
+  }
+
+  this.emit('data', packet, queue.length);
+};
+
+//
+// ### function reset ()
+// Drops queued frames
+//
+Aggregator.prototype.reset = function reset() {
+  if (this.timer !== null) clearTimeout(this.timer);
+  this.timer = null;
+  this.queue = [];
+};
@@ -0,0 +1,334 @@
+var crypto = require('crypto'),
+    Buffer = require('buffer').Buffer;
+
+var rtp = exports;
+
+rtp.VERSION = 2;
+rtp.HEADER_SIZE = 12;
+rtp.PAYLOAD_TYPE = 111;
+
+// Opus always uses 48kHz media clock (RFC 7587)
+rtp.CLOCK_RATE = 48000;
+
+rtp.types = {
+  sr: 200,
+  rr: 201
+};
+
+// Seconds between NTP (1900) and unix (1970) epochs
+var NTP_OFFSET = 2208988800;
+
+//
+// ### function isPacket (raw)
+// #### @raw {Buffer} Incoming datagram
+// Returns true if raw is an RTP voice packet
+// (0x80 is an empty msgpack map, which is never sent)
+//
+rtp.isPacket = function isPacket(raw) {
+  return raw.length >= rtp.HEADER_SIZE &&
+         raw[0] === rtp.VERSION << 6 &&
+         (raw[1] & 0x7f) === rtp.PAYLOAD_TYPE;
+};
+
+//
+// ### function isControl (raw)
+// #### @raw {Buffer} Incoming datagram
+// Returns true if raw is an RTCP packet
+//
+rtp.isControl = function isControl(raw) {
+  return raw.length >= 8 &&
+         (raw[0] & 0xc0) === rtp.VERSION << 6 &&
+         raw[1] >= 200 && raw[1] <= 204;
+};
+
+//
+// ### function ntpTime (now)
+// #### @now {Number} Milliseconds since unix epoch
+// Returns [ seconds, fraction ] of NTP timestamp
+//
+function ntpTime(now) {
+  var sec = Math.floor(now / 1000);
+  return [ (sec + NTP_OFFSET) >>> 0,
+           Math.floor((now - sec * 1000) / 1000 * 0x100000000) >>> 0 ];
+}
+
+//
+// ### function middle (ntp)
+// Returns middle 32 bits of NTP timestamp (in 1/65536 sec)
+//
+function middle(ntp) {
+  return (((ntp[0] & 0xffff) << 16) | (ntp[1] >>> 16)) >>> 0;
+}
+
+//
+// ### function Session (sealer)
+// #### @sealer {frame.Sealer} Peer's sealer
+// One RTP stream in each direction: sends our voice with its own SSRC,
+// receives remote side's one and keeps RTCP statistics on both.
+// Payload is sealed with peer's keys, RTP header is authenticated.
+//
+function Session(sealer) {
+  this.sealer = sealer;
+
+  // Sender
+  this.ssrc = crypto.randomBytes(4).readUInt32BE(0);
+  this.seq = crypto.randomBytes(2).readUInt16BE(0);
+  this.roc = 0;
+  this.ts = crypto.randomBytes(4).readUInt32BE(0);
+  this.nextTs = this.ts;
+  this.lastSent = 0;
+  this.packets = 0;
+  this.octets = 0;
+
+  // Receiver
+  this.remoteSsrc = null;
+  this.baseSeq = 0;
+  this.maxSeq = 0;
+  this.received = 0;
+  this.expectedPrior = 0;
+  this.receivedPrior = 0;
+  this.jitter = 0;
+  this.lastTransit = null;
+  this.lastTs = 0;
+  this.lastSr = 0;
+  this.lastSrTime = 0;
+};
+rtp.Session = Session;
+
+//
+// ### function createSession (sealer)
+// Constructor wrapper
+//
+rtp.createSession = function createSession(sealer) {
+  return new Session(sealer);
+};
+
+//
+// ### function seal (payload, samples)
+// #### @payload {Buffer} Opus packet
+// #### @samples {Number} Packet duration in media clock units
+// Returns sealed RTP packet
+//
+Session.prototype.seal = function seal(payload, samples) {
+  var now = Date.now(),
+      marker = false;
+
+  // First packet of a talkspurt (i.e. after mute),
+  // timestamp reflects the time that has passed
+  if (this.packets !== 0 &&
+      now - this.lastSent > 2 * samples * 1000 / rtp.CLOCK_RATE) {
+    marker = true;
+    this.nextTs = this.ts +
+                  Math.round((now - this.lastSent) * rtp.CLOCK_RATE / 1000);
+  }
+
+  this.ts = this.nextTs >>> 0;
+  this.nextTs = this.ts + samples;
+
+  var raw = this.sealer.sealRtp(marker,
+                                this.seq,
+                                this.ts,
+                                this.ssrc,
+                                this.roc,
+                                payload);
+
+  if (++this.seq > 0xffff) {
+    this.seq = 0;
+    this.roc++;
+  }
+  this.lastSent = now;
+  this.packets++;
+  this.octets += payload.length;
+
+  return raw;
+};
+
+//
+// ### function open (raw)
+// #### @raw {Buffer} Sealed RTP packet
+// Returns { seq, ts, marker, data } with extended seq and ts
+// (they don't wrap), or null if packet is forged
+//
+Session.prototype.open = function open(raw) {
+  var seq = raw.readUInt16BE(2),
+      ext = seq;
+
+  // Pick rollover counter closest to the highest seen seq
+  if (this.remoteSsrc !== null) {
+    var roc = Math.floor(this.maxSeq / 0x10000),
+        best = null;
+
+    [ roc - 1, roc, roc + 1 ].forEach(function(roc) {
+      if (roc < 0) return;
+
+      var candidate = roc * 0x10000 + seq;
+      if (best === null ||
+          Math.abs(candidate - this.maxSeq) < Math.abs(best - this.maxSeq)) {
+        best = candidate;
+      }
+    }, this);
+    ext = best;
+  }
+
+  var f = this.sealer.openRtp(raw, Math.floor(ext / 0x10000));
+  if (f === null) return null;
+
+  // New stream
+  if (f.ssrc !== this.remoteSsrc) {
+    this.remoteSsrc = f.ssrc;
+    this.baseSeq = ext;
+    this.maxSeq = ext;
+    this.received = 0;
+    this.expectedPrior = 0;
+    this.receivedPrior = 0;
+    this.jitter = 0;
+    this.lastTransit = null;
+    this.lastTs = f.ts;
+  }
+
+  this.received++;
+  if (ext > this.maxSeq) this.maxSeq = ext;
+
+  // Random initial ts wraps within ~24.8h, unwrap it against the last one
+  // (signed 32bit difference, packets may be reordered)
+  var ts = this.lastTs + ((f.ts - this.lastTs) | 0);
+  this.lastTs = ts;
+
+  // Interarrival jitter in media clock units
+  var transit = Date.now() * rtp.CLOCK_RATE / 1000 - ts;
+  if (this.lastTransit !== null) {
+    this.jitter += (Math.abs(transit - this.lastTransit) - this.jitter) / 16;
+  }
+  this.lastTransit = transit;
+
+  return {
+    seq: ext,
+    ts: ts,
+    marker: f.marker,
+    data: f.data
+  };
+};
+
+//
+// ### function report ()
+// Returns RTCP sender report (or receiver report if we haven't sent
+// anything yet) with a report block on remote side's stream
+//
+Session.prototype.report = function report() {
+  var now = Date.now(),
+      sender = this.packets !== 0,
+      blocks = this.remoteSsrc === null ? 0 : 1,
+      size = 8 + (sender ? 20 : 0) + blocks * 24,
+      raw = new Buffer(size),
+      offset = 8;
+
+  raw[0] = (rtp.VERSION << 6) | blocks;
+  raw[1] = sender ? rtp.types.sr : rtp.types.rr;
+  raw.writeUInt16BE(size / 4 - 1, 2);
+  raw.writeUInt32BE(this.ssrc, 4);
+
+  if (sender) {
+    var ntp = ntpTime(now),
+        elapsed = now - this.lastSent,
+        ts = this.ts + Math.round(elapsed * rtp.CLOCK_RATE / 1000);
+
+    raw.writeUInt32BE(ntp[0], 8);
+    raw.writeUInt32BE(ntp[1], 12);
+    raw.writeUInt32BE(ts >>> 0, 16);
+    raw.writeUInt32BE(this.packets >>> 0, 20);
+    raw.writeUInt32BE(this.octets >>> 0, 24);
+    offset = 28;
+  }
+
+  if (blocks !== 0) {
+    var expected = this.maxSeq - this.baseSeq + 1,
+        lost = Math.max(-0x800000,
+                        Math.min(0x7fffff, expected - this.received)),
+        expectedInterval = expected - this.expectedPrior,
+        lostInterval = expectedInterval - (this.received - this.receivedPrior),
+        fraction = 0;
+
+    this.expectedPrior = expected;
+    this.receivedPrior = this.received;
+    if (expectedInterval !== 0 && lostInterval > 0) {
+      fraction = Math.min(255,
+                          Math.floor(lostInterval * 256 / expectedInterval));
+    }
+
+    raw.writeUInt32BE(this.remoteSsrc, offset);
+    raw.writeUInt32BE(((fraction << 24) | (lost & 0xffffff)) >>> 0, offset + 4);
+    raw.writeUInt32BE(this.maxSeq >>> 0, offset + 8);
+    raw.writeUInt32BE(Math.round(this.jitter) >>> 0, offset + 12);
+    raw.writeUInt32BE(this.lastSr, offset + 16);
+    raw.writeUInt32BE(this.lastSr === 0 ?
+                          0 :
+                          Math.round((now - this.lastSrTime) * 65.536) >>> 0,
+                      offset + 20);
+  }
+
+  return raw;
+};
+
+//
+// ### function receiveControl (raw)
+// #### @raw {Buffer} (Compound) RTCP packet
+// Accounts remote side's reports.
+// Returns { loss, lost, jitter, rtt } on our stream (loss is a fraction,
+// jitter and rtt are in msec, rtt is null if unknown) or null
+//
+Session.prototype.receiveControl = function receiveControl(raw) {
+  var now = Date.now(),
+      res = null;
+
+  for (var offset = 0; offset + 8 <= raw.length;) {
+    if ((raw[offset] & 0xc0) !== rtp.VERSION << 6) break;
+
+    var count = raw[offset] & 0x1f,
+        type = raw[offset + 1],
+        size = (raw.readUInt16BE(offset + 2) + 1) * 4,
+        blocks = offset + 8;
+
+    if (offset + size > raw.length) break;
+
+    if (type === rtp.types.sr) {
+      if (size < 28) break;
+      if (raw.readUInt32BE(offset + 4) === this.remoteSsrc) {
+        this.lastSr = middle([ raw.readUInt32BE(offset + 8),
+                               raw.readUInt32BE(offset + 12) ]);
+        this.lastSrTime = now;
+      }
+      blocks = offset + 28;
+    } else if (type !== rtp.types.rr) {
+      offset += size;
+      continue;
+    }
+
+    for (var i = 0; i < count && blocks + 24 <= offset + size; i++) {
+      if (raw.readUInt32BE(blocks) === this.ssrc) {
+        var lsr = raw.readUInt32BE(blocks + 16),
+            dlsr = raw.readUInt32BE(blocks + 20),
+            lost = raw.readUInt32BE(blocks + 4) & 0xffffff,
+            rtt = null;
+
+        if (lsr !== 0) {
+          rtt = ((middle(ntpTime(now)) - lsr - dlsr) >>> 0) / 65.536;
+
+          // Clocks went backwards or report is forged
+          if (rtt > 60000) rtt = null;
+        }
+
+        res = {
+          loss: raw[blocks + 4] / 256,
+          lost: lost & 0x800000 ? lost - 0x1000000 : lost,
+          jitter: raw.readUInt32BE(blocks + 12) * 1000 / rtp.CLOCK_RATE,
+          rtt: rtt
+        };
+      }
+      blocks += 24;
+    }
+
+    offset += size;
+  }
+
+  return res;
+};
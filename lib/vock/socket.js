@@ -1,10 +1,11 @@
-var util = require('util'),
-    dgram = require('dgram'),
+var vock = require('../vock'),
+    util = require('util'),
     net = require('net'),
     msgpack = require('msgpack-js'),
     pmp = require('nat-pmp'),
     natUpnp = require('nat-upnp'),
     netroute = require('netroute'),
+    Buffer = require('buffer').Buffer,
     EventEmitter = require('events').EventEmitter;
 
 var socket = exports;
@@ -80,7 +81,8 @@ Socket.prototype.bind = function bind(ports, callback) {
       }
     }
 
-    self.socket = dgram.createSocket('udp4');
+    // Native socket, batching sends and receives
+    self.socket = vock.udp.createSocket();
     self.socket.on('message', self.ondata.bind(self));
     self.socket.once('listening', function() {
       callback(self.port, port !== 0);
@@ -173,11 +175,16 @@ Socket.prototype.send = function(packet, target) {
     return;
   }
 
-  try {
-    var raw = msgpack.encode(packet);
-  } catch (e) {
-    this.emit('error', e);
-    return;
+  // Binary frames are sent as is
+  if (Buffer.isBuffer(packet)) {
+    var raw = packet;
+  } else {
+    try {
+      var raw = msgpack.encode(packet);
+    } catch (e) {
+      this.emit('error', e);
+      return;
+    }
   }
 
   this.socket.send(raw, 0, raw.length, target.port, target.address);
@@ -210,6 +217,19 @@ Socket.prototype.relay = function relay(packet, id, target) {
 // Receives incoming relay or direct packet
 //
 Socket.prototype.ondata = function ondata(raw, addr) {
+  // Voice forwarded by SFU relay
+  if (vock.relay.isPacket(raw)) {
+    return this.emit('relay', raw, addr);
+  }
+
+  // Binary frames and RTP/RTCP packets are decoded by peer
+  if (vock.frame.isFrame(raw) ||
+      vock.rtp.isPacket(raw) ||
+      vock.rtp.isControl(raw)) {
+    addr.relay = false;
+    return this.emit('data', raw, addr);
+  }
+
   try {
     var msg = msgpack.decode(raw);
   } catch (e) {
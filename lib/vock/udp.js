@@ -0,0 +1,163 @@
+var binding = require('bindings')('vock.node'),
+    util = require('util'),
+    net = require('net'),
+    dns = require('dns'),
+    EventEmitter = require('events').EventEmitter;
+
+var udp = exports;
+
+//
+// ### function UdpSocket ()
+// Native udp4 socket with dgram-compatible interface.
+// All datagrams sent in one tick are flushed with a single
+// sendmmsg() syscall, incoming datagrams are read with recvmmsg().
+//
+function UdpSocket() {
+  EventEmitter.call(this);
+
+  this.handle = new binding.Udp();
+  this.handle.onmessages = this.onmessages.bind(this);
+  this.port = null;
+
+  // Send queue
+  this.buffers = [];
+  this.ports = [];
+  this.addresses = [];
+  this.callbacks = [];
+  this.flushScheduled = false;
+};
+util.inherits(UdpSocket, EventEmitter);
+
+//
+// ### function createSocket ()
+// Constructor wrapper
+//
+udp.createSocket = function createSocket() {
+  return new UdpSocket();
+};
+
+//
+// ### function bind (port)
+// #### @port {Number} Port to bind to (0 - random)
+// Binds socket, throws on failure
+//
+UdpSocket.prototype.bind = function bind(port) {
+  var self = this;
+
+  this.port = this.handle.bind(port || 0);
+  process.nextTick(function() {
+    self.emit('listening');
+  });
+};
+
+//
+// ### function address ()
+// Returns bound address
+//
+UdpSocket.prototype.address = function address() {
+  return { address: '0.0.0.0', family: 'IPv4', port: this.port };
+};
+
+//
+// ### function send (buffer, offset, length, port, address, callback)
+// #### @buffer {Buffer} Data
+// #### @offset {Number} Data offset
+// #### @length {Number} Data length
+// #### @port {Number} Target port
+// #### @address {String} Target address
+// #### @callback {Function} **optional** Invoked once datagram was sent
+// Queues datagram, queue is flushed on the next tick
+//
+UdpSocket.prototype.send = function send(buffer,
+                                         offset,
+                                         length,
+                                         port,
+                                         address,
+                                         callback) {
+  var self = this;
+
+  // Resolve hostnames first
+  if (!net.isIPv4(address)) {
+    dns.lookup(address, 4, function(err, ip) {
+      if (err) {
+        if (callback) return callback(err);
+        return self.emit('error', err);
+      }
+      self.send(buffer, offset, length, port, ip, callback);
+    });
+    return;
+  }
+
+  if (offset !== 0 || length !== buffer.length) {
+    buffer = buffer.slice(offset, offset + length);
+  }
+
+  this.buffers.push(buffer);
+  this.ports.push(port);
+  this.addresses.push(address);
+  this.callbacks.push(callback || null);
+
+  if (this.flushScheduled) return;
+  this.flushScheduled = true;
+  process.nextTick(function() {
+    self.flush();
+  });
+};
+
+//
+// ### function flush ()
+// Sends all queued datagrams at once
+//
+UdpSocket.prototype.flush = function flush() {
+  var callbacks = this.callbacks,
+      res = 0;
+
+  this.flushScheduled = false;
+  if (this.port === null) {
+    res = -1;
+  } else if (this.buffers.length !== 0) {
+    res = this.handle.send(this.buffers, this.ports, this.addresses);
+  }
+
+  this.buffers = [];
+  this.ports = [];
+  this.addresses = [];
+  this.callbacks = [];
+
+  // Datagrams that didn't fit into socket's buffer are dropped silently,
+  // as with dgram
+  var err = res < 0 ? new Error('UDP send failed: ' + res) : null;
+  callbacks.forEach(function(callback) {
+    if (callback) callback(err);
+  });
+};
+
+//
+// ### function close ()
+// Closes socket
+//
+UdpSocket.prototype.close = function close() {
+  this.handle.close();
+  this.port = null;
+  this.emit('close');
+};
+
+//
+// ### function onmessages (buffers, addresses, ports)
+// #### @buffers {Array} Received datagrams
+// #### @addresses {Array} Sender addresses
+// #### @ports {Array} Sender ports
+// Invoked by binding once per received batch
+//
+UdpSocket.prototype.onmessages = function onmessages(buffers,
+                                                     addresses,
+                                                     ports) {
+  for (var i = 0; i < buffers.length; i++) {
+    this.emit('message', buffers[i], {
+      address: addresses[i],
+      family: 'IPv4',
+      port: ports[i],
+      size: buffers[i].length
+    });
+  }
+};
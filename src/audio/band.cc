@@ -0,0 +1,108 @@
+#include "band.h"
+#include "dot.h"
+
+#include <math.h> // sin, cos
+#include <string.h> // memcpy, memmove
+
+namespace vock {
+namespace audio {
+
+static const double kPi = 3.14159265358979323846;
+
+const float BandSplit::kCutoff = 0.8f;
+
+BandSplit::BandSplit(int factor, size_t max_samples)
+    : factor_(factor),
+      count_(0),
+      gain_(1.0f) {
+  tap_count_ = kTapsPerFactor * factor + 1;
+  phase_count_ = (tap_count_ + factor - 1) / factor;
+
+  // Blackman windowed sinc with unity gain at DC
+  double fc = kCutoff * 0.5 / factor;
+  double center = (tap_count_ - 1) / 2.0;
+  double sum = 0;
+  taps_ = new float[tap_count_];
+  for (size_t i = 0; i < tap_count_; i++) {
+    double t = i - center;
+    double sinc = t == 0 ? 2 * fc : sin(2 * kPi * fc * t) / (kPi * t);
+    double w = 0.42 -
+               0.5 * cos(2 * kPi * i / (tap_count_ - 1)) +
+               0.08 * cos(4 * kPi * i / (tap_count_ - 1));
+    taps_[i] = sinc * w;
+    sum += taps_[i];
+  }
+  for (size_t i = 0; i < tap_count_; i++) taps_[i] /= sum;
+
+  // Interpolation of zero-stuffed signal: phase `p` of output uses taps
+  // p, p + factor, p + 2 * factor, ..., scaled by factor to keep the gain
+  phases_ = new float[factor * phase_count_];
+  for (int p = 0; p < factor; p++) {
+    for (size_t t = 0; t < phase_count_; t++) {
+      size_t k = (phase_count_ - 1 - t) * factor + p;
+      phases_[p * phase_count_ + t] = k < tap_count_ ? taps_[k] * factor : 0;
+    }
+  }
+
+  in_ = new float[tap_count_ - 1 + max_samples];
+  memset(in_, 0, (tap_count_ - 1) * sizeof(*in_));
+  low_ = new float[max_samples / factor];
+  interp_ = new float[phase_count_ - 1 + max_samples / factor];
+  memset(interp_, 0, (phase_count_ - 1) * sizeof(*interp_));
+}
+
+
+BandSplit::~BandSplit() {
+  delete[] taps_;
+  delete[] phases_;
+  delete[] in_;
+  delete[] low_;
+  delete[] interp_;
+}
+
+
+const float* BandSplit::Split(const float* in, size_t count) {
+  // Keep the tail of the previous frame as filter's history
+  memmove(in_, in_ + count_, (tap_count_ - 1) * sizeof(*in_));
+  memcpy(in_ + tap_count_ - 1, in, count * sizeof(*in));
+  count_ = count;
+
+  // Taps are symmetric, no need to reverse them
+  for (size_t i = 0; i < count / factor_; i++) {
+    low_[i] = InnerProd(taps_, in_ + i * factor_, tap_count_);
+  }
+
+  return low_;
+}
+
+
+void BandSplit::Merge(const float* low, float gain, float* out) {
+  size_t low_count = count_ / factor_;
+  float step = (gain - gain_) / count_;
+
+  // out = gain * delayed in + interpolated (low - gain * original low),
+  // so the high band (delayed in - interpolated original low) gets `gain`
+  float* next = interp_ + phase_count_ - 1;
+  for (size_t i = 0; i < low_count; i++) {
+    next[i] = low[i] - (gain_ + step * (i * factor_ + 1)) * low_[i];
+  }
+
+  for (size_t i = 0; i < low_count; i++) {
+    for (int p = 0; p < factor_; p++) {
+      size_t j = i * factor_ + p;
+      float high_gain = gain_ + step * (j + 1);
+      out[j] = InnerProd(phases_ + p * phase_count_,
+                         interp_ + i,
+                         phase_count_) +
+               high_gain * in_[j];
+    }
+  }
+  gain_ = gain;
+
+  memmove(interp_,
+          interp_ + low_count,
+          (phase_count_ - 1) * sizeof(*interp_));
+}
+
+} // namespace audio
+} // namespace vock
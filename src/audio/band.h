@@ -0,0 +1,62 @@
+#ifndef _SRC_AUDIO_BAND_H_
+#define _SRC_AUDIO_BAND_H_
+
+#include <stddef.h> // size_t
+
+namespace vock {
+namespace audio {
+
+// Two-band split of a full rate signal for the echo canceller: the low
+// band is lowpass filtered (linear-phase FIR) and decimated by `factor`,
+// the high band is the delayed input minus interpolated low band.
+// Merge() puts processed low band back and scales high band, with the
+// unchanged low band and unity gain input is reconstructed exactly
+// (delayed by `delay()` samples), whatever the filter's quality is.
+class BandSplit {
+ public:
+  // Taps per decimated sample
+  static const int kTapsPerFactor = 24;
+
+  // Cutoff relative to the low band's Nyquist frequency
+  static const float kCutoff;
+
+  // Frames of up to `max_samples` full rate samples
+  BandSplit(int factor, size_t max_samples);
+  ~BandSplit();
+
+  // Returns `count / factor` samples of the low band,
+  // `count` should be a multiple of `factor`
+  const float* Split(const float* in, size_t count);
+
+  // Writes the last split frame to `out` with its low band replaced by
+  // `low` and high band scaled by gain (ramping from the previous one)
+  void Merge(const float* low, float gain, float* out);
+
+  inline size_t delay() { return tap_count_ - 1; }
+
+ protected:
+  int factor_;
+  size_t tap_count_;
+  size_t phase_count_;
+  size_t count_;
+  float gain_;
+
+  float* taps_;
+
+  // Polyphase interpolation filters, `phase_count_` reversed taps each
+  float* phases_;
+
+  // Full rate input, `tap_count_ - 1` samples of history first
+  float* in_;
+
+  // Decimated low band
+  float* low_;
+
+  // Low band to interpolate, `phase_count_ - 1` samples of history first
+  float* interp_;
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_BAND_H_
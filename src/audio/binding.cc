@@ -33,11 +33,26 @@ using v8::ThrowException;
 
 static Persistent<String> ondata_sym;
 
-Audio::Audio(double rate, size_t frame_size, ssize_t latency)
-    : frame_size_(frame_size),
+#define THROW_OPUS_ERROR(err)\
+    ThrowException(String::Concat(String::New("Opus error: "),\
+                                  String::New(opus_strerror(err))))
+
+Audio::Audio(double rate,
+             size_t frame_size,
+             size_t cancel_size,
+             ssize_t latency,
+             SampleFormat format,
+             double cancel_rate)
+    : format_(format),
+      frame_size_(frame_size),
+      rate_(rate),
       input_ready_(false),
       output_ready_(false),
       active_(false) {
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) decoders_[i] = NULL;
+  max_decode_samples_ = static_cast<int>(rate * 0.12);
+  decode_scratch_ = new char[max_decode_samples_ * SampleSize(format)];
+
   uv_async_t** handles[3] = { &in_async_, &inready_async_, &outready_async_ };
   for (int i = 0; i < 3; i++) {
     uv_async_t* handle = new uv_async_t();
@@ -61,11 +76,17 @@ Audio::Audio(double rate, size_t frame_size, ssize_t latency)
 
   // Init Hardware abstraction layer's unit
   unit_ = new HALUnit(rate,
-                      frame_size,
+                      cancel_size,
                       latency,
+                      format,
+                      cancel_rate,
                       in_async_,
                       inready_async_,
                       outready_async_);
+
+  // Channels fed with playoutPush() are pulled by the output thread
+  playout_ = new Playout(unit_, rate, format);
+  unit_->SetPullSource(Playout::PullCallback, playout_);
 }
 
 
@@ -79,6 +100,9 @@ Audio::~Audio() {
   uv_close(reinterpret_cast<uv_handle_t*>(inready_async_), OnAsyncClose);
   uv_close(reinterpret_cast<uv_handle_t*>(outready_async_), OnAsyncClose);
   delete unit_;
+  delete playout_;
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) delete decoders_[i];
+  delete[] decode_scratch_;
 }
 
 
@@ -93,10 +117,61 @@ Handle<Value> Audio::New(const Arguments& args) {
         "First three arguments should be numbers")));
   }
 
-  // Second argument is in msec
-  Audio* a = new Audio(args[0]->NumberValue(),
-                       args[1]->Int32Value(),
-                       args[2]->Int32Value());
+  // Optional fourth argument is the sample format
+  SampleFormat format = kInt16Format;
+  if (args.Length() >= 4 && args[3]->IsString()) {
+    String::AsciiValue name(args[3]);
+    if (strcmp(*name, "float") == 0) {
+      format = kFloat32Format;
+    } else if (strcmp(*name, "int16") != 0) {
+      return scope.Close(ThrowException(String::New(
+          "Unknown sample format!")));
+    }
+  }
+
+  // Optional fifth argument is echo canceller's frame,
+  // the same as codec's frame by default
+  size_t frame_size = args[1]->Int32Value();
+  size_t cancel_size = frame_size;
+  if (args.Length() >= 5 && args[4]->IsNumber()) {
+    cancel_size = args[4]->Int32Value();
+  }
+
+  if (frame_size == 0 || cancel_size == 0 ||
+      frame_size % SampleSize(format) != 0 ||
+      cancel_size % SampleSize(format) != 0) {
+    return scope.Close(ThrowException(String::New(
+        "Frame sizes should be multiples of sample size!")));
+  }
+
+  // Optional sixth argument is echo canceller's rate, it runs on the
+  // low band decimated by integer factor if it's below the sample rate
+  double rate = args[0]->NumberValue();
+  double cancel_rate = rate;
+  if (args.Length() >= 6 && args[5]->IsNumber()) {
+    cancel_rate = args[5]->NumberValue();
+  }
+
+  if (cancel_rate <= 0 || cancel_rate > rate) {
+    return scope.Close(ThrowException(String::New(
+        "Echo canceller's rate should be within (0, rate]!")));
+  }
+  if (cancel_rate < rate) {
+    int factor = static_cast<int>(rate / cancel_rate);
+    if (factor * cancel_rate != rate ||
+        (cancel_size / SampleSize(format)) % factor != 0) {
+      return scope.Close(ThrowException(String::New(
+          "Echo canceller's rate should divide rate and its frame!")));
+    }
+  }
+
+  // Second, third and fifth arguments are in bytes
+  Audio* a = new Audio(rate,
+                       frame_size,
+                       cancel_size,
+                       args[2]->Int32Value(),
+                       format,
+                       cancel_rate);
   a->Wrap(args.Holder());
 
   return scope.Close(args.This());
@@ -161,27 +236,325 @@ Handle<Value> Audio::Enqueue(const Arguments& args) {
 }
 
 
+int Audio::DecodeInto(int channel,
+                      const unsigned char* data,
+                      opus_int32 len,
+                      bool fec) {
+  opus::Codec* codec = decoders_[channel];
+  if (codec == NULL) {
+    codec = new opus::Codec(rate_, 1);
+    int err = codec->InitDecoder();
+    if (err != OPUS_OK) {
+      delete codec;
+      return err;
+    }
+    decoders_[channel] = codec;
+  }
+
+  // Concealed and recovered frames should be exactly one frame long,
+  // packets may carry up to 120 ms
+  int max_samples = (data == NULL || fec) ?
+      frame_size_ / SampleSize(format_) :
+      max_decode_samples_;
+
+  // Decode in place if ring has enough contiguous space,
+  // otherwise (ring wraps or is full) go through the scratch buffer
+  char* region = unit_->PutRegion(channel, max_samples);
+  char* out = region == NULL ? decode_scratch_ : region;
+
+  int samples;
+  if (format_ == kFloat32Format) {
+    samples = codec->DecodeFloat(data,
+                                 len,
+                                 reinterpret_cast<float*>(out),
+                                 max_samples,
+                                 fec);
+  } else {
+    samples = codec->Decode(data,
+                            len,
+                            reinterpret_cast<opus_int16*>(out),
+                            max_samples,
+                            fec);
+  }
+  if (samples <= 0) return samples;
+
+  if (region == NULL) {
+    unit_->Put(channel, out, samples * SampleSize(format_));
+  } else {
+    unit_->CommitPut(channel, samples);
+  }
+
+  return samples;
+}
+
+
+Handle<Value> Audio::DecodeAndEnqueue(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 2 || !args[0]->IsNumber() ||
+      (!args[1]->IsNull() && !Buffer::HasInstance(args[1]))) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number, second - Buffer or null!")));
+  }
+
+  int channel = args[0]->Int32Value();
+  if (channel < 0 || channel >= HALUnit::kOutRingCount) {
+    return scope.Close(ThrowException(String::New(
+        "Incorrect channel index!")));
+  }
+
+  const unsigned char* data = NULL;
+  opus_int32 len = 0;
+  if (!args[1]->IsNull()) {
+    data = reinterpret_cast<const unsigned char*>(
+        Buffer::Data(args[1].As<Object>()));
+    len = Buffer::Length(args[1].As<Object>());
+  }
+  bool fec = args.Length() >= 3 && args[2]->BooleanValue();
+
+  int samples = a->DecodeInto(channel, data, len, fec);
+  if (samples < 0) return scope.Close(THROW_OPUS_ERROR(samples));
+
+  return scope.Close(Number::New(samples));
+}
+
+
+Handle<Value> Audio::DecodeAndEnqueueBatch(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 2 || !args[0]->IsArray() || !args[1]->IsArray() ||
+      (args.Length() >= 3 && !args[2]->IsUndefined() &&
+       !args[2]->IsArray())) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be arrays of channels, packets and fec flags!")));
+  }
+
+  Local<Array> channels = args[0].As<Array>();
+  Local<Array> packets = args[1].As<Array>();
+  Local<Array> fecs;
+  if (args.Length() >= 3 && args[2]->IsArray()) fecs = args[2].As<Array>();
+
+  if (channels->Length() != packets->Length()) {
+    return scope.Close(ThrowException(String::New(
+        "Channels and packets should have the same length!")));
+  }
+
+  // Corrupted packets don't stop the rest of the batch,
+  // number of failed ones is returned instead
+  uint32_t failed = 0;
+  for (uint32_t i = 0; i < packets->Length(); i++) {
+    Local<Value> channel_value = channels->Get(i);
+    Local<Value> packet = packets->Get(i);
+    int channel = channel_value->Int32Value();
+
+    if (!channel_value->IsNumber() ||
+        channel < 0 ||
+        channel >= HALUnit::kOutRingCount ||
+        (!packet->IsNull() && !Buffer::HasInstance(packet))) {
+      failed++;
+      continue;
+    }
+
+    const unsigned char* data = NULL;
+    opus_int32 len = 0;
+    if (!packet->IsNull()) {
+      data = reinterpret_cast<const unsigned char*>(
+          Buffer::Data(packet.As<Object>()));
+      len = Buffer::Length(packet.As<Object>());
+    }
+    bool fec = !fecs.IsEmpty() && fecs->Get(i)->BooleanValue();
+
+    if (a->DecodeInto(channel, data, len, fec) < 0) failed++;
+  }
+
+  return scope.Close(Number::New(failed));
+}
+
+
+Handle<Value> Audio::PlayoutPush(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 3 || !args[0]->IsNumber() || !args[1]->IsNumber() ||
+      !Buffer::HasInstance(args[2])) {
+    return scope.Close(ThrowException(String::New(
+        "First two arguments should be numbers, third - Buffer!")));
+  }
+
+  int channel = args[0]->Int32Value();
+  if (channel < 0 || channel >= HALUnit::kOutRingCount) {
+    return scope.Close(ThrowException(String::New(
+        "Incorrect channel index!")));
+  }
+
+  if (!a->playout_->Push(channel,
+                         args[1]->Uint32Value(),
+                         Buffer::Data(args[2].As<Object>()),
+                         Buffer::Length(args[2].As<Object>()))) {
+    return scope.Close(ThrowException(String::New(
+        "Failed to queue packet for playout!")));
+  }
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Audio::ResetChannel(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number!")));
+  }
+
+  int channel = args[0]->Int32Value();
+  if (channel < 0 || channel >= HALUnit::kOutRingCount) {
+    return scope.Close(ThrowException(String::New(
+        "Incorrect channel index!")));
+  }
+
+  if (a->decoders_[channel] != NULL) a->decoders_[channel]->ResetDecoder();
+  if (!a->unit_->ResetChannel(channel) || !a->playout_->Reset(channel)) {
+    return scope.Close(ThrowException(String::New(
+        "Audio control queue is full!")));
+  }
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Audio::SetGain(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "First two arguments should be numbers!")));
+  }
+
+  int channel = args[0]->Int32Value();
+  double gain = args[1]->NumberValue();
+  if (channel < 0 || channel >= HALUnit::kOutRingCount) {
+    return scope.Close(ThrowException(String::New(
+        "Incorrect channel index!")));
+  }
+  if (!(gain >= 0)) {
+    return scope.Close(ThrowException(String::New(
+        "Gain should be a non-negative number!")));
+  }
+
+  if (!a->unit_->SetGain(channel, gain)) {
+    return scope.Close(ThrowException(String::New(
+        "Audio control queue is full!")));
+  }
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Audio::SetMute(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsBoolean()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number, second - boolean!")));
+  }
+
+  int channel = args[0]->Int32Value();
+  if (channel < 0 || channel >= HALUnit::kOutRingCount) {
+    return scope.Close(ThrowException(String::New(
+        "Incorrect channel index!")));
+  }
+
+  if (!a->unit_->SetMute(channel, args[1]->BooleanValue())) {
+    return scope.Close(ThrowException(String::New(
+        "Audio control queue is full!")));
+  }
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Audio::SetCaptureMute(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  a->unit_->SetCaptureMute(args[0]->BooleanValue());
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Audio::SetPreprocess(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be an object!")));
+  }
+
+  static const struct {
+    const char* name;
+    int feature;
+  } names[] = {
+    { "denoise", HALUnit::kDenoise },
+    { "agc", HALUnit::kAgc },
+    { "vad", HALUnit::kVad },
+    { "dereverb", HALUnit::kDereverb },
+    { "echoSuppress", HALUnit::kEchoSuppress }
+  };
+
+  Local<Object> options = args[0].As<Object>();
+  int features = 0;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (options->Get(String::NewSymbol(names[i].name))->BooleanValue()) {
+      features |= names[i].feature;
+    }
+  }
+  a->unit_->SetPreprocess(features);
+
+  return scope.Close(Null());
+}
+
+
 Handle<Value> Audio::GetRms(const Arguments& args) {
   HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
 
   if (args.Length() < 1 || !Buffer::HasInstance(args[0])) {
     return scope.Close(ThrowException(String::New(
         "First two arguments should be Buffers!")));
   }
 
-  int16_t* data = reinterpret_cast<int16_t*>(
-      Buffer::Data(args[0].As<Object>()));
-  size_t len = Buffer::Length(args[0].As<Object>()) / sizeof(int16_t);
+  char* data = Buffer::Data(args[0].As<Object>());
+  size_t size = Buffer::Length(args[0].As<Object>());
+  size_t sample_size = SampleSize(a->format_);
+  size_t len = size / sample_size;
 
-  if (len == 0 || (len & sizeof(int16_t)) != 0) {
+  if (len == 0 || (size % sample_size) != 0) {
     return scope.Close(ThrowException(String::New(
         "Buffer has incorrect size!")));
   }
 
   double rms = 0;
-  for (size_t i = 0; i < len; i++) {
-    double sample = static_cast<double>(data[i]);
-    rms += sample * sample;
+  if (a->format_ == kFloat32Format) {
+    float* samples = reinterpret_cast<float*>(data);
+    for (size_t i = 0; i < len; i++) {
+      // Report in the same scale as 16bit samples
+      double sample = static_cast<double>(samples[i]) * 32768.0;
+      rms += sample * sample;
+    }
+  } else {
+    int16_t* samples = reinterpret_cast<int16_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+      double sample = static_cast<double>(samples[i]);
+      rms += sample * sample;
+    }
   }
   rms /= len;
   rms = sqrt(rms);
@@ -192,6 +565,7 @@ Handle<Value> Audio::GetRms(const Arguments& args) {
 
 Handle<Value> Audio::ApplyGain(const Arguments& args) {
   HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
 
   if (args.Length() < 2 || !Buffer::HasInstance(args[0]) ||
       !args[1]->IsNumber()) {
@@ -199,32 +573,125 @@ Handle<Value> Audio::ApplyGain(const Arguments& args) {
         "First two arguments should be Buffers!")));
   }
 
-  int16_t* in = reinterpret_cast<int16_t*>(
-      Buffer::Data(args[0].As<Object>()));
-  size_t len = Buffer::Length(args[0].As<Object>()) / sizeof(int16_t);
+  char* data = Buffer::Data(args[0].As<Object>());
+  size_t size = Buffer::Length(args[0].As<Object>());
+  size_t sample_size = SampleSize(a->format_);
+  size_t len = size / sample_size;
 
-  if (len == 0 || (len & sizeof(int16_t)) != 0) {
+  if (len == 0 || (size % sample_size) != 0) {
     return scope.Close(ThrowException(String::New(
         "Buffer has incorrect size!")));
   }
   double gain = args[1]->NumberValue();
 
-  for (size_t i = 0; i < len; i++) {
-    in[i] = in[i] * gain;
+  if (a->format_ == kFloat32Format) {
+    float* in = reinterpret_cast<float*>(data);
+    for (size_t i = 0; i < len; i++) {
+      in[i] = in[i] * gain;
+    }
+  } else {
+    int16_t* in = reinterpret_cast<int16_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+      in[i] = in[i] * gain;
+    }
   }
 
   return scope.Close(Null());
 }
 
 
+static Handle<Object> HistogramToObject(Histogram* h) {
+  HandleScope scope;
+  Local<Object> result = Object::New();
+
+  // Bucket `i` holds values in [2^i, 2^(i+1))
+  Local<Array> buckets = Array::New(Histogram::kBucketCount);
+  for (int i = 0; i < Histogram::kBucketCount; i++) {
+    buckets->Set(i, Number::New(h->bucket(i)));
+  }
+
+  result->Set(String::NewSymbol("count"), Number::New(h->count()));
+  result->Set(String::NewSymbol("sum"), Number::New(h->sum()));
+  result->Set(String::NewSymbol("max"), Number::New(h->max()));
+  result->Set(String::NewSymbol("buckets"), buckets);
+
+  return scope.Close(result);
+}
+
+
+Handle<Value> Audio::GetStats(const Arguments& args) {
+  HandleScope scope;
+  Audio* a = ObjectWrap::Unwrap<Audio>(args.This());
+  HALUnit::Stats* stats = a->unit_->stats();
+  Local<Object> result = Object::New();
+
+  result->Set(String::NewSymbol("captureOverruns"),
+              Number::New(stats->capture_overruns.Get()));
+  result->Set(String::NewSymbol("inputOverruns"),
+              Number::New(stats->input_overruns.Get()));
+  result->Set(String::NewSymbol("usedOverruns"),
+              Number::New(stats->used_overruns.Get()));
+  result->Set(String::NewSymbol("captureHoles"),
+              Number::New(stats->capture_holes.Get()));
+  result->Set(String::NewSymbol("echoRealigns"),
+              Number::New(stats->echo_realigns.Get()));
+  result->Set(String::NewSymbol("cancelBypassed"),
+              Number::New(stats->cancel_bypassed.Get()));
+  result->Set(String::NewSymbol("preprocessBypassed"),
+              Number::New(stats->preprocess_bypassed.Get()));
+  result->Set(String::NewSymbol("vadSilent"),
+              Number::New(stats->vad_silent.Get()));
+
+  // Per channel
+  Local<Array> out_overruns = Array::New(HALUnit::kOutRingCount);
+  Local<Array> out_underruns = Array::New(HALUnit::kOutRingCount);
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) {
+    out_overruns->Set(i, Number::New(stats->out_overruns[i].Get()));
+    out_underruns->Set(i, Number::New(stats->out_underruns[i].Get()));
+  }
+  result->Set(String::NewSymbol("outOverruns"), out_overruns);
+  result->Set(String::NewSymbol("outUnderruns"), out_underruns);
+
+  Playout::Stats* playout = a->playout_->stats();
+  result->Set(String::NewSymbol("playoutConcealed"),
+              Number::New(playout->concealed.Get()));
+  result->Set(String::NewSymbol("playoutRecovered"),
+              Number::New(playout->recovered.Get()));
+  result->Set(String::NewSymbol("playoutLate"),
+              Number::New(playout->late.Get()));
+  result->Set(String::NewSymbol("playoutDropped"),
+              Number::New(playout->dropped.Get()));
+  result->Set(String::NewSymbol("playoutCompressed"),
+              Number::New(playout->compressed.Get()));
+  result->Set(String::NewSymbol("playoutExpanded"),
+              Number::New(playout->expanded.Get()));
+
+  result->Set(String::NewSymbol("cancelTime"),
+              HistogramToObject(&stats->cancel_time));
+  result->Set(String::NewSymbol("preprocessTime"),
+              HistogramToObject(&stats->preprocess_time));
+  result->Set(String::NewSymbol("resampleTime"),
+              HistogramToObject(&stats->resample_time));
+  result->Set(String::NewSymbol("handoffTime"),
+              HistogramToObject(&stats->handoff_time));
+  result->Set(String::NewSymbol("inputCallbackSize"),
+              HistogramToObject(&stats->input_callback_size));
+  result->Set(String::NewSymbol("outputCallbackSize"),
+              HistogramToObject(&stats->output_callback_size));
+
+  return scope.Close(result);
+}
+
+
 void Audio::InputAsyncCallback(uv_async_t* async, int status) {
   HandleScope scope;
   Audio* a = reinterpret_cast<Audio*>(async->data);
 
-  Buffer* buffer;
-  for (;;) {
-    buffer = a->unit_->Read(a->frame_size_);
-    if (buffer == NULL) break;
+  a->unit_->RecordHandoff();
+
+  while (a->unit_->GetReadSize() >= a->frame_size_) {
+    Buffer* buffer = Buffer::New(a->frame_size_);
+    if (!a->unit_->Read(Buffer::Data(buffer), a->frame_size_)) break;
 
     if (a->input_ready_ && a->output_ready_) {
       Handle<Value> argv[1] = { buffer->handle_ };
@@ -263,8 +730,19 @@ void Audio::Init(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(t, "start", Audio::Start);
   NODE_SET_PROTOTYPE_METHOD(t, "stop", Audio::Stop);
   NODE_SET_PROTOTYPE_METHOD(t, "enqueue", Audio::Enqueue);
+  NODE_SET_PROTOTYPE_METHOD(t, "decodeAndEnqueue", Audio::DecodeAndEnqueue);
+  NODE_SET_PROTOTYPE_METHOD(t,
+                            "decodeAndEnqueueBatch",
+                            Audio::DecodeAndEnqueueBatch);
+  NODE_SET_PROTOTYPE_METHOD(t, "playoutPush", Audio::PlayoutPush);
+  NODE_SET_PROTOTYPE_METHOD(t, "resetChannel", Audio::ResetChannel);
+  NODE_SET_PROTOTYPE_METHOD(t, "setGain", Audio::SetGain);
+  NODE_SET_PROTOTYPE_METHOD(t, "setMute", Audio::SetMute);
+  NODE_SET_PROTOTYPE_METHOD(t, "setCaptureMute", Audio::SetCaptureMute);
+  NODE_SET_PROTOTYPE_METHOD(t, "setPreprocess", Audio::SetPreprocess);
   NODE_SET_PROTOTYPE_METHOD(t, "getRms", Audio::GetRms);
   NODE_SET_PROTOTYPE_METHOD(t, "applyGain", Audio::ApplyGain);
+  NODE_SET_PROTOTYPE_METHOD(t, "getStats", Audio::GetStats);
 
   target->Set(String::NewSymbol("Audio"), t->GetFunction());
 }
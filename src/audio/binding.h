@@ -2,6 +2,8 @@
 #define _SRC_AUDIO_BINDING_H_
 
 #include "unit.h"
+#include "playout.h"
+#include "opus/codec.h"
 
 #include "node.h"
 #include "node_object_wrap.h"
@@ -13,7 +15,12 @@ using namespace node;
 
 class Audio : public ObjectWrap {
  public:
-  Audio(double rate, size_t frame_size, ssize_t latency);
+  Audio(double rate,
+        size_t frame_size,
+        size_t cancel_size,
+        ssize_t latency,
+        SampleFormat format,
+        double cancel_rate);
   ~Audio();
 
   static void Init(v8::Handle<v8::Object> target);
@@ -22,16 +29,36 @@ class Audio : public ObjectWrap {
   static v8::Handle<v8::Value> Start(const v8::Arguments& arg);
   static v8::Handle<v8::Value> Stop(const v8::Arguments& arg);
   static v8::Handle<v8::Value> Enqueue(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> DecodeAndEnqueue(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> DecodeAndEnqueueBatch(
+      const v8::Arguments& arg);
+  static v8::Handle<v8::Value> PlayoutPush(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> ResetChannel(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> SetGain(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> SetMute(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> SetCaptureMute(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> SetPreprocess(const v8::Arguments& arg);
   static v8::Handle<v8::Value> GetRms(const v8::Arguments& arg);
   static v8::Handle<v8::Value> ApplyGain(const v8::Arguments& arg);
+  static v8::Handle<v8::Value> GetStats(const v8::Arguments& arg);
 
   static void InputAsyncCallback(uv_async_t* async, int status);
   static void InputReadyCallback(uv_async_t* async, int status);
   static void OutputReadyCallback(uv_async_t* async, int status);
 
  protected:
+  // Decodes opus packet (NULL - lost one) straight into channel's ring,
+  // returns number of samples or opus error code
+  int DecodeInto(int channel,
+                 const unsigned char* data,
+                 opus_int32 len,
+                 bool fec);
+
   HALUnit* unit_;
+  Playout* playout_;
+  SampleFormat format_;
   size_t frame_size_;
+  double rate_;
   bool input_ready_;
   bool output_ready_;
   bool active_;
@@ -39,6 +66,13 @@ class Audio : public ObjectWrap {
   uv_async_t* in_async_;
   uv_async_t* inready_async_;
   uv_async_t* outready_async_;
+
+  // Every channel has its own decoder state, created on first packet
+  opus::Codec* decoders_[HALUnit::kOutRingCount];
+
+  // 120 ms - the longest opus packet
+  int max_decode_samples_;
+  char* decode_scratch_;
 };
 
 } // namespace audio
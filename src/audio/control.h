@@ -0,0 +1,69 @@
+#ifndef _SRC_AUDIO_CONTROL_H_
+#define _SRC_AUDIO_CONTROL_H_
+
+#include "portaudio/pa_ringbuffer.h"
+
+#include <stdio.h> // fprintf
+#include <stdlib.h> // abort
+
+namespace vock {
+namespace audio {
+
+// Control operation for an audio thread
+struct Command {
+  enum Type {
+    // Platform unit
+    kStart,
+    kStop,
+
+    // Output mixer
+    kResetChannel,
+    kSetGain,
+    kSetMute
+  };
+
+  Type type;
+  int index;
+  float value;
+};
+
+// Lock-free queue of commands from the event loop (single producer)
+// to an audio thread (single consumer), which applies them between
+// device callbacks, so the realtime path never waits for a lock.
+class ControlQueue {
+ public:
+  // NOTE: Should be a power of two
+  static const int kCapacity = 256;
+
+  ControlQueue() {
+    if (PaUtil_InitializeRingBuffer(&ring_,
+                                    sizeof(Command),
+                                    kCapacity,
+                                    commands_) == -1) {
+      fprintf(stderr, "Failed to initialize control queue!\n");
+      abort();
+    }
+  }
+
+  // Returns false if consumer is lagging behind (or isn't running)
+  inline bool Push(Command::Type type, int index = 0, float value = 0) {
+    Command cmd;
+    cmd.type = type;
+    cmd.index = index;
+    cmd.value = value;
+    return PaUtil_WriteRingBuffer(&ring_, &cmd, 1) == 1;
+  }
+
+  inline bool Pop(Command* cmd) {
+    return PaUtil_ReadRingBuffer(&ring_, cmd, 1) == 1;
+  }
+
+ protected:
+  PaUtilRingBuffer ring_;
+  Command commands_[kCapacity];
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_CONTROL_H_
@@ -0,0 +1,173 @@
+#include "delay.h"
+
+#include <math.h> // sqrtf
+#include <string.h> // memset
+
+// From libspeex/fftwrap.h, which isn't a public header. Speex is always
+// built with FLOATING_POINT (see deps/speex/config.h), so words are floats.
+// Forward transform is scaled by 1/N, its output is packed as
+// [ re(0), re(1), im(1), ..., re(N/2 - 1), im(N/2 - 1), re(N/2) ].
+extern "C" {
+void* spx_fft_init(int size);
+void spx_fft_destroy(void* table);
+void spx_fft(void* table, float* in, float* out);
+void spx_ifft(void* table, float* in, float* out);
+}
+
+namespace vock {
+namespace audio {
+
+const float DelayEstimator::kMinPeakRatio = 8.0f;
+const float DelayEstimator::kMinEnergy = 1e4f;
+
+DelayEstimator::DelayEstimator(double rate, size_t max_delay) {
+  decimation_ = static_cast<size_t>(rate / kDecimatedRate);
+  if (decimation_ < 1) decimation_ = 1;
+
+  max_lag_ = max_delay / decimation_;
+  if (max_lag_ > kHistory - 1) max_lag_ = kHistory - 1;
+
+  rec_ = new float[kHistory];
+  ref_ = new float[kHistory];
+
+  fft_ = spx_fft_init(2 * kHistory);
+  rec_buf_ = new float[2 * kHistory];
+  ref_buf_ = new float[2 * kHistory];
+  xcorr_ = new float[2 * kHistory];
+
+  Reset();
+}
+
+
+DelayEstimator::~DelayEstimator() {
+  spx_fft_destroy(fft_);
+  delete[] rec_;
+  delete[] ref_;
+  delete[] rec_buf_;
+  delete[] ref_buf_;
+  delete[] xcorr_;
+}
+
+
+void DelayEstimator::Reset() {
+  rec_sum_ = 0;
+  ref_sum_ = 0;
+  sum_count_ = 0;
+  pos_ = 0;
+  filled_ = 0;
+  fresh_ = 0;
+  has_last_ = false;
+  last_lag_ = 0;
+}
+
+
+void DelayEstimator::Update(const int16_t* rec,
+                            const int16_t* ref,
+                            size_t count) {
+  // Average of `decimation_` samples is a crude, but sufficient, lowpass
+  for (size_t i = 0; i < count; i++) {
+    rec_sum_ += rec[i];
+    ref_sum_ += ref[i];
+    if (++sum_count_ != decimation_) continue;
+
+    rec_[pos_] = rec_sum_ / decimation_;
+    ref_[pos_] = ref_sum_ / decimation_;
+    pos_ = (pos_ + 1) & (kHistory - 1);
+    if (filled_ < static_cast<size_t>(kHistory)) filled_++;
+    fresh_++;
+
+    rec_sum_ = 0;
+    ref_sum_ = 0;
+    sum_count_ = 0;
+  }
+}
+
+
+bool DelayEstimator::Estimate(ssize_t* delay) {
+  if (filled_ < static_cast<size_t>(kHistory)) return false;
+  if (fresh_ < static_cast<size_t>(kHistory / 2)) return false;
+  fresh_ = 0;
+
+  // Unroll histories, oldest samples first, without DC
+  float rec_mean = 0;
+  float ref_mean = 0;
+  for (int i = 0; i < kHistory; i++) {
+    rec_mean += rec_[i];
+    ref_mean += ref_[i];
+  }
+  rec_mean /= kHistory;
+  ref_mean /= kHistory;
+
+  float rec_energy = 0;
+  float ref_energy = 0;
+  for (int i = 0; i < kHistory; i++) {
+    size_t j = (pos_ + i) & (kHistory - 1);
+    rec_buf_[i] = rec_[j] - rec_mean;
+    ref_buf_[i] = ref_[j] - ref_mean;
+    rec_energy += rec_buf_[i] * rec_buf_[i];
+    ref_energy += ref_buf_[i] * ref_buf_[i];
+  }
+
+  // Nothing was played or captured (i.e. remote side or mic is muted)
+  if (rec_energy < kMinEnergy * kHistory ||
+      ref_energy < kMinEnergy * kHistory) {
+    has_last_ = false;
+    return false;
+  }
+
+  memset(rec_buf_ + kHistory, 0, kHistory * sizeof(*rec_buf_));
+  memset(ref_buf_ + kHistory, 0, kHistory * sizeof(*ref_buf_));
+
+  // Spectra are kept in `xcorr_` and `rec_buf_`
+  spx_fft(fft_, rec_buf_, xcorr_);
+  spx_fft(fft_, ref_buf_, rec_buf_);
+
+  // rec * conj(ref) / |rec * conj(ref)|, DC and Nyquist bins are dropped
+  int n = 2 * kHistory;
+  ref_buf_[0] = 0;
+  ref_buf_[n - 1] = 0;
+  for (int i = 1; i < n - 1; i += 2) {
+    float ar = xcorr_[i];
+    float ai = xcorr_[i + 1];
+    float br = rec_buf_[i];
+    float bi = rec_buf_[i + 1];
+    float re = ar * br + ai * bi;
+    float im = ai * br - ar * bi;
+    float norm = sqrtf(re * re + im * im) + 1e-20f;
+
+    ref_buf_[i] = re / norm;
+    ref_buf_[i + 1] = im / norm;
+  }
+  spx_ifft(fft_, ref_buf_, xcorr_);
+
+  // Positive lags are at the start, negative ones - at the end
+  int best = 0;
+  float peak = 0;
+  float sum = 0;
+  for (int lag = -max_lag_; lag <= max_lag_; lag++) {
+    float c = xcorr_[lag >= 0 ? lag : n + lag];
+    sum += c * c;
+    if (fabsf(c) > peak) {
+      peak = fabsf(c);
+      best = lag;
+    }
+  }
+
+  float rms = sqrtf(sum / (2 * max_lag_ + 1));
+  if (peak < kMinPeakRatio * rms) {
+    has_last_ = false;
+    return false;
+  }
+
+  // Trust only consistent estimates
+  bool agree = has_last_ && best - last_lag_ <= 1 && last_lag_ - best <= 1;
+  has_last_ = true;
+  last_lag_ = best;
+  if (!agree) return false;
+
+  *delay = static_cast<ssize_t>(best) * static_cast<ssize_t>(decimation_);
+  return true;
+}
+
+} // namespace audio
+} // namespace vock
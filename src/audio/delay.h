@@ -0,0 +1,73 @@
+#ifndef _SRC_AUDIO_DELAY_H_
+#define _SRC_AUDIO_DELAY_H_
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <sys/types.h> // ssize_t
+
+namespace vock {
+namespace audio {
+
+// Estimates delay of the echo in captured signal relative to the echo
+// canceller's reference. Last second of both signals is decimated to
+// ~4kHz and cross-correlated in frequency domain with PHAT weighting
+// (only phase of cross-spectrum is kept), which gives a sharp peak at
+// the echo path's delay even for speech.
+class DelayEstimator {
+ public:
+  static const int kDecimatedRate = 4000;
+
+  // Decimated samples correlated at once, NOTE: should be a power of two
+  static const int kHistory = 4096;
+
+  // Peak of correlation to its RMS, below that estimate isn't trusted
+  static const float kMinPeakRatio;
+
+  // Mean square (of 16bit samples) below which signal is ignored
+  static const float kMinEnergy;
+
+  // Delays of up to `max_delay` samples either way are searched
+  DelayEstimator(double rate, size_t max_delay);
+  ~DelayEstimator();
+
+  // Appends `count` samples of captured and reference signals
+  void Update(const int16_t* rec, const int16_t* ref, size_t count);
+
+  // Correlates histories once per half of it. Returns true and puts
+  // delay in samples (negative if echo comes before the reference)
+  // if the last two estimates agree
+  bool Estimate(ssize_t* delay);
+
+  // Drops history, i.e. after the reference was realigned
+  void Reset();
+
+ protected:
+  size_t decimation_;
+  int max_lag_;
+
+  // Sum of the decimated sample being collected
+  float rec_sum_;
+  float ref_sum_;
+  size_t sum_count_;
+
+  // Circular decimated histories
+  float* rec_;
+  float* ref_;
+  size_t pos_;
+  size_t filled_;
+  size_t fresh_;
+
+  // Zero-padded to twice the history, so correlation doesn't wrap
+  void* fft_;
+  float* rec_buf_;
+  float* ref_buf_;
+  float* xcorr_;
+
+  bool has_last_;
+  int last_lag_;
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_DELAY_H_
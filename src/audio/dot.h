@@ -0,0 +1,67 @@
+#ifndef _SRC_AUDIO_DOT_H_
+#define _SRC_AUDIO_DOT_H_
+
+#ifdef OPUS_X86_SIMD
+#include "simd.h"
+#endif
+
+#include <stddef.h> // size_t
+
+namespace vock {
+namespace audio {
+
+// Float inner products and correlations. On x86 float builds of opus
+// its runtime dispatched SSE2/AVX kernels are used (see deps/opus/x86).
+
+#ifdef OPUS_X86_SIMD
+
+inline float InnerProd(const float* x, const float* y, size_t len) {
+  return opus_simd_get()->inner_prod(x, y, static_cast<int>(len));
+}
+
+
+// xcorr[i] = InnerProd(x, y + i, len) for i < max_lag
+inline void Xcorr(const float* x,
+                  const float* y,
+                  float* xcorr,
+                  size_t len,
+                  size_t max_lag) {
+  opus_simd_get()->pitch_xcorr(x,
+                               y,
+                               xcorr,
+                               static_cast<int>(len),
+                               static_cast<int>(max_lag));
+}
+
+#else
+
+// Independent partial sums, so compiler may vectorize it without -ffast-math
+inline float InnerProd(const float* x, const float* y, size_t len) {
+  float sum[4] = { 0, 0, 0, 0 };
+  size_t i;
+  for (i = 0; i + 3 < len; i += 4) {
+    sum[0] += x[i] * y[i];
+    sum[1] += x[i + 1] * y[i + 1];
+    sum[2] += x[i + 2] * y[i + 2];
+    sum[3] += x[i + 3] * y[i + 3];
+  }
+  for (; i < len; i++) sum[0] += x[i] * y[i];
+
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+
+inline void Xcorr(const float* x,
+                  const float* y,
+                  float* xcorr,
+                  size_t len,
+                  size_t max_lag) {
+  for (size_t i = 0; i < max_lag; i++) xcorr[i] = InnerProd(x, y + i, len);
+}
+
+#endif
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_DOT_H_
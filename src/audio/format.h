@@ -0,0 +1,45 @@
+#ifndef _SRC_AUDIO_FORMAT_H_
+#define _SRC_AUDIO_FORMAT_H_
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace audio {
+
+// Internal sample format of the whole capture/playback pipeline
+enum SampleFormat {
+  kInt16Format,
+  kFloat32Format
+};
+
+inline size_t SampleSize(SampleFormat format) {
+  return format == kFloat32Format ? sizeof(float) : sizeof(int16_t);
+}
+
+// Speex's AEC and preprocessor only accept 16bit samples,
+// these are used on the boundary of them in float mode.
+inline void FloatToInt16(const float* in, int16_t* out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float sample = in[i] * 32768.0f;
+    if (sample > 32767.0f) {
+      out[i] = 32767;
+    } else if (sample < -32768.0f) {
+      out[i] = -32768;
+    } else {
+      out[i] = static_cast<int16_t>(sample);
+    }
+  }
+}
+
+
+inline void Int16ToFloat(const int16_t* in, float* out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = static_cast<float>(in[i]) * (1.0f / 32768.0f);
+  }
+}
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_FORMAT_H_
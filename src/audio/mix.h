@@ -0,0 +1,85 @@
+#ifndef _SRC_AUDIO_MIX_H_
+#define _SRC_AUDIO_MIX_H_
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace audio {
+
+// Soft clipping sum of two samples, a + b - a * b for positive ones and
+// a + b + a * b for negative ones (in [-1, 1] scale). Stays within int16
+// range for any inputs.
+inline int16_t MixSample(int32_t a, int32_t b) {
+  if (a > 0 && b > 0) {
+    return a + b - (a * b) / 32767;
+  } else if (a < 0 && b < 0) {
+    return a + b + (a * b) / 32768;
+  } else {
+    return a + b;
+  }
+}
+
+
+// Mixes `b` into `a` with soft clipping (see MixSample)
+inline void MixInt16(int16_t* a, const int16_t* b, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    a[i] = MixSample(a[i], b[i]);
+  }
+}
+
+
+// Same as above, but `b` is scaled by gain ramping linearly
+// from `gain` by `step` per sample (to avoid clicks on changes)
+inline void MixInt16Gain(int16_t* a,
+                         const int16_t* b,
+                         size_t count,
+                         float gain,
+                         float step) {
+  for (size_t i = 0; i < count; i++, gain += step) {
+    int32_t s = static_cast<int32_t>(b[i] * gain);
+    if (s > 32767) {
+      s = 32767;
+    } else if (s < -32768) {
+      s = -32768;
+    }
+
+    a[i] = MixSample(a[i], s);
+  }
+}
+
+
+// Plain sum, there is enough headroom in float to clip only once
+// (see ClipFloat)
+inline void MixFloat(float* a, const float* b, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    a[i] += b[i];
+  }
+}
+
+
+inline void MixFloatGain(float* a,
+                         const float* b,
+                         size_t count,
+                         float gain,
+                         float step) {
+  for (size_t i = 0; i < count; i++, gain += step) {
+    a[i] += b[i] * gain;
+  }
+}
+
+
+inline void ClipFloat(float* a, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (a[i] > 1.0f) {
+      a[i] = 1.0f;
+    } else if (a[i] < -1.0f) {
+      a[i] = -1.0f;
+    }
+  }
+}
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_MIX_H_
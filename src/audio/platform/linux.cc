@@ -11,31 +11,42 @@
 namespace vock {
 namespace audio {
 
-PlatformUnit::PlatformUnit(Kind kind, double rate) : pa_ml_(NULL),
-                                                     pa_mlapi_(NULL),
-                                                     pa_ctx_(NULL),
-                                                     pa_stream_(NULL),
-                                                     active_(false),
-                                                     kind_(kind),
-                                                     rate_(rate) {
-  pa_ss_.format = PA_SAMPLE_S16LE;
+PlatformUnit::PlatformUnit(Kind kind, double rate, SampleFormat format)
+    : pa_ml_(NULL),
+      pa_mlapi_(NULL),
+      pa_ctx_(NULL),
+      pa_stream_(NULL),
+      active_(false),
+      closed_(false),
+      kind_(kind),
+      rate_(rate),
+      format_(format),
+      peek_data_(NULL),
+      peek_size_(0),
+      peek_offset_(0),
+      capture_size_(0) {
+  pa_ss_.format = format == kFloat32Format ? PA_SAMPLE_FLOAT32LE :
+                                             PA_SAMPLE_S16LE;
   pa_ss_.channels = 1;
   pa_ss_.rate = rate;
   input_rate_ = rate;
-
-  buff_size_ = 2 * rate / 100;
+  output_rate_ = rate;
 
   uv_sem_init(&loop_terminate_, 0);
-  uv_mutex_init(&stream_mutex_);
+  uv_sem_init(&rate_ready_, 0);
   uv_thread_create(&loop_, Loop, this);
+
+  // Device's rate is known once loop is connected
+  uv_sem_wait(&rate_ready_);
 }
 
 
 PlatformUnit::~PlatformUnit() {
-  Stop();
-  uv_sem_post(&loop_terminate_);
-  uv_thread_join(&loop_);
-  uv_mutex_destroy(&stream_mutex_);
+  Close();
+  uv_sem_destroy(&rate_ready_);
+
+  // Freed only after join, so wakeups never touch a dead loop
+  if (pa_ml_ != NULL) pa_mainloop_free(pa_ml_);
   uv_sem_destroy(&loop_terminate_);
 }
 
@@ -98,6 +109,10 @@ void PlatformUnit::StartLoop() {
   }
   assert(pa_state_ == 1);
 
+  NegotiateRate();
+  buff_size_ = SampleSize(format_) * pa_ss_.rate / 100;
+  uv_sem_post(&rate_ready_);
+
   // Create stream
   attr.maxlength = buff_size_ * 2;
   attr.tlength = buff_size_;
@@ -108,7 +123,8 @@ void PlatformUnit::StartLoop() {
   stream = pa_stream_new(pa_ctx_, "Vock.Stream", &pa_ss_, NULL);
   assert(stream != NULL);
 
-  uv_mutex_lock(&stream_mutex_);
+  // Start() may have been called already
+  ApplyCommands();
   flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY |
                                          PA_STREAM_INTERPOLATE_TIMING |
                                          PA_STREAM_AUTO_TIMING_UPDATE |
@@ -125,19 +141,91 @@ void PlatformUnit::StartLoop() {
   }
 
   pa_stream_ = stream;
-  uv_mutex_unlock(&stream_mutex_);
+}
+
+
+void PlatformUnit::NegotiateRate() {
+  device_name_[0] = 0;
+  device_rate_ = 0;
+
+  // Open stream at the rate of default device,
+  // so server won't have to resample it
+  WaitOperation(pa_context_get_server_info(pa_ctx_, ServerInfoCallback, this));
+  if (device_name_[0] != 0) {
+    if (kind_ == kInputUnit) {
+      WaitOperation(pa_context_get_source_info_by_name(pa_ctx_,
+                                                       device_name_,
+                                                       SourceInfoCallback,
+                                                       this));
+    } else {
+      WaitOperation(pa_context_get_sink_info_by_name(pa_ctx_,
+                                                     device_name_,
+                                                     SinkInfoCallback,
+                                                     this));
+    }
+  }
+
+  if (device_rate_ == 0) return;
+
+  pa_ss_.rate = device_rate_;
+  if (kind_ == kInputUnit) {
+    input_rate_ = device_rate_;
+  } else {
+    output_rate_ = device_rate_;
+  }
+}
+
+
+void PlatformUnit::WaitOperation(pa_operation* op) {
+  if (op == NULL) return;
+
+  while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+    pa_mainloop_iterate(pa_ml_, 1, NULL);
+  }
+  pa_operation_unref(op);
+}
+
+
+void PlatformUnit::ServerInfoCallback(pa_context* ctx,
+                                      const pa_server_info* info,
+                                      void* arg) {
+  PlatformUnit* unit = reinterpret_cast<PlatformUnit*>(arg);
+  const char* name = unit->kind_ == kInputUnit ? info->default_source_name :
+                                                 info->default_sink_name;
+  if (name == NULL) return;
+
+  strncpy(unit->device_name_, name, sizeof(unit->device_name_) - 1);
+  unit->device_name_[sizeof(unit->device_name_) - 1] = 0;
+}
+
+
+void PlatformUnit::SinkInfoCallback(pa_context* ctx,
+                                    const pa_sink_info* info,
+                                    int eol,
+                                    void* arg) {
+  if (eol != 0 || info == NULL) return;
+  reinterpret_cast<PlatformUnit*>(arg)->device_rate_ = info->sample_spec.rate;
+}
+
+
+void PlatformUnit::SourceInfoCallback(pa_context* ctx,
+                                      const pa_source_info* info,
+                                      int eol,
+                                      void* arg) {
+  if (eol != 0 || info == NULL) return;
+  reinterpret_cast<PlatformUnit*>(arg)->device_rate_ = info->sample_spec.rate;
 }
 
 
 void PlatformUnit::EndLoop() {
   pa_context_disconnect(pa_ctx_);
   pa_context_unref(pa_ctx_);
-  pa_mainloop_free(pa_ml_);
 }
 
 
 bool PlatformUnit::RunLoop() {
   pa_mainloop_iterate(pa_ml_, 1, NULL);
+  ApplyCommands();
 
   // Continue polling
   return true;
@@ -151,64 +239,132 @@ void PlatformUnit::RequestCallback(pa_stream* p, size_t bytes, void* arg) {
 
 void PlatformUnit::RequestCallback(size_t bytes) {
   if (kind_ == kInputUnit) {
+    capture_size_ = bytes;
     input_cb_(input_arg_, bytes);
   } else {
     int r;
     char* buff;
 
-    uv_mutex_lock(&stream_mutex_);
     assert(pa_stream_begin_write(pa_stream_,
                                  reinterpret_cast<void**>(&buff),
                                  &bytes) == 0);
     output_cb_(output_arg_, buff, bytes);
     r = pa_stream_write(pa_stream_, buff, bytes, NULL, 0, PA_SEEK_RELATIVE);
     assert(r >= 0);
-    uv_mutex_unlock(&stream_mutex_);
   }
 }
 
 
-void PlatformUnit::Start() {
-  uv_mutex_lock(&stream_mutex_);
-  if (!active_) {
-    active_ = true;
+void PlatformUnit::ApplyCommands() {
+  Command cmd;
+
+  while (control_.Pop(&cmd)) {
+    bool active = cmd.type == Command::kStart;
+    if (active == active_) continue;
+    active_ = active;
 
     if (pa_stream_ != NULL) {
-      pa_stream_cork(pa_stream_, 0, NULL, NULL);
+      pa_stream_cork(pa_stream_, active ? 0 : 1, NULL, NULL);
     }
   }
-  uv_mutex_unlock(&stream_mutex_);
 }
 
 
-void PlatformUnit::Stop() {
-  uv_mutex_lock(&stream_mutex_);
-  if (active_) {
-    active_ = false;
+void PlatformUnit::Start() {
+  if (!control_.Push(Command::kStart)) {
+    fprintf(stderr, "PlatformUnit control queue is full!\n");
+    abort();
+  }
+  if (pa_ml_ != NULL) pa_mainloop_wakeup(pa_ml_);
+}
 
-    if (pa_stream_ != NULL) {
-      pa_stream_cork(pa_stream_, 1, NULL, NULL);
-    }
+
+void PlatformUnit::Stop() {
+  if (!control_.Push(Command::kStop)) {
+    fprintf(stderr, "PlatformUnit control queue is full!\n");
+    abort();
   }
-  uv_mutex_unlock(&stream_mutex_);
+  if (pa_ml_ != NULL) pa_mainloop_wakeup(pa_ml_);
+}
+
+
+void PlatformUnit::Close() {
+  if (closed_) return;
+  closed_ = true;
+
+  // Callbacks run on the loop thread, nothing calls them after join
+  Stop();
+  uv_sem_post(&loop_terminate_);
+  if (pa_ml_ != NULL) pa_mainloop_wakeup(pa_ml_);
+  uv_thread_join(&loop_);
+}
+
+
+size_t PlatformUnit::Render(char* out1,
+                            size_t size1,
+                            char* out2,
+                            size_t size2) {
+  size_t holes;
+
+  holes = Capture(out1, size1);
+  holes += Capture(out2, size2);
+
+  // Drop what didn't fit
+  Capture(NULL, capture_size_);
+
+  return holes;
 }
 
 
-void PlatformUnit::Render(char* out, size_t size) {
-  int r;
-  const void* data;
-  size_t bytes = size;
+size_t PlatformUnit::Capture(char* out, size_t size) {
+  size_t holes = 0;
 
-  uv_mutex_lock(&stream_mutex_);
-  r = pa_stream_peek(pa_stream_, &data, &bytes);
-  assert(r >= 0);
-  assert(bytes <= size);
+  // Callback's data may span several fragments
+  while (size > 0) {
+    if (peek_size_ == 0) {
+      const void* data;
+      size_t bytes;
+      int r = pa_stream_peek(pa_stream_, &data, &bytes);
+      assert(r >= 0);
 
-  memcpy(out, data, bytes);
-  memset(out + bytes, 0, size - bytes);
+      // Nothing left
+      if (bytes == 0) break;
+
+      peek_data_ = reinterpret_cast<const char*>(data);
+      peek_size_ = bytes;
+      peek_offset_ = 0;
+    }
+
+    size_t chunk = peek_size_ - peek_offset_;
+    if (chunk > size) chunk = size;
+
+    if (out != NULL) {
+      // NULL data is a hole in the stream (i.e. overrun on server)
+      if (peek_data_ == NULL) {
+        memset(out, 0, chunk);
+        holes += chunk;
+      } else {
+        memcpy(out, peek_data_ + peek_offset_, chunk);
+      }
+      out += chunk;
+    }
 
-  pa_stream_drop(pa_stream_);
-  uv_mutex_unlock(&stream_mutex_);
+    size -= chunk;
+    peek_offset_ += chunk;
+    capture_size_ -= chunk > capture_size_ ? capture_size_ : chunk;
+    if (peek_offset_ == peek_size_) {
+      pa_stream_drop(pa_stream_);
+      peek_size_ = 0;
+    }
+  }
+
+  // Stream gave less than it has announced
+  if (out != NULL && size > 0) {
+    memset(out, 0, size);
+    holes += size;
+  }
+
+  return holes;
 }
 
 
@@ -217,6 +373,11 @@ double PlatformUnit::GetInputSampleRate() {
 }
 
 
+double PlatformUnit::GetOutputSampleRate() {
+  return output_rate_;
+}
+
+
 void PlatformUnit::SetInputCallback(InputCallbackFn cb, void* arg) {
   input_cb_ = cb;
   input_arg_ = arg;
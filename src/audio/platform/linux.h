@@ -2,6 +2,8 @@
 #define _SRC_AUDIO_PLATFORM_LINUX_
 
 #include "uv.h"
+#include "format.h"
+#include "control.h"
 #include <pulse/pulseaudio.h>
 
 namespace vock {
@@ -17,15 +19,24 @@ class PlatformUnit {
     kOutputUnit
   };
 
-  PlatformUnit(Kind kind, double rate);
+  PlatformUnit(Kind kind, double rate, SampleFormat format);
   ~PlatformUnit();
 
   void Start();
   void Stop();
 
-  void Render(char* out, size_t size);
+  // Stops the unit and waits until its callbacks are over for good,
+  // may be called more than once (destructor does it too)
+  void Close();
 
+  // Writes captured data of the current input callback into two regions
+  // (i.e. ring's write regions), the rest of callback's data is dropped.
+  // Returns number of bytes that were zero filled because of capture holes
+  size_t Render(char* out1, size_t size1, char* out2, size_t size2);
+
+  // Device's native rates, data is exchanged at them
   double GetInputSampleRate();
+  double GetOutputSampleRate();
 
   void SetInputCallback(InputCallbackFn cb, void* arg);
   void SetOutputCallback(OutputCallbackFn cb, void* arg);
@@ -34,13 +45,29 @@ class PlatformUnit {
   static void Loop(void* arg);
   static void StateCallback(pa_context* ctx, void* arg);
   static void RequestCallback(pa_stream* p, size_t bytes, void* arg);
+  static void ServerInfoCallback(pa_context* ctx,
+                                 const pa_server_info* info,
+                                 void* arg);
+  static void SinkInfoCallback(pa_context* ctx,
+                               const pa_sink_info* info,
+                               int eol,
+                               void* arg);
+  static void SourceInfoCallback(pa_context* ctx,
+                                 const pa_source_info* info,
+                                 int eol,
+                                 void* arg);
 
   void StartLoop();
+  void NegotiateRate();
+  void WaitOperation(pa_operation* op);
   void EndLoop();
   bool RunLoop();
+  void ApplyCommands();
   void RequestCallback(size_t bytes);
+  size_t Capture(char* out, size_t size);
 
-  pa_mainloop* pa_ml_;
+  // Set by loop thread, other threads only wake it up
+  pa_mainloop* volatile pa_ml_;
   pa_mainloop_api* pa_mlapi_;
   pa_context* pa_ctx_;
   pa_sample_spec pa_ss_;
@@ -49,17 +76,35 @@ class PlatformUnit {
 
   uv_thread_t loop_;
   uv_sem_t loop_terminate_;
-  uv_mutex_t stream_mutex_;
+  uv_sem_t rate_ready_;
 
+  // Everything touching pa_stream_ happens on the loop thread,
+  // Start()/Stop() are passed to it through the queue
+  ControlQueue control_;
   bool active_;
+  bool closed_;
 
   Kind kind_;
   double rate_;
   double input_rate_;
+  double output_rate_;
+
+  // Default sink or source, and its rate (0 - unknown)
+  char device_name_[256];
+  uint32_t device_rate_;
   unsigned int channels_;
+  SampleFormat format_;
 
   ssize_t buff_size_;
 
+  // Fragment returned by pa_stream_peek(), kept until it's fully consumed
+  const char* peek_data_;
+  size_t peek_size_;
+  size_t peek_offset_;
+
+  // Bytes of the current input callback not consumed yet
+  size_t capture_size_;
+
   InputCallbackFn input_cb_;
   void* input_arg_;
 
@@ -1,6 +1,7 @@
 #include "mac.h"
 
 #include <stdint.h>
+#include <string.h> // memcpy
 #include <AudioUnit/AudioUnit.h>
 #include <AudioToolbox/AudioToolbox.h>
 
@@ -16,7 +17,11 @@
 namespace vock {
 namespace audio {
 
-PlatformUnit::PlatformUnit(Kind kind, double rate) : rate_(rate) {
+PlatformUnit::PlatformUnit(Kind kind, double rate, SampleFormat format)
+    : rate_(rate),
+      input_rate_(rate),
+      output_rate_(rate),
+      sample_size_(SampleSize(format)) {
   UInt32 enable = 1;
   UInt32 disable = 0;
 
@@ -122,13 +127,29 @@ PlatformUnit::PlatformUnit(Kind kind, double rate) : rate_(rate) {
     // Use device's native sample rate
     asbd.mSampleRate = input_rate_;
   } else if (kind == kOutputUnit) {
-    asbd.mSampleRate = rate;
+    // Get device's sample rate
+    UInt32 size = sizeof(output_rate_);
+    CHECK(AudioUnitGetProperty(unit_,
+                               kAudioUnitProperty_SampleRate,
+                               kAudioUnitScope_Output,
+                               kOutputBus,
+                               &output_rate_,
+                               &size),
+          "Failed to get output's rate")
+
+    // Use device's native sample rate, mix is resampled by HALUnit
+    asbd.mSampleRate = output_rate_;
   }
 
   asbd.mFormatID = kAudioFormatLinearPCM;
-  asbd.mFormatFlags = kLinearPCMFormatFlagIsSignedInteger;
+  if (format == kFloat32Format) {
+    asbd.mFormatFlags = kLinearPCMFormatFlagIsFloat |
+                        kLinearPCMFormatFlagIsPacked;
+  } else {
+    asbd.mFormatFlags = kLinearPCMFormatFlagIsSignedInteger;
+  }
   asbd.mChannelsPerFrame = 1;
-  asbd.mBitsPerChannel = 16;
+  asbd.mBitsPerChannel = sample_size_ * 8;
   asbd.mFramesPerPacket = 1;
   asbd.mBytesPerPacket = asbd.mBitsPerChannel >> 3;
   asbd.mBytesPerFrame = asbd.mBytesPerPacket * asbd.mChannelsPerFrame;
@@ -196,13 +217,40 @@ void PlatformUnit::Stop() {
 }
 
 
-void PlatformUnit::Render(char* out, size_t size) {
-  in_list_.mBuffers[0].mData = out;
-  in_list_.mBuffers[0].mDataByteSize = size;
+void PlatformUnit::Close() {
+  // AudioOutputUnitStop() returns once the render callback is done
+  Stop();
+}
 
+
+size_t PlatformUnit::Render(char* out1,
+                            size_t size1,
+                            char* out2,
+                            size_t size2) {
   InputCallbackState* s = &input_state_;
-  CHECK(AudioUnitRender(unit_, s->flags, s->ts, s->bus, size / 2, &in_list_),
+
+  // Render straight into the first region if the whole callback fits there,
+  // otherwise unit provides its own buffer (NULL mData) to copy from
+  bool direct = size1 == s->size;
+  in_list_.mBuffers[0].mData = direct ? out1 : NULL;
+  in_list_.mBuffers[0].mDataByteSize = s->size;
+
+  CHECK(AudioUnitRender(unit_,
+                        s->flags,
+                        s->ts,
+                        s->bus,
+                        s->size / sample_size_,
+                        &in_list_),
         "AudioUnitRender failed")
+
+  if (!direct) {
+    const char* data = reinterpret_cast<const char*>(
+        in_list_.mBuffers[0].mData);
+    memcpy(out1, data, size1);
+    memcpy(out2, data + size1, size2);
+  }
+
+  return 0;
 }
 
 
@@ -211,6 +259,11 @@ double PlatformUnit::GetInputSampleRate() {
 }
 
 
+double PlatformUnit::GetOutputSampleRate() {
+  return output_rate_;
+}
+
+
 void PlatformUnit::SetInputCallback(InputCallbackFn cb, void* arg) {
   input_cb_ = cb;
   input_arg_ = arg;
@@ -234,7 +287,8 @@ OSStatus PlatformUnit::InputCallback(void* arg,
   unit->input_state_.flags = flags;
   unit->input_state_.ts = ts;
   unit->input_state_.bus = bus;
-  unit->input_cb_(unit->input_arg_, frame_count * 2);
+  unit->input_state_.size = frame_count * unit->sample_size_;
+  unit->input_cb_(unit->input_arg_, frame_count * unit->sample_size_);
 
   return noErr;
 }
@@ -249,7 +303,9 @@ OSStatus PlatformUnit::OutputCallback(void* arg,
   PlatformUnit* unit = reinterpret_cast<PlatformUnit*>(arg);
 
   char* buff = reinterpret_cast<char*>(data->mBuffers[0].mData);
-  unit->output_cb_(unit->output_arg_, buff, frame_count * 2);
+  unit->output_cb_(unit->output_arg_,
+                   buff,
+                   frame_count * unit->sample_size_);
 
   return noErr;
 }
@@ -1,6 +1,7 @@
 #ifndef _SRC_AUDIO_PLATFORM_MAC_
 #define _SRC_AUDIO_PLATFORM_MAC_
 
+#include "format.h"
 #include <AudioUnit/AudioUnit.h>
 #include <AudioToolbox/AudioToolbox.h>
 
@@ -21,17 +22,27 @@ class PlatformUnit {
     AudioUnitRenderActionFlags* flags;
     const AudioTimeStamp* ts;
     UInt32 bus;
+    size_t size;
   };
 
-  PlatformUnit(Kind kind, double rate);
+  PlatformUnit(Kind kind, double rate, SampleFormat format);
   ~PlatformUnit();
 
   void Start();
   void Stop();
 
-  void Render(char* out, size_t size);
+  // Stops the unit and waits until its callbacks are over for good,
+  // may be called more than once (destructor does it too)
+  void Close();
 
+  // Writes captured data of the current input callback into two regions
+  // (i.e. ring's write regions), the rest of callback's data is dropped.
+  // Returns number of bytes that were zero filled because of capture holes
+  size_t Render(char* out1, size_t size1, char* out2, size_t size2);
+
+  // Device's native rates, data is exchanged at them
   double GetInputSampleRate();
+  double GetOutputSampleRate();
 
   void SetInputCallback(InputCallbackFn cb, void* arg);
   void SetOutputCallback(OutputCallbackFn cb, void* arg);
@@ -56,6 +67,8 @@ class PlatformUnit {
   AudioUnit unit_;
   double rate_;
   double input_rate_;
+  double output_rate_;
+  size_t sample_size_;
 
   InputCallbackFn input_cb_;
   void* input_arg_;
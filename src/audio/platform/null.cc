@@ -0,0 +1,151 @@
+#include "null.h"
+#include "uv.h"
+
+#include <stdint.h>
+#include <string.h> // memset
+#include <time.h> // nanosleep
+
+namespace vock {
+namespace audio {
+
+PlatformUnit::PlatformUnit(Kind kind, double rate, SampleFormat format)
+    : kind_(kind),
+      rate_(rate),
+      active_(false),
+      closed_(false),
+      input_cb_(NULL),
+      input_arg_(NULL),
+      output_cb_(NULL),
+      output_arg_(NULL),
+      capture_cb_(NULL),
+      capture_arg_(NULL),
+      playback_cb_(NULL),
+      playback_arg_(NULL) {
+  buff_size_ = SampleSize(format) * static_cast<size_t>(rate) *
+               kPeriodMs / 1000;
+  buff_ = new char[buff_size_];
+
+  uv_sem_init(&loop_terminate_, 0);
+  uv_thread_create(&loop_, Loop, this);
+}
+
+
+PlatformUnit::~PlatformUnit() {
+  Close();
+  uv_sem_destroy(&loop_terminate_);
+  delete[] buff_;
+}
+
+
+void PlatformUnit::Loop(void* arg) {
+  PlatformUnit* unit = reinterpret_cast<PlatformUnit*>(arg);
+  uint64_t period = kPeriodMs * 1000000ULL;
+  uint64_t deadline = uv_hrtime();
+
+  while (uv_sem_trywait(&unit->loop_terminate_) != 0) {
+    if (unit->active_) unit->Tick();
+
+    // Sleep until the next period, without accumulating drift
+    deadline += period;
+    uint64_t now = uv_hrtime();
+    if (deadline > now) {
+      struct timespec ts;
+      ts.tv_sec = (deadline - now) / 1000000000ULL;
+      ts.tv_nsec = (deadline - now) % 1000000000ULL;
+      nanosleep(&ts, NULL);
+    } else {
+      // Fell behind (e.g. was descheduled), don't try to catch up
+      deadline = now;
+    }
+  }
+}
+
+
+void PlatformUnit::Tick() {
+  if (kind_ == kInputUnit) {
+    if (input_cb_ != NULL) input_cb_(input_arg_, buff_size_);
+  } else {
+    if (output_cb_ == NULL) return;
+    output_cb_(output_arg_, buff_, buff_size_);
+    if (playback_cb_ != NULL) playback_cb_(playback_arg_, buff_, buff_size_);
+  }
+}
+
+
+void PlatformUnit::Start() {
+  active_ = true;
+}
+
+
+void PlatformUnit::Stop() {
+  active_ = false;
+}
+
+
+void PlatformUnit::Close() {
+  if (closed_) return;
+  closed_ = true;
+
+  // Tick() may be in progress, it's over once the loop is joined
+  Stop();
+  uv_sem_post(&loop_terminate_);
+  uv_thread_join(&loop_);
+}
+
+
+size_t PlatformUnit::Render(char* out1,
+                            size_t size1,
+                            char* out2,
+                            size_t size2) {
+  char* outs[2] = { out1, out2 };
+  size_t sizes[2] = { size1, size2 };
+
+  for (int i = 0; i < 2; i++) {
+    if (sizes[i] == 0) continue;
+
+    if (capture_cb_ != NULL) {
+      capture_cb_(capture_arg_, outs[i], sizes[i]);
+    } else {
+      memset(outs[i], 0, sizes[i]);
+    }
+  }
+
+  return 0;
+}
+
+
+double PlatformUnit::GetInputSampleRate() {
+  return rate_;
+}
+
+
+double PlatformUnit::GetOutputSampleRate() {
+  return rate_;
+}
+
+
+void PlatformUnit::SetInputCallback(InputCallbackFn cb, void* arg) {
+  input_cb_ = cb;
+  input_arg_ = arg;
+}
+
+
+void PlatformUnit::SetOutputCallback(OutputCallbackFn cb, void* arg) {
+  output_cb_ = cb;
+  output_arg_ = arg;
+}
+
+
+void PlatformUnit::SetCaptureSource(CaptureFn fn, void* arg) {
+  capture_cb_ = fn;
+  capture_arg_ = arg;
+}
+
+
+void PlatformUnit::SetPlaybackSink(PlaybackFn fn, void* arg) {
+  playback_cb_ = fn;
+  playback_arg_ = arg;
+}
+
+} // namespace audio
+} // namespace vock
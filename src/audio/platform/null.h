@@ -0,0 +1,87 @@
+#ifndef _SRC_AUDIO_PLATFORM_NULL_
+#define _SRC_AUDIO_PLATFORM_NULL_
+
+#include "uv.h"
+#include "format.h"
+
+namespace vock {
+namespace audio {
+
+typedef void (*InputCallbackFn)(void*, size_t);
+typedef void (*OutputCallbackFn)(void*, char*, size_t);
+
+// Synthetic device: runs callbacks from its own thread at real-time pace,
+// without touching any sound hardware. Used by benchmarks and headless
+// processes.
+class PlatformUnit {
+ public:
+  enum Kind {
+    kInputUnit,
+    kOutputUnit
+  };
+
+  // Fills captured data (defaults to silence)
+  typedef void (*CaptureFn)(void* arg, char* out, size_t size);
+  // Observes data that was just "played"
+  typedef void (*PlaybackFn)(void* arg, const char* data, size_t size);
+
+  PlatformUnit(Kind kind, double rate, SampleFormat format);
+  ~PlatformUnit();
+
+  void Start();
+  void Stop();
+
+  // Stops the unit and waits until its callbacks are over for good,
+  // may be called more than once (destructor does it too)
+  void Close();
+
+  // Writes captured data of the current input callback into two regions
+  // (i.e. ring's write regions), the rest of callback's data is dropped.
+  // Returns number of bytes that were zero filled because of capture holes
+  size_t Render(char* out1, size_t size1, char* out2, size_t size2);
+
+  double GetInputSampleRate();
+  double GetOutputSampleRate();
+
+  void SetInputCallback(InputCallbackFn cb, void* arg);
+  void SetOutputCallback(OutputCallbackFn cb, void* arg);
+
+  void SetCaptureSource(CaptureFn fn, void* arg);
+  void SetPlaybackSink(PlaybackFn fn, void* arg);
+
+  inline uv_thread_t* thread() { return &loop_; }
+
+ private:
+  // Device period
+  static const int kPeriodMs = 10;
+
+  static void Loop(void* arg);
+  void Tick();
+
+  Kind kind_;
+  double rate_;
+  size_t buff_size_;
+  char* buff_;
+
+  uv_thread_t loop_;
+  uv_sem_t loop_terminate_;
+  volatile bool active_;
+  bool closed_;
+
+  InputCallbackFn input_cb_;
+  void* input_arg_;
+
+  OutputCallbackFn output_cb_;
+  void* output_arg_;
+
+  CaptureFn capture_cb_;
+  void* capture_arg_;
+
+  PlaybackFn playback_cb_;
+  void* playback_arg_;
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_PLATFORM_NULL_
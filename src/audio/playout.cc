@@ -0,0 +1,349 @@
+#include "playout.h"
+#include "unit.h"
+#include "opus/codec.h"
+#include "portaudio/pa_ringbuffer.h"
+
+#include <stdio.h> // fprintf
+#include <string.h> // memcpy
+#include <stdlib.h> // abort
+
+namespace vock {
+namespace audio {
+
+Playout::Playout(HALUnit* unit, double rate, SampleFormat format)
+    : unit_(unit),
+      rate_(rate),
+      format_(format),
+      sample_size_(SampleSize(format)),
+      stretch_(rate, static_cast<size_t>(rate * 0.12)) {
+  queue_buf_ = new Packet[kQueueSize];
+  if (PaUtil_InitializeRingBuffer(&queue_,
+                                  sizeof(Packet),
+                                  kQueueSize,
+                                  queue_buf_) == -1) {
+    fprintf(stderr, "Failed to initialize playout queue!\n");
+    abort();
+  }
+
+  max_samples_ = static_cast<int>(rate * 0.12);
+  scratch_ = new char[stretch_.MaxOutput(max_samples_) * sample_size_];
+  stretch_in_ = new float[max_samples_];
+  stretch_out_ = new float[stretch_.MaxOutput(max_samples_)];
+
+  channels_ = new Channel[HALUnit::kOutRingCount];
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) {
+    channels_[i].active = false;
+    channels_[i].frame_samples = static_cast<int>(rate * 0.02);
+    Clear(&channels_[i]);
+    decoders_[i] = NULL;
+  }
+}
+
+
+Playout::~Playout() {
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) delete decoders_[i];
+  delete[] channels_;
+  delete[] scratch_;
+  delete[] stretch_in_;
+  delete[] stretch_out_;
+  delete[] queue_buf_;
+}
+
+
+bool Playout::Push(int index, uint32_t seq, const char* data, size_t len) {
+  if (len > static_cast<size_t>(kMaxPacketSize)) return false;
+
+  if (decoders_[index] == NULL) {
+    opus::Codec* codec = new opus::Codec(rate_, 1);
+    if (codec->InitDecoder() != OPUS_OK) {
+      delete codec;
+      return false;
+    }
+    decoders_[index] = codec;
+  }
+
+  void* data1;
+  void* data2;
+  ring_buffer_size_t size1;
+  ring_buffer_size_t size2;
+  if (PaUtil_GetRingBufferWriteRegions(&queue_,
+                                       1,
+                                       &data1,
+                                       &size1,
+                                       &data2,
+                                       &size2) != 1) {
+    return false;
+  }
+
+  Packet* packet = reinterpret_cast<Packet*>(data1);
+  packet->index = index;
+  packet->seq = seq;
+  packet->len = len;
+  memcpy(packet->data, data, len);
+  PaUtil_AdvanceRingBufferWriteIndex(&queue_, 1);
+
+  return true;
+}
+
+
+bool Playout::Reset(int index) {
+  void* data1;
+  void* data2;
+  ring_buffer_size_t size1;
+  ring_buffer_size_t size2;
+  if (PaUtil_GetRingBufferWriteRegions(&queue_,
+                                       1,
+                                       &data1,
+                                       &size1,
+                                       &data2,
+                                       &size2) != 1) {
+    return false;
+  }
+
+  Packet* packet = reinterpret_cast<Packet*>(data1);
+  packet->index = index;
+  packet->seq = 0;
+  packet->len = -1;
+  PaUtil_AdvanceRingBufferWriteIndex(&queue_, 1);
+
+  return true;
+}
+
+
+void Playout::PullCallback(void* arg, size_t samples) {
+  reinterpret_cast<Playout*>(arg)->Pull(samples);
+}
+
+
+void Playout::Pull(size_t samples) {
+  // Take incoming packets in place
+  while (PaUtil_GetRingBufferReadAvailable(&queue_) > 0) {
+    void* data1;
+    void* data2;
+    ring_buffer_size_t size1;
+    ring_buffer_size_t size2;
+    PaUtil_GetRingBufferReadRegions(&queue_,
+                                    1,
+                                    &data1,
+                                    &size1,
+                                    &data2,
+                                    &size2);
+    Accept(reinterpret_cast<Packet*>(data1));
+    PaUtil_AdvanceRingBufferReadIndex(&queue_, 1);
+  }
+
+  // Top up rings of active channels for this callback
+  for (int i = 0; i < HALUnit::kOutRingCount; i++) {
+    Channel* c = &channels_[i];
+    if (!c->active) continue;
+
+    while (unit_->GetQueued(i) < samples) {
+      if (!Next(i, c)) break;
+    }
+  }
+}
+
+
+void Playout::Accept(Packet* packet) {
+  Channel* c = &channels_[packet->index];
+
+  if (packet->len < 0) {
+    // Decoder is known to this thread only after channel's first packet
+    if (c->active) decoders_[packet->index]->ResetDecoder();
+    Clear(c);
+    c->active = false;
+    return;
+  }
+  c->active = true;
+
+  if (c->started) {
+    int32_t distance = static_cast<int32_t>(packet->seq - c->next_seq);
+
+    // Already played (or concealed)
+    if (distance < 0) {
+      stats_.late.Inc();
+      return;
+    }
+
+    // Sender has restarted or we're too far behind, start over
+    if (distance >= kSlotCount) Clear(c);
+  }
+
+  Slot* s = &c->slots[packet->seq % kSlotCount];
+  if (s->present) {
+    // Duplicate
+    if (s->seq == packet->seq) return;
+
+    stats_.dropped.Inc();
+    c->buffered--;
+  }
+
+  s->present = true;
+  s->seq = packet->seq;
+  s->len = packet->len;
+  memcpy(s->data, packet->data, packet->len);
+  c->buffered++;
+}
+
+
+void Playout::Clear(Channel* c) {
+  for (int i = 0; i < kSlotCount; i++) c->slots[i].present = false;
+  c->started = false;
+  c->next_seq = 0;
+  c->buffered = 0;
+  c->losses = 0;
+  c->since_stretch = 0;
+}
+
+
+bool Playout::Next(int index, Channel* c) {
+  if (!c->started) {
+    if (c->buffered < kPrebuffer) return false;
+
+    // Start talkspurt from the oldest packet
+    bool found = false;
+    for (int i = 0; i < kSlotCount; i++) {
+      Slot* s = &c->slots[i];
+      if (!s->present) continue;
+      if (!found || static_cast<int32_t>(s->seq - c->next_seq) < 0) {
+        c->next_seq = s->seq;
+        found = true;
+      }
+    }
+    c->started = true;
+    c->losses = 0;
+  }
+
+  // Queue has grown too much after a burst, skip packet to catch up
+  if (c->buffered > kMaxBuffered) {
+    Slot* s = &c->slots[c->next_seq % kSlotCount];
+    if (s->present && s->seq == c->next_seq) {
+      s->present = false;
+      c->buffered--;
+      stats_.dropped.Inc();
+    }
+    c->next_seq++;
+  }
+
+  Slot* s = &c->slots[c->next_seq % kSlotCount];
+  if (s->present && s->seq == c->next_seq) {
+    // Play faster if there is more than needed buffered (i.e. after burst),
+    // and slower if this is the last one, so the ring won't run dry
+    Stretch stretch = kNoStretch;
+    if (c->since_stretch >= kStretchInterval) {
+      if (c->buffered > kPrebuffer + 1) {
+        stretch = kCompress;
+      } else if (c->buffered == 1) {
+        stretch = kExpand;
+      }
+    }
+    c->since_stretch = stretch == kNoStretch ? c->since_stretch + 1 : 0;
+
+    int samples = Decode(index, s->data, s->len, false, max_samples_, stretch);
+    if (samples > 0) c->frame_samples = samples;
+
+    s->present = false;
+    c->buffered--;
+    c->losses = 0;
+  } else {
+    // Nothing is coming (i.e. remote side is muted), wait for next talkspurt
+    if (c->buffered == 0 && c->losses >= kMaxLosses) {
+      c->started = false;
+      return false;
+    }
+    c->losses++;
+
+    // Recover lost packet from the next one's FEC data if it's here already
+    Slot* n = &c->slots[(c->next_seq + 1) % kSlotCount];
+    if (n->present && n->seq == c->next_seq + 1) {
+      Decode(index, n->data, n->len, true, c->frame_samples, kNoStretch);
+      stats_.recovered.Inc();
+    } else {
+      Decode(index, NULL, 0, false, c->frame_samples, kNoStretch);
+      stats_.concealed.Inc();
+    }
+  }
+  c->next_seq++;
+
+  return true;
+}
+
+
+int Playout::Decode(int index,
+                    const unsigned char* data,
+                    int32_t len,
+                    bool fec,
+                    int max_samples,
+                    Stretch stretch) {
+  opus::Codec* codec = decoders_[index];
+
+  // Decode in place if ring has enough contiguous space
+  // (and samples won't be stretched)
+  char* region = stretch == kNoStretch ?
+      unit_->PutRegion(index, max_samples) : NULL;
+  char* out = region == NULL ? scratch_ : region;
+
+  int samples;
+  if (format_ == kFloat32Format) {
+    samples = codec->DecodeFloat(data,
+                                 len,
+                                 reinterpret_cast<float*>(out),
+                                 max_samples,
+                                 fec);
+  } else {
+    samples = codec->Decode(data,
+                            len,
+                            reinterpret_cast<opus_int16*>(out),
+                            max_samples,
+                            fec);
+  }
+  if (samples <= 0) return samples;
+
+  if (region != NULL) {
+    unit_->CommitPut(index, samples);
+  } else if (stretch == kNoStretch) {
+    unit_->Put(index, out, samples * sample_size_);
+  } else {
+    size_t size = samples;
+    out = StretchScratch(&size, stretch);
+    unit_->Put(index, out, size * sample_size_);
+  }
+
+  return samples;
+}
+
+
+char* Playout::StretchScratch(size_t* samples, Stretch stretch) {
+  float* in;
+  if (format_ == kFloat32Format) {
+    in = reinterpret_cast<float*>(scratch_);
+  } else {
+    in = stretch_in_;
+    Int16ToFloat(reinterpret_cast<int16_t*>(scratch_), in, *samples);
+  }
+
+  size_t size;
+  if (stretch == kCompress) {
+    size = stretch_.Compress(in, *samples, stretch_out_);
+  } else {
+    size = stretch_.Expand(in, *samples, stretch_out_);
+  }
+
+  // Frame wasn't periodic enough, play it as is
+  if (size == *samples) return scratch_;
+
+  if (stretch == kCompress) {
+    stats_.compressed.Inc();
+  } else {
+    stats_.expanded.Inc();
+  }
+  *samples = size;
+
+  if (format_ == kFloat32Format) return reinterpret_cast<char*>(stretch_out_);
+
+  FloatToInt16(stretch_out_, reinterpret_cast<int16_t*>(scratch_), size);
+  return scratch_;
+}
+
+} // namespace audio
+} // namespace vock
@@ -0,0 +1,144 @@
+#ifndef _SRC_AUDIO_PLAYOUT_H_
+#define _SRC_AUDIO_PLAYOUT_H_
+
+#include "unit.h"
+#include "format.h"
+#include "stats.h"
+#include "stretch.h"
+#include "opus/codec.h"
+#include "portaudio/pa_ringbuffer.h"
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace audio {
+
+// Pull-model playout: opus packets are queued from the event loop as soon
+// as they arrive, and the output thread takes them from per-channel native
+// jitter buffers, decoding (or concealing) exactly as much as the device
+// consumes. Timing doesn't depend on JS timers or GC pauses.
+class Playout {
+ public:
+  static const int kMaxPacketSize = 1500;
+
+  // NOTE: Should be powers of two
+  static const int kQueueSize = 256;
+  static const int kSlotCount = 16;
+
+  // Packets to collect before the start of a talkspurt
+  static const int kPrebuffer = 2;
+
+  // Concealed packets in a row after which the stream is considered paused
+  static const int kMaxLosses = 5;
+
+  // Buffered packets above which they're skipped rather than played faster
+  static const int kMaxBuffered = 8;
+
+  // Played packets between time-stretched ones, limits speed change
+  // to a few percent
+  static const int kStretchInterval = 4;
+
+  struct Stats {
+    Counter concealed;
+    Counter recovered;
+    Counter late;
+    Counter dropped;
+
+    // Packets played faster or slower
+    Counter compressed;
+    Counter expanded;
+  };
+
+  Playout(HALUnit* unit, double rate, SampleFormat format);
+  ~Playout();
+
+  // Event loop thread, return false if queue is full
+  bool Push(int index, uint32_t seq, const char* data, size_t len);
+  bool Reset(int index);
+
+  // Should be installed as HALUnit's pull callback
+  static void PullCallback(void* arg, size_t samples);
+
+  inline Stats* stats() { return &stats_; }
+
+ protected:
+  // Event loop -> output thread, `len` is -1 for resets
+  struct Packet {
+    int index;
+    uint32_t seq;
+    int32_t len;
+    unsigned char data[kMaxPacketSize];
+  };
+
+  struct Slot {
+    bool present;
+    uint32_t seq;
+    int32_t len;
+    unsigned char data[kMaxPacketSize];
+  };
+
+  // Output thread only
+  struct Channel {
+    bool active;
+    bool started;
+    uint32_t next_seq;
+    int buffered;
+    int losses;
+    int frame_samples;
+    int since_stretch;
+    Slot slots[kSlotCount];
+  };
+
+  enum Stretch {
+    kNoStretch,
+    kCompress,
+    kExpand
+  };
+
+  void Pull(size_t samples);
+  void Accept(Packet* packet);
+  void Clear(Channel* c);
+  bool Next(int index, Channel* c);
+
+  // Returns number of decoded samples or opus error code
+  int Decode(int index,
+             const unsigned char* data,
+             int32_t len,
+             bool fec,
+             int max_samples,
+             Stretch stretch);
+
+  // Time-stretches `samples` decoded samples in `scratch_`,
+  // returns pointer to the result and stores its size in `samples`
+  char* StretchScratch(size_t* samples, Stretch stretch);
+
+  HALUnit* unit_;
+  double rate_;
+  SampleFormat format_;
+  size_t sample_size_;
+
+  PaUtilRingBuffer queue_;
+  Packet* queue_buf_;
+  Channel* channels_;
+
+  // Created by event loop on the first packet of the channel,
+  // published to the output thread by the queue
+  opus::Codec* decoders_[HALUnit::kOutRingCount];
+
+  // 120 ms - the longest opus packet
+  int max_samples_;
+  char* scratch_;
+
+  // Output thread only, shared by all channels
+  TimeStretch stretch_;
+  float* stretch_in_;
+  float* stretch_out_;
+
+  Stats stats_;
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_PLAYOUT_H_
@@ -0,0 +1,72 @@
+#ifndef _SRC_AUDIO_STATS_H_
+#define _SRC_AUDIO_STATS_H_
+
+#include <stdint.h>
+
+namespace vock {
+namespace audio {
+
+// Lock-free counter, safe to bump from realtime threads.
+// Reads may happen concurrently from the event loop.
+class Counter {
+ public:
+  Counter() : value_(0) {
+  }
+
+  inline void Add(uint64_t delta) {
+    __sync_fetch_and_add(&value_, delta);
+  }
+
+  inline void Inc() {
+    Add(1);
+  }
+
+  inline uint64_t Get() {
+    // 64bit reads may tear on 32bit platforms
+    return __sync_add_and_fetch(&value_, 0);
+  }
+
+ protected:
+  volatile uint64_t value_;
+};
+
+// Histogram with fixed power-of-two buckets:
+// bucket `i` counts values in [2^i, 2^(i+1)), bucket 0 also holds zero.
+class Histogram {
+ public:
+  static const int kBucketCount = 40;
+
+  Histogram() : max_(0) {
+  }
+
+  inline void Record(uint64_t value) {
+    int bucket = value == 0 ? 0 : 63 - __builtin_clzll(value);
+    if (bucket >= kBucketCount) bucket = kBucketCount - 1;
+
+    buckets_[bucket].Inc();
+    count_.Inc();
+    sum_.Add(value);
+
+    uint64_t max = max_;
+    while (value > max) {
+      if (__sync_bool_compare_and_swap(&max_, max, value)) break;
+      max = max_;
+    }
+  }
+
+  inline uint64_t count() { return count_.Get(); }
+  inline uint64_t sum() { return sum_.Get(); }
+  inline uint64_t max() { return __sync_add_and_fetch(&max_, 0); }
+  inline uint64_t bucket(int i) { return buckets_[i].Get(); }
+
+ protected:
+  Counter count_;
+  Counter sum_;
+  volatile uint64_t max_;
+  Counter buckets_[kBucketCount];
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_STATS_H_
@@ -0,0 +1,151 @@
+#include "stretch.h"
+#include "dot.h"
+
+#include <string.h> // memcpy
+
+namespace vock {
+namespace audio {
+
+const float TimeStretch::kMinCorrelation = 0.85f;
+const float TimeStretch::kSilence = 1e-6f;
+
+TimeStretch::TimeStretch(double rate, size_t max_samples) {
+  decimation_ = static_cast<size_t>(rate / 8000);
+  if (decimation_ < 1) decimation_ = 1;
+
+  // Pitch of 66 - 400 Hz
+  min_lag_ = static_cast<size_t>(rate * 0.0025);
+  max_lag_ = static_cast<size_t>(rate * 0.015);
+
+  down_ = new float[max_samples / decimation_ + 1];
+  xcorr_ = new float[max_lag_ / decimation_ + 1];
+}
+
+
+TimeStretch::~TimeStretch() {
+  delete[] down_;
+  delete[] xcorr_;
+}
+
+
+size_t TimeStretch::Compress(const float* in, size_t count, float* out) {
+  size_t lag = FindPeriod(in, count);
+  if (lag == 0) {
+    memcpy(out, in, count * sizeof(*in));
+    return count;
+  }
+
+  // Starts as the first period and ends as the third one, skipping second
+  CrossFade(in, in + lag, lag, out);
+  memcpy(out + lag, in + 2 * lag, (count - 2 * lag) * sizeof(*in));
+
+  return count - lag;
+}
+
+
+size_t TimeStretch::Expand(const float* in, size_t count, float* out) {
+  size_t lag = FindPeriod(in, count);
+  if (lag == 0) {
+    memcpy(out, in, count * sizeof(*in));
+    return count;
+  }
+
+  // Inserted period continues the first one and leads into the second one
+  memcpy(out, in, lag * sizeof(*in));
+  CrossFade(in + lag, in, lag, out + lag);
+  memcpy(out + 2 * lag, in + lag, (count - lag) * sizeof(*in));
+
+  return count + lag;
+}
+
+
+size_t TimeStretch::FindPeriod(const float* in, size_t count) {
+  // Both periods should fit into the frame
+  size_t max_lag = max_lag_ < count / 2 ? max_lag_ : count / 2;
+  if (max_lag <= min_lag_) return 0;
+
+  size_t d = decimation_;
+  size_t n = count / d;
+  size_t lo = min_lag_ / d;
+  size_t hi = max_lag / d;
+  if (lo < 1) lo = 1;
+  if (hi <= lo) return 0;
+
+  // Average of `d` samples is a crude, but sufficient, lowpass
+  for (size_t i = 0; i < n; i++) {
+    float sum = 0;
+    for (size_t j = 0; j < d; j++) sum += in[i * d + j];
+    down_[i] = sum / d;
+  }
+
+  size_t window = n - hi;
+  Xcorr(down_, down_, xcorr_, window, hi + 1);
+
+  // Any period will do in silence, take the longest one
+  float energy = xcorr_[0];
+  if (energy < kSilence * window) return max_lag;
+
+  // Maximize xcorr / sqrt(energy * lag_energy) without square roots,
+  // energy of the lagged window is slid along
+  float lag_energy = energy;
+  size_t best = 0;
+  float best_num = 0;
+  float best_den = 1;
+  for (size_t i = 1; i <= hi; i++) {
+    lag_energy += down_[i + window - 1] * down_[i + window - 1] -
+                  down_[i - 1] * down_[i - 1];
+    if (i < lo || xcorr_[i] <= 0 || lag_energy <= 0) continue;
+
+    float num = xcorr_[i] * xcorr_[i];
+    if (best == 0 || num * best_den > best_num * lag_energy) {
+      best = i;
+      best_num = num;
+      best_den = lag_energy;
+    }
+  }
+  if (best == 0) return 0;
+
+  // Refine at full rate
+  window = count - max_lag;
+  size_t from = best * d > d ? best * d - d : 1;
+  size_t to = best * d + d;
+  if (from < min_lag_) from = min_lag_;
+  if (to > max_lag) to = max_lag;
+
+  float x_energy = InnerProd(in, in, window);
+  if (x_energy <= 0) return 0;
+
+  float best_corr = 0;
+  size_t lag = 0;
+  for (size_t i = from; i <= to; i++) {
+    float xy = InnerProd(in, in + i, window);
+    float yy = InnerProd(in + i, in + i, window);
+    if (xy <= 0 || yy <= 0) continue;
+
+    float corr = xy * xy / (x_energy * yy);
+    if (corr > best_corr) {
+      best_corr = corr;
+      lag = i;
+    }
+  }
+
+  // Squared correlation is compared
+  if (best_corr < kMinCorrelation * kMinCorrelation) return 0;
+
+  return lag;
+}
+
+
+void TimeStretch::CrossFade(const float* a,
+                            const float* b,
+                            size_t count,
+                            float* out) {
+  float step = 1.0f / (count + 1);
+  for (size_t i = 0; i < count; i++) {
+    float w = (i + 1) * step;
+    out[i] = a[i] + (b[i] - a[i]) * w;
+  }
+}
+
+} // namespace audio
+} // namespace vock
@@ -0,0 +1,55 @@
+#ifndef _SRC_AUDIO_STRETCH_H_
+#define _SRC_AUDIO_STRETCH_H_
+
+#include <stddef.h> // size_t
+
+namespace vock {
+namespace audio {
+
+// WSOLA-style time-scale modification of decoded speech: one pitch period,
+// found by normalized cross-correlation, is removed from or repeated in
+// a frame with an overlap-add crossfade. Duration changes, pitch doesn't.
+//
+// Coarse search runs on a decimated (~8kHz) signal and is refined at full
+// rate around the best lag, correlations are vectorized (see dot.h).
+class TimeStretch {
+ public:
+  // Frames that correlate weaker are left alone (unless they're silent)
+  static const float kMinCorrelation;
+
+  // Mean square below which frame is considered silent
+  static const float kSilence;
+
+  // Frames of up to `max_samples` samples at `rate`
+  TimeStretch(double rate, size_t max_samples);
+  ~TimeStretch();
+
+  // Shortens `count` samples of `in` by one period, returns the number
+  // of samples written to `out` (`count` if frame isn't periodic enough)
+  size_t Compress(const float* in, size_t count, float* out);
+
+  // Lengthens them by one period, `out` should fit `MaxOutput(count)`
+  size_t Expand(const float* in, size_t count, float* out);
+
+  inline size_t MaxOutput(size_t count) { return count + count / 2; }
+
+ protected:
+  // Returns the period in samples or 0
+  size_t FindPeriod(const float* in, size_t count);
+
+  // Linear fade from `a` to `b`
+  void CrossFade(const float* a, const float* b, size_t count, float* out);
+
+  size_t decimation_;
+  size_t min_lag_;
+  size_t max_lag_;
+
+  // Decimated frame and its correlations
+  float* down_;
+  float* xcorr_;
+};
+
+} // namespace audio
+} // namespace vock
+
+#endif // _SRC_AUDIO_STRETCH_H_
@@ -1,38 +1,72 @@
 #include "unit.h"
+#include "mix.h"
 #include "portaudio/pa_ringbuffer.h"
-#include "node.h"
-#include "node_buffer.h"
+#include "uv.h"
 
 #include <speex/speex_resampler.h>
 #include <speex/speex_echo.h>
 #include <speex/speex_preprocess.h>
 
+#include <stdio.h> // fprintf
 #include <string.h> // memset
 #include <stdlib.h> // abort
+#include <math.h> // sqrtf
 
 #ifndef MIN
 # define MIN(a, b) ((a) > (b) ? (b) : (a))
 #endif
 
+// Peak level of reference which is considered silence (about -72dBFS)
+static const int16_t kIdleLevel = 8;
+
+// Limit of the high band's gain (preprocessor's AGC may amplify low band)
+static const float kMaxHighGain = 8.0f;
+
+static int BandFactor(double rate, double cancel_rate) {
+  if (cancel_rate <= 0 || cancel_rate >= rate) return 1;
+  return static_cast<int>(rate / cancel_rate);
+}
+
 namespace vock {
 namespace audio {
 
-using node::Buffer;
-
 HALUnit::HALUnit(double rate,
                  size_t frame_size,
                  ssize_t latency,
+                 SampleFormat format,
+                 double cancel_rate,
                  uv_async_t* in_cb,
                  uv_async_t* inready_cb,
                  uv_async_t* outready_cb)
-    : frame_size_(frame_size),
-      in_unit_(PlatformUnit::kInputUnit, rate),
-      out_unit_(PlatformUnit::kOutputUnit, rate),
+    : format_(format),
+      sample_size_(SampleSize(format)),
+      frame_size_(frame_size),
+      in_unit_(PlatformUnit::kInputUnit, rate, format),
+      out_unit_(PlatformUnit::kOutputUnit, rate, format),
+      band_factor_(BandFactor(rate, cancel_rate)),
+      delay_(rate / band_factor_,
+             static_cast<size_t>(rate / band_factor_ * 0.4)),
+      echo_margin_(static_cast<ssize_t>(rate * 0.005)),
+      ref_shift_(0),
+      echo_tail_(static_cast<int>(rate / band_factor_) * 3 / 20),
+      ref_idle_(0),
       in_cb_(in_cb),
       inready_cb_(inready_cb),
       outready_cb_(outready_cb),
       inready_(false),
-      outready_(false) {
+      outready_(false),
+      capture_muted_(false),
+      preprocess_features_(kDefaultPreprocess),
+      preprocess_applied_(kDenoise),
+      handoff_start_(0),
+      pull_cb_(NULL),
+      pull_arg_(NULL) {
+  memset(out_playing_, 0, sizeof(out_playing_));
+  memset(out_muted_, 0, sizeof(out_muted_));
+  for (int i = 0; i < kOutRingCount; i++) {
+    out_gain_[i] = 1.0f;
+    out_volume_[i] = 1.0f;
+  }
 
   in_unit_.SetInputCallback(InputCallback, this);
   out_unit_.SetOutputCallback(OutputCallback, this);
@@ -41,43 +75,47 @@ HALUnit::HALUnit(double rate,
 
   // One ring for recorded data buffer
   r = PaUtil_InitializeRingBuffer(&cancel_ring_,
-                                  2,
-                                  sizeof(cancel_ring_buf_) / 2,
+                                  sample_size_,
+                                  sizeof(cancel_ring_buf_) / sample_size_,
                                   cancel_ring_buf_);
   if (r == -1) abort();
 
   // One ring for data after AEC
   r = PaUtil_InitializeRingBuffer(&in_ring_,
-                                  2,
-                                  sizeof(in_ring_buf_) / 2,
+                                  sample_size_,
+                                  sizeof(in_ring_buf_) / sample_size_,
                                   in_ring_buf_);
   if (r == -1) abort();
 
   // One ring for data to play
   for (int i = 0; i < kOutRingCount; i++) {
     r = PaUtil_InitializeRingBuffer(&out_rings_[i],
-                                    2,
-                                    sizeof(out_rings_buf_[i]) / 2,
+                                    sample_size_,
+                                    sizeof(out_rings_buf_[i]) / sample_size_,
                                     out_rings_buf_[i]);
     if (r == -1) abort();
   }
 
   // And one ring for data that was jus played
   r = PaUtil_InitializeRingBuffer(&used_ring_,
-                                  2,
-                                  sizeof(used_ring_buf_) / 2,
+                                  sample_size_,
+                                  sizeof(used_ring_buf_) / sample_size_,
                                   used_ring_buf_);
   if (r == -1) abort();
 
   size_t latency_size = latency > 0 ? latency : -latency;
-  int16_t* latency_data = new int16_t[latency_size / 2];
+  char* latency_data = new char[latency_size];
   memset(latency_data, 0, latency_size);
   if (latency > 0) {
     // Add latency to used buffer
-    PaUtil_WriteRingBuffer(&used_ring_, latency_data, latency_size / 2);
+    PaUtil_WriteRingBuffer(&used_ring_,
+                           latency_data,
+                           latency_size / sample_size_);
   } else if (latency < 0 ) {
     // Add latency to cancel buffer
-    PaUtil_WriteRingBuffer(&cancel_ring_, latency_data, latency_size / 2);
+    PaUtil_WriteRingBuffer(&cancel_ring_,
+                           latency_data,
+                           latency_size / sample_size_);
   }
   delete[] latency_data;
 
@@ -97,44 +135,76 @@ HALUnit::HALUnit(double rate,
     resampler_ = NULL;
   }
 
-  size_t sample_size = frame_size / 2;
+  // Mix is resampled once if output device runs at another rate
+  out_mix_pending_ = 0;
+  if (rate != out_unit_.GetOutputSampleRate()) {
+    int err;
+    out_resampler_ = speex_resampler_init(1,
+                                          rate,
+                                          out_unit_.GetOutputSampleRate(),
+                                          SPEEX_RESAMPLER_QUALITY_VOIP,
+                                          &err);
+    if (out_resampler_ == NULL) {
+      fprintf(stderr, "Failed to allocate output resampler!\n");
+      abort();
+    }
+  } else {
+    out_resampler_ = NULL;
+  }
+
+  size_t frame_samples = frame_size / sample_size_;
+
+  // Heap, not canceller's stack: threads get 512KB by default on OS X
+  rec16_ = new int16_t[frame_samples];
+  used16_ = new int16_t[frame_samples];
+  out16_ = new int16_t[frame_samples];
+
+  // Split off the low band (i.e. 16kHz of 48kHz) for the canceller
+  if (band_factor_ != 1) {
+    if (rate != band_factor_ * cancel_rate ||
+        frame_samples % band_factor_ != 0) {
+      fprintf(stderr, "Incorrect echo canceller's rate!\n");
+      abort();
+    }
+
+    rec_band_ = new BandSplit(band_factor_, frame_samples);
+    used_band_ = new BandSplit(band_factor_, frame_samples);
+    band_rec_ = new float[frame_samples];
+    band_used_ = new float[frame_samples];
+    band_low_ = new float[frame_samples / band_factor_];
+  } else {
+    rec_band_ = NULL;
+    used_band_ = NULL;
+    band_rec_ = NULL;
+    band_used_ = NULL;
+    band_low_ = NULL;
+  }
+  int cancel_samples = frame_samples / band_factor_;
+  int irate = rate / band_factor_;
 
-  // Init echo cancellation
-  canceller_ = speex_echo_state_init(sample_size, sample_size * 23);
+  // Init echo cancellation, tail is 150ms whatever the frame size is.
+  // Reference is aligned with echo (see Realign), so the filter
+  // only has to cover room's reverberation, not the device latency.
+  canceller_ = speex_echo_state_init(cancel_samples, echo_tail_);
   if (canceller_ == NULL) {
     fprintf(stderr, "Failed to allocate echo canceller!\n");
     abort();
   }
 
-  int irate = rate;
   if (speex_echo_ctl(canceller_, SPEEX_ECHO_SET_SAMPLING_RATE, &irate) != 0) {
     fprintf(stderr, "Failed to set echo canceller's rate!\n");
     abort();
   }
 
   // Init speex preprocessor
-  preprocess_ = speex_preprocess_state_init(sample_size, rate);
+  preprocess_ = speex_preprocess_state_init(cancel_samples, irate);
   if (preprocess_ == NULL) {
     fprintf(stderr, "Failed to allocate preprocessor!\n");
     abort();
   }
 
-  // Control AEC from preprocessor
-  if (speex_preprocess_ctl(preprocess_,
-                           SPEEX_PREPROCESS_SET_ECHO_STATE,
-                           canceller_) != 0) {
-    fprintf(stderr, "Failed to attach preprocessor to canceller!\n");
-    abort();
-  }
-
-  // AGC
-  int32_t enable = 1;
-  if (speex_preprocess_ctl(preprocess_,
-                           SPEEX_PREPROCESS_SET_AGC,
-                           &enable) != 0) {
-    fprintf(stderr, "Failed to enable AGC on preprocessor!\n");
-    abort();
-  }
+  // Fresh state has only denoise on (preprocess_applied_ says so)
+  ConfigurePreprocess(preprocess_features_);
 
 
   // Init semaphores
@@ -145,9 +215,29 @@ HALUnit::HALUnit(double rate,
 
 
 HALUnit::~HALUnit() {
+  // Device threads call into resamplers and rings, wait for them first
+  in_unit_.Close();
+  out_unit_.Close();
+
+  // Canceller thread uses resampler, speex states and bands
+  uv_sem_post(&canceller_terminate_);
+  uv_sem_post(&canceller_sem_);
+  uv_thread_join(&canceller_thread_);
+  uv_sem_destroy(&canceller_sem_);
+  uv_sem_destroy(&canceller_terminate_);
+
   if (resampler_ != NULL) speex_resampler_destroy(resampler_);
+  if (out_resampler_ != NULL) speex_resampler_destroy(out_resampler_);
   speex_echo_state_destroy(canceller_);
   speex_preprocess_state_destroy(preprocess_);
+  delete rec_band_;
+  delete used_band_;
+  delete[] band_rec_;
+  delete[] band_used_;
+  delete[] band_low_;
+  delete[] rec16_;
+  delete[] used16_;
+  delete[] out16_;
 
   PaUtil_FlushRingBuffer(&cancel_ring_);
   PaUtil_FlushRingBuffer(&in_ring_);
@@ -155,12 +245,6 @@ HALUnit::~HALUnit() {
     PaUtil_FlushRingBuffer(&out_rings_[i]);
   }
   PaUtil_FlushRingBuffer(&used_ring_);
-
-  uv_sem_post(&canceller_terminate_);
-  uv_sem_post(&canceller_sem_);
-  uv_thread_join(&canceller_thread_);
-  uv_sem_destroy(&canceller_sem_);
-  uv_sem_destroy(&canceller_terminate_);
 }
 
 
@@ -173,13 +257,31 @@ void HALUnit::InputCallback(void* arg, size_t bytes) {
     uv_async_send(unit->inready_cb_);
   }
 
-  // Get data from microphone
-  unit->in_unit_.Render(unit->mic_buff_,
-                        MIN(bytes, sizeof(unit->mic_buff_)));
+  unit->stats_.input_callback_size.Record(bytes);
+
+  // Get data from microphone straight into the ring
+  size_t samples = bytes / unit->sample_size_;
+  void* data1;
+  void* data2;
+  ring_buffer_size_t size1;
+  ring_buffer_size_t size2;
+  size_t writable = PaUtil_GetRingBufferWriteRegions(&unit->cancel_ring_,
+                                                     samples,
+                                                     &data1,
+                                                     &size1,
+                                                     &data2,
+                                                     &size2);
+  size_t holes = unit->in_unit_.Render(reinterpret_cast<char*>(data1),
+                                       size1 * unit->sample_size_,
+                                       reinterpret_cast<char*>(data2),
+                                       size2 * unit->sample_size_);
+  if (holes != 0) unit->stats_.capture_holes.Add(holes);
+
+  // Data is discarded until playback starts
   if (!unit->outready_) return;
 
-  // Put data to the ring
-  PaUtil_WriteRingBuffer(&unit->cancel_ring_, unit->mic_buff_, bytes / 2);
+  if (writable != samples) unit->stats_.capture_overruns.Inc();
+  PaUtil_AdvanceRingBufferWriteIndex(&unit->cancel_ring_, writable);
 
   // Send semaphore signal to canceller thread
   uv_sem_post(&unit->canceller_sem_);
@@ -195,41 +297,184 @@ void HALUnit::OutputCallback(void* arg, char* out, size_t size) {
     uv_async_send(unit->outready_cb_);
   }
 
+  unit->ApplyOutputCommands();
+
   // Zero out buffer
   memset(out, 0, size);
 
+  unit->stats_.output_callback_size.Record(size);
+
   if (!unit->inready_) return;
 
-  char tmp[10 * 1024];
+  size_t samples = size / unit->sample_size_;
+  if (unit->out_resampler_ == NULL) {
+    unit->Mix(out, samples);
+  } else {
+    unit->MixResampled(out, samples);
+  }
+
+  // Send semaphore signal to canceller thread
+  uv_sem_post(&unit->canceller_sem_);
+}
+
+
+void HALUnit::Mix(char* out, size_t samples) {
+  char tmp[kMixBufferSize];
+
+  if (pull_cb_ != NULL) pull_cb_(pull_arg_, samples);
+
   for (int i = 0; i < kOutRingCount; i++) {
-    size_t available = PaUtil_GetRingBufferReadAvailable(&unit->out_rings_[i]);
+    size_t available = PaUtil_GetRingBufferReadAvailable(&out_rings_[i]);
+
+    if (available > samples) available = samples;
+
+    // Count each gap in a playing channel once
+    if (available < samples && out_playing_[i]) {
+      stats_.out_underruns[i].Inc();
+    }
+    out_playing_[i] = available == samples;
+
+    size_t read = PaUtil_ReadRingBuffer(&out_rings_[i], tmp, available);
 
-    if (available * 2 > size) available = size / 2;
+    // Ramp gain towards channel's volume during this callback
+    float gain = out_gain_[i];
+    float target = out_muted_[i] ? 0.0f : out_volume_[i];
+    float step = (target - gain) / samples;
+    out_gain_[i] = target;
 
-    size_t read = PaUtil_ReadRingBuffer(&unit->out_rings_[i], tmp, available);
+    // Silence (or silenced) channel adds nothing
+    if (read == 0 || (gain == 0.0f && target == 0.0f)) continue;
 
     // Fill rest with zeroes
-    if (size > read * 2) {
-      memset(tmp + read * 2, 0, size - read * 2);
+    if (samples > read) {
+      memset(tmp + read * sample_size_,
+             0,
+             (samples - read) * sample_size_);
     }
 
     // Mix-in into out buffer
-    int16_t* a = reinterpret_cast<int16_t*>(out);
-    int16_t* b = reinterpret_cast<int16_t*>(tmp);
-    for (size_t j = 0; j < size / 2; j++) {
-      if ((a[j] > 0 && b[j] > 0) || (a[j] < 0 && b[j] < 0)) {
-        a[j] = a[j] + b[j] - (a[j] * b[j]) / 32767;
+    if (format_ == kFloat32Format) {
+      if (gain == 1.0f && step == 0.0f) {
+        MixFloat(reinterpret_cast<float*>(out),
+                 reinterpret_cast<float*>(tmp),
+                 samples);
+      } else {
+        MixFloatGain(reinterpret_cast<float*>(out),
+                     reinterpret_cast<float*>(tmp),
+                     samples,
+                     gain,
+                     step);
+      }
+    } else {
+      if (gain == 1.0f && step == 0.0f) {
+        MixInt16(reinterpret_cast<int16_t*>(out),
+                 reinterpret_cast<int16_t*>(tmp),
+                 samples);
       } else {
-        a[j] = a[j] + b[j];
+        MixInt16Gain(reinterpret_cast<int16_t*>(out),
+                     reinterpret_cast<int16_t*>(tmp),
+                     samples,
+                     gain,
+                     step);
       }
     }
   }
 
+  if (format_ == kFloat32Format) {
+    ClipFloat(reinterpret_cast<float*>(out), samples);
+  }
+
   // Put data to the `used` ring
-  PaUtil_WriteRingBuffer(&unit->used_ring_, out, size / 2);
+  size_t written = PaUtil_WriteRingBuffer(&used_ring_, out, samples);
+  if (written != samples) stats_.used_overruns.Inc();
+}
 
-  // Send semaphore signal to canceller thread
-  uv_sem_post(&unit->canceller_sem_);
+
+void HALUnit::MixResampled(char* out, size_t samples) {
+  uint32_t num;
+  uint32_t denum;
+  speex_resampler_get_ratio(out_resampler_, &num, &denum);
+
+  size_t capacity = sizeof(out_mix_buff_) / sample_size_;
+  size_t produced = 0;
+  while (produced < samples) {
+    size_t wanted = samples - produced;
+
+    // Session rate samples needed for the rest of the callback
+    size_t needed = (wanted * num + denum - 1) / denum;
+    if (needed > capacity) needed = capacity;
+    if (needed > out_mix_pending_) {
+      char* mix = out_mix_buff_ + out_mix_pending_ * sample_size_;
+      memset(mix, 0, (needed - out_mix_pending_) * sample_size_);
+      Mix(mix, needed - out_mix_pending_);
+      out_mix_pending_ = needed;
+    }
+
+    spx_uint32_t in_samples = out_mix_pending_;
+    spx_uint32_t out_samples = wanted;
+    char* dst = out + produced * sample_size_;
+
+    uint64_t start = uv_hrtime();
+    int r;
+    if (format_ == kFloat32Format) {
+      r = speex_resampler_process_float(
+          out_resampler_,
+          0,
+          reinterpret_cast<float*>(out_mix_buff_),
+          &in_samples,
+          reinterpret_cast<float*>(dst),
+          &out_samples);
+    } else {
+      r = speex_resampler_process_int(
+          out_resampler_,
+          0,
+          reinterpret_cast<spx_int16_t*>(out_mix_buff_),
+          &in_samples,
+          reinterpret_cast<spx_int16_t*>(dst),
+          &out_samples);
+    }
+    stats_.resample_time.Record(uv_hrtime() - start);
+    if (r) abort();
+
+    // Keep what wasn't consumed for the next round
+    out_mix_pending_ -= in_samples;
+    memmove(out_mix_buff_,
+            out_mix_buff_ + in_samples * sample_size_,
+            out_mix_pending_ * sample_size_);
+
+    // Rest of the callback stays silent (it's zeroed already)
+    if (out_samples == 0) break;
+    produced += out_samples;
+  }
+}
+
+
+void HALUnit::ApplyOutputCommands() {
+  Command cmd;
+
+  while (out_control_.Pop(&cmd)) {
+    switch (cmd.type) {
+     case Command::kResetChannel:
+      // Only consumer may move read index
+      PaUtil_AdvanceRingBufferReadIndex(
+          &out_rings_[cmd.index],
+          PaUtil_GetRingBufferReadAvailable(&out_rings_[cmd.index]));
+      out_playing_[cmd.index] = false;
+
+      // Channel is reused by another peer
+      out_volume_[cmd.index] = 1.0f;
+      out_muted_[cmd.index] = false;
+      break;
+     case Command::kSetGain:
+      out_volume_[cmd.index] = cmd.value;
+      break;
+     case Command::kSetMute:
+      out_muted_[cmd.index] = cmd.value != 0;
+      break;
+     default:
+      break;
+    }
+  }
 }
 
 
@@ -247,16 +492,22 @@ bool HALUnit::EchoCancelLoop() {
   char rec[100 * 1024];
   char used[100 * 1024];
 
+  int16_t* rec16 = rec16_;
+  int16_t* used16 = used16_;
+  int16_t* out16 = out16_;
+
   uv_sem_wait(&canceller_sem_);
   if (uv_sem_trywait(&canceller_terminate_) == 0) return false;
 
+  size_t frame_samples = frame_size_ / sample_size_;
+  size_t cancel_samples = frame_samples / band_factor_;
+
   // Read as much frames as possible from input
   for (;;) {
     size_t in_avail = PaUtil_GetRingBufferReadAvailable(&cancel_ring_);
     size_t out_avail = PaUtil_GetRingBufferReadAvailable(&used_ring_);
 
-    size_t in_needed = frame_size_ / 2;
-    size_t out_needed = MIN(out_avail, frame_size_ / 2);
+    size_t in_needed = frame_samples;
 
     // buffer will change size after resampling,
     // take this into account
@@ -270,6 +521,8 @@ bool HALUnit::EchoCancelLoop() {
     // Skip if we don't have enough data yet
     if (in_needed > in_avail) break;
 
+    uint64_t start = uv_hrtime();
+
     // Read mic buffer
     size_t read;
     if (resampler_ == NULL) {
@@ -279,13 +532,35 @@ bool HALUnit::EchoCancelLoop() {
     }
     if (read != in_needed) abort();
 
+    // Realign reference: skip some of it...
+    if (ref_shift_ < 0) {
+      size_t skip = MIN(static_cast<size_t>(-ref_shift_), out_avail);
+      PaUtil_AdvanceRingBufferReadIndex(&used_ring_, skip);
+      ref_shift_ += skip;
+      out_avail -= skip;
+    }
+
+    // ...or delay it with silence
+    size_t pad = 0;
+    if (ref_shift_ > 0) {
+      pad = MIN(static_cast<size_t>(ref_shift_), frame_samples);
+      ref_shift_ -= pad;
+      memset(used, 0, pad * sample_size_);
+    }
+
     // Read used buffer
-    read = PaUtil_ReadRingBuffer(&used_ring_, used, out_needed);
+    size_t out_needed = MIN(out_avail, frame_samples - pad);
+    read = PaUtil_ReadRingBuffer(&used_ring_,
+                                 used + pad * sample_size_,
+                                 out_needed);
     if (read != out_needed) abort();
+    read += pad;
 
     // Fill rest with zeroes
-    if (read < frame_size_ / 2) {
-      memset(used + read * 2, 0, frame_size_ - 2 * read);
+    if (read < frame_samples) {
+      memset(used + read * sample_size_,
+             0,
+             (frame_samples - read) * sample_size_);
     }
 
     // Resample input
@@ -296,32 +571,130 @@ bool HALUnit::EchoCancelLoop() {
 
       // Get size in samples
       tmp_samples = in_needed;
-      out_samples = frame_size_ / 2;
+      out_samples = frame_samples;
+
+      uint64_t resample_start = uv_hrtime();
 
       // Resample!
-      r = speex_resampler_process_int(
-          resampler_,
-          0,
-          reinterpret_cast<spx_int16_t*>(tmp),
-          &tmp_samples,
-          reinterpret_cast<spx_int16_t*>(rec),
-          &out_samples);
+      if (format_ == kFloat32Format) {
+        r = speex_resampler_process_float(
+            resampler_,
+            0,
+            reinterpret_cast<float*>(tmp),
+            &tmp_samples,
+            reinterpret_cast<float*>(rec),
+            &out_samples);
+      } else {
+        r = speex_resampler_process_int(
+            resampler_,
+            0,
+            reinterpret_cast<spx_int16_t*>(tmp),
+            &tmp_samples,
+            reinterpret_cast<spx_int16_t*>(rec),
+            &out_samples);
+      }
       if (r) abort();
+
+      stats_.resample_time.Record(uv_hrtime() - resample_start);
     }
 
+    spx_int16_t* rec_in;
+    spx_int16_t* used_in;
+    spx_int16_t* out;
+    if (rec_band_ != NULL) {
+      const float* recf = reinterpret_cast<float*>(rec);
+      const float* usedf = reinterpret_cast<float*>(used);
+      if (format_ == kInt16Format) {
+        Int16ToFloat(reinterpret_cast<int16_t*>(rec),
+                     band_rec_,
+                     frame_samples);
+        Int16ToFloat(reinterpret_cast<int16_t*>(used),
+                     band_used_,
+                     frame_samples);
+        recf = band_rec_;
+        usedf = band_used_;
+      }
+
+      FloatToInt16(rec_band_->Split(recf, frame_samples),
+                   rec16,
+                   cancel_samples);
+      FloatToInt16(used_band_->Split(usedf, frame_samples),
+                   used16,
+                   cancel_samples);
+      rec_in = rec16;
+      used_in = used16;
+      out = out16;
+    } else if (format_ == kFloat32Format) {
+      FloatToInt16(reinterpret_cast<float*>(rec), rec16, frame_samples);
+      FloatToInt16(reinterpret_cast<float*>(used), used16, frame_samples);
+      rec_in = rec16;
+      used_in = used16;
+      out = out16;
+    } else {
+      rec_in = reinterpret_cast<spx_int16_t*>(rec);
+      used_in = reinterpret_cast<spx_int16_t*>(used);
+      out = reinterpret_cast<spx_int16_t*>(tmp);
+    }
+
+    // Nothing was played for the whole filter tail: its history is all
+    // zeroes and it would subtract nothing, while weights (the echo path)
+    // stay valid for the time the remote side starts talking again
+    bool idle = true;
+    for (size_t i = 0; i < cancel_samples; i++) {
+      if (used_in[i] > kIdleLevel || used_in[i] < -kIdleLevel) {
+        idle = false;
+        break;
+      }
+    }
+    ref_idle_ = idle ? ref_idle_ + cancel_samples : 0;
+
     // Cancel echo
-    speex_echo_cancellation(canceller_,
-                            reinterpret_cast<spx_int16_t*>(rec),
-                            reinterpret_cast<spx_int16_t*>(used),
-                            reinterpret_cast<spx_int16_t*>(tmp));
+    if (ref_idle_ > echo_tail_) {
+      memcpy(out, rec_in, cancel_samples * sizeof(*out));
+      stats_.cancel_bypassed.Inc();
+    } else {
+      speex_echo_cancellation(canceller_, rec_in, used_in, out);
+    }
+
+    int features = preprocess_features_;
+    if (features != preprocess_applied_) ConfigurePreprocess(features);
+
+    // Apply preprocessor, or only update its noise estimate
+    // if nobody is going to hear the output
+    if (capture_muted_) {
+      if (features != 0) speex_preprocess_estimate_update(preprocess_, out);
+      memset(out, 0, cancel_samples * sizeof(*out));
+      stats_.preprocess_bypassed.Inc();
+    } else if (features == 0) {
+      stats_.preprocess_bypassed.Inc();
+    } else {
+      uint64_t preprocess_start = uv_hrtime();
+      if (speex_preprocess_run(preprocess_, out) == 0) stats_.vad_silent.Inc();
+      stats_.preprocess_time.Record(uv_hrtime() - preprocess_start);
+    }
 
-    // Apply preprocessor
-    speex_preprocess_run(preprocess_, reinterpret_cast<spx_int16_t*>(tmp));
+    if (rec_band_ != NULL) {
+      MergeBands(rec_in, out, cancel_samples, tmp);
+    } else if (format_ == kFloat32Format) {
+      Int16ToFloat(out16, reinterpret_cast<float*>(tmp), frame_samples);
+    }
+
+    delay_.Update(rec_in, used_in, cancel_samples);
+
+    // Follow changes of echo path delay
+    ssize_t delay;
+    if (delay_.Estimate(&delay)) Realign(delay * band_factor_);
 
     // Put resampled and cancelled frame into in_ring
-    PaUtil_WriteRingBuffer(&in_ring_, tmp, frame_size_ / 2);
+    size_t written = PaUtil_WriteRingBuffer(&in_ring_, tmp, frame_samples);
+    if (written != frame_samples) stats_.input_overruns.Inc();
 
-    // Send message to event-loop's thread
+    uint64_t end = uv_hrtime();
+    stats_.cancel_time.Record(end - start);
+
+    // Send message to event-loop's thread,
+    // uv_async_send() coalesces so only the first send is timed
+    __sync_bool_compare_and_swap(&handoff_start_, 0, end);
     uv_async_send(in_cb_);
   }
 
@@ -329,6 +702,86 @@ bool HALUnit::EchoCancelLoop() {
 }
 
 
+void HALUnit::MergeBands(const int16_t* in,
+                         const int16_t* out,
+                         size_t samples,
+                         char* dst) {
+  // Suppression (and AGC) gain low band got from canceller and
+  // preprocessor is applied to the high band
+  float in_energy = 0;
+  float out_energy = 0;
+  for (size_t i = 0; i < samples; i++) {
+    in_energy += static_cast<float>(in[i]) * in[i];
+    out_energy += static_cast<float>(out[i]) * out[i];
+  }
+  float gain = in_energy > 0 ? sqrtf(out_energy / in_energy) : 0;
+  if (gain > kMaxHighGain) gain = kMaxHighGain;
+
+  Int16ToFloat(out, band_low_, samples);
+  if (format_ == kFloat32Format) {
+    rec_band_->Merge(band_low_, gain, reinterpret_cast<float*>(dst));
+  } else {
+    rec_band_->Merge(band_low_, gain, band_rec_);
+    FloatToInt16(band_rec_,
+                 reinterpret_cast<int16_t*>(dst),
+                 samples * band_factor_);
+  }
+}
+
+
+void HALUnit::ConfigurePreprocess(int features) {
+  static const struct {
+    int feature;
+    int request;
+  } switches[] = {
+    { kDenoise, SPEEX_PREPROCESS_SET_DENOISE },
+    { kAgc, SPEEX_PREPROCESS_SET_AGC },
+    { kVad, SPEEX_PREPROCESS_SET_VAD },
+    { kDereverb, SPEEX_PREPROCESS_SET_DEREVERB }
+  };
+
+  // Only switches that change: setting VAD makes speex print a warning
+  int changed = features ^ preprocess_applied_;
+  for (size_t i = 0; i < sizeof(switches) / sizeof(switches[0]); i++) {
+    if ((changed & switches[i].feature) == 0) continue;
+
+    int32_t enable = (features & switches[i].feature) != 0;
+    if (speex_preprocess_ctl(preprocess_,
+                             switches[i].request,
+                             &enable) != 0) {
+      fprintf(stderr, "Failed to configure preprocessor!\n");
+      abort();
+    }
+  }
+
+  // Residual echo suppression, preprocessor reads canceller's estimate
+  void* echo = (features & kEchoSuppress) != 0 ? canceller_ : NULL;
+  if ((changed & kEchoSuppress) != 0 &&
+      speex_preprocess_ctl(preprocess_,
+                           SPEEX_PREPROCESS_SET_ECHO_STATE,
+                           echo) != 0) {
+    fprintf(stderr, "Failed to attach preprocessor to canceller!\n");
+    abort();
+  }
+
+  preprocess_applied_ = features;
+}
+
+
+void HALUnit::Realign(ssize_t delay) {
+  // Echo is slightly after the reference already
+  ssize_t shift = delay - echo_margin_;
+  if (shift > -echo_margin_ && shift < echo_margin_) return;
+
+  ref_shift_ += shift;
+  delay_.Reset();
+
+  // Filter was adapted to the old alignment
+  speex_echo_state_reset(canceller_);
+  stats_.echo_realigns.Inc();
+}
+
+
 void HALUnit::Start() {
   inready_ = false;
   outready_ = false;
@@ -344,18 +797,18 @@ void HALUnit::Stop() {
 }
 
 
-Buffer* HALUnit::Read(size_t size) {
-  Buffer* result = NULL;
+size_t HALUnit::GetReadSize() {
+  return PaUtil_GetRingBufferReadAvailable(&in_ring_) * sample_size_;
+}
 
-  // Not enough data in ring
-  size_t available = PaUtil_GetRingBufferReadAvailable(&in_ring_);
-  if (available * 2 < size) return result;
 
-  result = Buffer::New(size);
+bool HALUnit::Read(char* out, size_t size) {
+  // Not enough data in ring
+  if (GetReadSize() < size) return false;
 
-  PaUtil_ReadRingBuffer(&in_ring_, Buffer::Data(result), size / 2);
+  PaUtil_ReadRingBuffer(&in_ring_, out, size / sample_size_);
 
-  return result;
+  return true;
 }
 
 
@@ -364,7 +817,95 @@ void HALUnit::Put(int index, char* data, size_t size) {
     fprintf(stderr, "Incorrect HALUnit out ring index: %d\n", index);
     abort();
   }
-  PaUtil_WriteRingBuffer(&out_rings_[index], data, size / 2);
+  size_t samples = size / sample_size_;
+  size_t written = PaUtil_WriteRingBuffer(&out_rings_[index], data, samples);
+  if (written != samples) stats_.out_overruns[index].Inc();
+}
+
+
+char* HALUnit::PutRegion(int index, size_t samples) {
+  if (index >= kOutRingCount || index < 0) {
+    fprintf(stderr, "Incorrect HALUnit out ring index: %d\n", index);
+    abort();
+  }
+
+  void* data1;
+  void* data2;
+  ring_buffer_size_t size1;
+  ring_buffer_size_t size2;
+  PaUtil_GetRingBufferWriteRegions(&out_rings_[index],
+                                   samples,
+                                   &data1,
+                                   &size1,
+                                   &data2,
+                                   &size2);
+  if (static_cast<size_t>(size1) < samples) return NULL;
+
+  return reinterpret_cast<char*>(data1);
+}
+
+
+void HALUnit::CommitPut(int index, size_t samples) {
+  PaUtil_AdvanceRingBufferWriteIndex(&out_rings_[index], samples);
+}
+
+
+size_t HALUnit::GetQueued(int index) {
+  return PaUtil_GetRingBufferReadAvailable(&out_rings_[index]);
+}
+
+
+void HALUnit::SetPullSource(PullFn fn, void* arg) {
+  pull_cb_ = fn;
+  pull_arg_ = arg;
+}
+
+
+bool HALUnit::ResetChannel(int index) {
+  if (index >= kOutRingCount || index < 0) {
+    fprintf(stderr, "Incorrect HALUnit out ring index: %d\n", index);
+    abort();
+  }
+
+  return out_control_.Push(Command::kResetChannel, index);
+}
+
+
+bool HALUnit::SetGain(int index, float gain) {
+  if (index >= kOutRingCount || index < 0) {
+    fprintf(stderr, "Incorrect HALUnit out ring index: %d\n", index);
+    abort();
+  }
+
+  return out_control_.Push(Command::kSetGain, index, gain);
+}
+
+
+bool HALUnit::SetMute(int index, bool muted) {
+  if (index >= kOutRingCount || index < 0) {
+    fprintf(stderr, "Incorrect HALUnit out ring index: %d\n", index);
+    abort();
+  }
+
+  return out_control_.Push(Command::kSetMute, index, muted ? 1 : 0);
+}
+
+
+void HALUnit::SetCaptureMute(bool muted) {
+  capture_muted_ = muted;
+}
+
+
+void HALUnit::SetPreprocess(int features) {
+  preprocess_features_ = features;
+}
+
+
+void HALUnit::RecordHandoff() {
+  uint64_t start = __sync_lock_test_and_set(&handoff_start_, 0);
+  if (start == 0) return;
+
+  stats_.handoff_time.Record(uv_hrtime() - start);
 }
 
 } // namespace audio
@@ -1,15 +1,21 @@
 #ifndef _SRC_AUDIO_UNIT_H_
 #define _SRC_AUDIO_UNIT_H_
 
-#include "node.h"
-#include "node_buffer.h"
+#include "uv.h"
 
-#ifdef __PLATFORM_MAC__
+#ifdef __PLATFORM_NULL__
+#include "platform/null.h"
+#elif __PLATFORM_MAC__
 #include "platform/mac.h"
 #elif __PLATFORM_LINUX__
 #include "platform/linux.h"
 #endif
 #include "portaudio/pa_ringbuffer.h"
+#include "format.h"
+#include "stats.h"
+#include "control.h"
+#include "delay.h"
+#include "band.h"
 
 #include <speex/speex_resampler.h>
 #include <speex/speex_echo.h>
@@ -20,9 +26,69 @@ namespace audio {
 
 class HALUnit {
  public:
+  static const int kOutRingCount = 64;
+
+  // Preprocessor's features, they share one spectral analysis, so it's
+  // skipped only if all of them are off. Dereverb has no effect with the
+  // bundled speex (its reverberation estimate isn't updated)
+  enum PreprocessFeature {
+    kDenoise = 1,
+    kAgc = 2,
+    kVad = 4,
+    kDereverb = 8,
+    kEchoSuppress = 16
+  };
+  static const int kDefaultPreprocess = kDenoise | kAgc | kEchoSuppress;
+
+  // Invoked by the output thread before mixing `samples` samples,
+  // may fill out rings (see Playout)
+  typedef void (*PullFn)(void* arg, size_t samples);
+
+  // Always-on counters, updated from device and canceller threads
+  struct Stats {
+    // Writes that didn't fit into a ring (samples were dropped)
+    Counter capture_overruns;
+    Counter input_overruns;
+    Counter used_overruns;
+    Counter out_overruns[kOutRingCount];
+
+    // Playing channel didn't have a full callback worth of samples
+    Counter out_underruns[kOutRingCount];
+
+    // Bytes of captured data lost by the device (zero filled)
+    Counter capture_holes;
+
+    // Echo canceller's reference was shifted to the estimated delay
+    Counter echo_realigns;
+
+    // Frames that skipped echo cancellation (nothing was played for
+    // the whole filter tail) or preprocessing (microphone is muted)
+    Counter cancel_bypassed;
+    Counter preprocess_bypassed;
+
+    // Frames VAD considered silent (if it's enabled)
+    Counter vad_silent;
+
+    // Nanoseconds
+    Histogram cancel_time;
+    Histogram preprocess_time;
+    Histogram resample_time;
+    Histogram handoff_time;
+
+    // Bytes
+    Histogram input_callback_size;
+    Histogram output_callback_size;
+  };
+
+  // `frame_size` (in bytes) is the echo canceller's and preprocessor's
+  // frame, recorded data can be read in chunks of any size.
+  // They run on the low band at `cancel_rate` if it's below `rate`
+  // (which should be its multiple, as well as frame's samples).
   HALUnit(double rate,
           size_t frame_size,
           ssize_t latency,
+          SampleFormat format,
+          double cancel_rate,
           uv_async_t* in_cb,
           uv_async_t* inready_cb,
           uv_async_t* outready_cb);
@@ -32,18 +98,77 @@ class HALUnit {
   void Stop();
 
   size_t GetReadSize();
-  node::Buffer* Read(size_t size);
+  bool Read(char* out, size_t size);
   void Put(int index, char* data, size_t size);
 
+  // Zero-copy form of Put(): returns contiguous space for `samples`
+  // samples in index'th out ring (NULL if it's full or wraps there),
+  // which becomes playable after CommitPut() with the number written
+  char* PutRegion(int index, size_t samples);
+  void CommitPut(int index, size_t samples);
+
+  // Samples queued in index'th out ring
+  size_t GetQueued(int index);
+
+  // Should be called before Start()
+  void SetPullSource(PullFn fn, void* arg);
+
+  // Drops samples queued in index'th out ring, applied by the output
+  // thread on its next callback. Returns false if control queue is full
+  bool ResetChannel(int index);
+
+  // Channel's volume, changes are ramped over one output callback
+  bool SetGain(int index, float gain);
+  bool SetMute(int index, bool muted);
+
+  // Muted capture is read as silence, preprocessor only keeps
+  // its noise estimate up to date meanwhile
+  void SetCaptureMute(bool muted);
+
+  // Mask of PreprocessFeature, applied by canceller thread on next frame
+  void SetPreprocess(int features);
+
+  // Should be called by the in_cb's handler on the event loop
+  void RecordHandoff();
+
+  inline Stats* stats() { return &stats_; }
+
+  // For benchmarks
+  inline PlatformUnit* input_unit() { return &in_unit_; }
+  inline PlatformUnit* output_unit() { return &out_unit_; }
+  inline uv_thread_t* canceller_thread() { return &canceller_thread_; }
+
  protected:
-  static const int kOutRingCount = 64;
   static const int kRingBufferSize = 64 * 1024;
+  static const int kMixBufferSize = 10 * 1024;
 
   static void InputCallback(void* arg, size_t bytes);
   static void OutputCallback(void* arg, char* out, size_t bytes);
+  void ApplyOutputCommands();
+
+  // Mixes channels into (zeroed) `out` at session rate,
+  // mix is also the echo canceller's reference
+  void Mix(char* out, size_t samples);
+
+  // Same, for output device running at another rate
+  void MixResampled(char* out, size_t samples);
   static void EchoCancelLoop(void* arg);
   bool EchoCancelLoop();
 
+  // Shifts the reference so echo comes `echo_margin_` samples after it
+  void Realign(ssize_t delay);
+
+  // Canceller thread (or constructor) only
+  void ConfigurePreprocess(int features);
+
+  // Puts processed low band `out` back into the full band frame
+  void MergeBands(const int16_t* in,
+                  const int16_t* out,
+                  size_t samples,
+                  char* dst);
+
+  SampleFormat format_;
+  size_t sample_size_;
   size_t frame_size_;
 
   // Echo canceller thread
@@ -55,6 +180,7 @@ class HALUnit {
   PlatformUnit out_unit_;
 
   SpeexResamplerState* resampler_;
+  SpeexResamplerState* out_resampler_;
   SpeexEchoState* canceller_;
   SpeexPreprocessState* preprocess_;
 
@@ -63,20 +189,71 @@ class HALUnit {
   PaUtilRingBuffer out_rings_[kOutRingCount];
   PaUtilRingBuffer used_ring_;
 
+  // Canceller thread only: 16bit copies for AEC and preprocessor
+  // (in float mode or on the low band), `frame_samples` each
+  int16_t* rec16_;
+  int16_t* used16_;
+  int16_t* out16_;
+
+  // Canceller thread only: captured and reference signals are split
+  // into bands if `band_factor_` isn't 1, high band gets the gain low
+  // band got from canceller and preprocessor (see BandSplit)
+  int band_factor_;
+  BandSplit* rec_band_;
+  BandSplit* used_band_;
+  float* band_rec_;
+  float* band_used_;
+  float* band_low_;
+
+  // Canceller thread only: `latency` is just an initial guess,
+  // reference is realigned to the measured echo path delay.
+  // Positive shift is silence to insert before the reference,
+  // negative - samples of it to skip.
+  DelayEstimator delay_;
+  ssize_t echo_margin_;
+  ssize_t ref_shift_;
+
+  // Canceller thread only, samples of silent reference in a row
+  size_t echo_tail_;
+  size_t ref_idle_;
+
   // NOTE: Should be a power of two
+  // (in float mode rings hold half as many samples)
   int16_t cancel_ring_buf_[kRingBufferSize];
   int16_t in_ring_buf_[kRingBufferSize];
   int16_t out_rings_buf_[kOutRingCount][kRingBufferSize];
   int16_t used_ring_buf_[kRingBufferSize];
 
-  // buffer for Render function
-  char mic_buff_[10 * 1024];
-
   uv_async_t* in_cb_;
   uv_async_t* inready_cb_;
   uv_async_t* outready_cb_;
   volatile bool inready_;
   volatile bool outready_;
+  volatile bool capture_muted_;
+  volatile int preprocess_features_;
+  int preprocess_applied_;
+
+  Stats stats_;
+
+  // Time of the first uv_async_send() not yet seen by event loop
+  volatile uint64_t handoff_start_;
+
+  // Event loop -> output thread
+  ControlQueue out_control_;
+
+  PullFn pull_cb_;
+  void* pull_arg_;
+
+  // Output thread only
+  bool out_playing_[kOutRingCount];
+  float out_gain_[kOutRingCount];
+
+  // Mixed samples not consumed by output resampler yet
+  char out_mix_buff_[kMixBufferSize];
+  size_t out_mix_pending_;
+
+  float out_volume_[kOutRingCount];
+  bool out_muted_[kOutRingCount];
 };
 
 } // namespace audio
@@ -0,0 +1,160 @@
+#include "aead.h"
+#include "frame.h"
+
+#include <openssl/evp.h>
+#include <string.h> // memset, memcpy
+
+namespace vock {
+namespace frame {
+
+Aead::Aead() : seal_ctx_(NULL), open_ctx_(NULL) {
+}
+
+
+Aead::~Aead() {
+  if (seal_ctx_ != NULL) EVP_CIPHER_CTX_free(seal_ctx_);
+  if (open_ctx_ != NULL) EVP_CIPHER_CTX_free(open_ctx_);
+}
+
+
+bool Aead::Init(const unsigned char* tx_key, const unsigned char* rx_key) {
+  seal_ctx_ = EVP_CIPHER_CTX_new();
+  open_ctx_ = EVP_CIPHER_CTX_new();
+  if (seal_ctx_ == NULL || open_ctx_ == NULL) return false;
+
+  // Expand keys once, only nonce is set per frame
+  if (EVP_EncryptInit_ex(seal_ctx_,
+                         EVP_aes_256_gcm(),
+                         NULL,
+                         tx_key,
+                         NULL) != 1) {
+    return false;
+  }
+  if (EVP_DecryptInit_ex(open_ctx_,
+                         EVP_aes_256_gcm(),
+                         NULL,
+                         rx_key,
+                         NULL) != 1) {
+    return false;
+  }
+
+  return true;
+}
+
+
+void Aead::GetNonce(const Header& header, unsigned char* nonce) {
+  memset(nonce, 0, kNonceSize);
+  nonce[0] = header.group;
+  WriteUInt32(nonce + kNonceSize - 4, header.seq);
+}
+
+
+// RTP nonces start with 0xff, which is never a group of binary frames,
+// so both kinds of packets can be sealed with the same key
+void Aead::GetRtpNonce(const RtpHeader& header,
+                       uint32_t roc,
+                       unsigned char* nonce) {
+  memset(nonce, 0, kNonceSize);
+  nonce[0] = 0xff;
+  WriteUInt32(nonce + 4, header.ssrc);
+  WriteUInt32(nonce + 8, (roc << 16) | header.seq);
+}
+
+
+bool Aead::Seal(char* frame, size_t size) {
+  Header header;
+  if (!ReadHeader(frame, size, &header)) return false;
+
+  unsigned char nonce[kNonceSize];
+  GetNonce(header, nonce);
+
+  return SealRaw(nonce, frame, kHeaderSize, size);
+}
+
+
+ssize_t Aead::Open(char* frame, size_t size) {
+  Header header;
+  if (!ReadHeader(frame, size, &header)) return -1;
+
+  unsigned char nonce[kNonceSize];
+  GetNonce(header, nonce);
+
+  return OpenRaw(nonce, frame, kHeaderSize, size);
+}
+
+
+bool Aead::SealRtp(char* packet, size_t size, uint32_t roc) {
+  RtpHeader header;
+  if (!ReadRtpHeader(packet, size, &header)) return false;
+
+  unsigned char nonce[kNonceSize];
+  GetRtpNonce(header, roc, nonce);
+
+  return SealRaw(nonce, packet, kRtpHeaderSize, size);
+}
+
+
+ssize_t Aead::OpenRtp(char* packet, size_t size, uint32_t roc) {
+  RtpHeader header;
+  if (!ReadRtpHeader(packet, size, &header)) return -1;
+
+  unsigned char nonce[kNonceSize];
+  GetRtpNonce(header, roc, nonce);
+
+  return OpenRaw(nonce, packet, kRtpHeaderSize, size);
+}
+
+
+bool Aead::SealRaw(const unsigned char* nonce,
+                   char* data,
+                   size_t aad_len,
+                   size_t size) {
+  unsigned char* aad = reinterpret_cast<unsigned char*>(data);
+  unsigned char* payload = aad + aad_len;
+  int payload_len = size - aad_len;
+  int len;
+
+  if (EVP_EncryptInit_ex(seal_ctx_, NULL, NULL, NULL, nonce) != 1 ||
+      EVP_EncryptUpdate(seal_ctx_, NULL, &len, aad, aad_len) != 1 ||
+      EVP_EncryptUpdate(seal_ctx_, payload, &len, payload, payload_len) != 1 ||
+      EVP_EncryptFinal_ex(seal_ctx_, payload + len, &len) != 1) {
+    return false;
+  }
+
+  return EVP_CIPHER_CTX_ctrl(seal_ctx_,
+                             EVP_CTRL_GCM_GET_TAG,
+                             kTagSize,
+                             payload + payload_len) == 1;
+}
+
+
+ssize_t Aead::OpenRaw(const unsigned char* nonce,
+                      char* data,
+                      size_t aad_len,
+                      size_t size) {
+  if (size < aad_len + kTagSize) return -1;
+
+  unsigned char* aad = reinterpret_cast<unsigned char*>(data);
+  unsigned char* payload = aad + aad_len;
+  int payload_len = size - aad_len - kTagSize;
+  unsigned char tag[kTagSize];
+  int len;
+
+  memcpy(tag, payload + payload_len, kTagSize);
+
+  if (EVP_DecryptInit_ex(open_ctx_, NULL, NULL, NULL, nonce) != 1 ||
+      EVP_DecryptUpdate(open_ctx_, NULL, &len, aad, aad_len) != 1 ||
+      EVP_DecryptUpdate(open_ctx_, payload, &len, payload, payload_len) != 1 ||
+      EVP_CIPHER_CTX_ctrl(open_ctx_,
+                          EVP_CTRL_GCM_SET_TAG,
+                          kTagSize,
+                          tag) != 1 ||
+      EVP_DecryptFinal_ex(open_ctx_, payload + len, &len) != 1) {
+    return -1;
+  }
+
+  return payload_len;
+}
+
+} // namespace frame
+} // namespace vock
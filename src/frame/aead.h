@@ -0,0 +1,66 @@
+#ifndef _SRC_FRAME_AEAD_H_
+#define _SRC_FRAME_AEAD_H_
+
+#include "frame.h"
+#include "rtp.h"
+
+#include <openssl/evp.h>
+#include <stddef.h> // size_t
+#include <sys/types.h> // ssize_t
+
+namespace vock {
+namespace frame {
+
+// AES-256-GCM sealer for binary frames.
+// Keys are set once per session, each direction has its own key, so
+// nonce can be derived from frame's group and seq.
+// Frame header is authenticated, but not encrypted.
+class Aead {
+ public:
+  static const size_t kKeySize = 32;
+  static const size_t kTagSize = 16;
+  static const size_t kNonceSize = 12;
+
+  Aead();
+  ~Aead();
+
+  bool Init(const unsigned char* tx_key, const unsigned char* rx_key);
+
+  // `frame` holds header and `size - kHeaderSize` bytes of payload,
+  // payload is encrypted in place and tag is appended after it.
+  // (NOTE: `frame` should have kTagSize spare bytes after payload)
+  bool Seal(char* frame, size_t size);
+
+  // Verifies and decrypts frame in place,
+  // returns payload size or -1 on failure
+  ssize_t Open(char* frame, size_t size);
+
+  // Same as above for RTP packets. `roc` is the rollover counter of
+  // 16bit sequence numbers, RTP header is authenticated as a whole
+  bool SealRtp(char* packet, size_t size, uint32_t roc);
+  ssize_t OpenRtp(char* packet, size_t size, uint32_t roc);
+
+ protected:
+  static void GetNonce(const Header& header, unsigned char* nonce);
+  static void GetRtpNonce(const RtpHeader& header,
+                          uint32_t roc,
+                          unsigned char* nonce);
+
+  // `data` holds `aad_len` bytes of header followed by payload
+  bool SealRaw(const unsigned char* nonce,
+               char* data,
+               size_t aad_len,
+               size_t size);
+  ssize_t OpenRaw(const unsigned char* nonce,
+                  char* data,
+                  size_t aad_len,
+                  size_t size);
+
+  EVP_CIPHER_CTX* seal_ctx_;
+  EVP_CIPHER_CTX* open_ctx_;
+};
+
+} // namespace frame
+} // namespace vock
+
+#endif // _SRC_FRAME_AEAD_H_
@@ -0,0 +1,438 @@
+#include "binding.h"
+#include "frame.h"
+#include "rtp.h"
+
+#include "node.h"
+#include "node_buffer.h"
+
+#include <string.h> // memmove
+
+namespace vock {
+namespace frame {
+
+using namespace node;
+using namespace v8;
+
+static Persistent<String> group_sym;
+static Persistent<String> flags_sym;
+static Persistent<String> seq_sym;
+static Persistent<String> ts_sym;
+static Persistent<String> length_sym;
+static Persistent<String> marker_sym;
+static Persistent<String> ssrc_sym;
+
+#define UNWRAP\
+    Sealer* s = ObjectWrap::Unwrap<Sealer>(args.This());
+
+static void SetHeader(Handle<Object> out, const Header& header) {
+  out->Set(group_sym, Number::New(header.group));
+  out->Set(flags_sym, Number::New(header.flags));
+  out->Set(seq_sym, Number::New(header.seq));
+  out->Set(ts_sym, Number::New(header.ts));
+}
+
+
+// encodeFrame(out, offset, group, flags, seq, ts, payload)
+// Writes frame into `out` at `offset`, returns number of bytes written
+Handle<Value> Frame::Encode(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 7 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsNumber() ||
+      !args[2]->IsNumber() ||
+      !args[3]->IsNumber() ||
+      !args[4]->IsNumber() ||
+      !args[5]->IsNumber() ||
+      !Buffer::HasInstance(args[6])) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  char* out = Buffer::Data(args[0].As<Object>());
+  size_t out_len = Buffer::Length(args[0].As<Object>());
+  size_t offset = args[1]->Uint32Value();
+  char* payload = Buffer::Data(args[6].As<Object>());
+  size_t payload_len = Buffer::Length(args[6].As<Object>());
+
+  if (offset > out_len || out_len - offset < kHeaderSize + payload_len) {
+    return scope.Close(ThrowException(String::New(
+        "Output buffer is too small!")));
+  }
+
+  Header header;
+  header.group = args[2]->Uint32Value();
+  header.flags = args[3]->Uint32Value();
+  header.seq = args[4]->Uint32Value();
+  header.ts = args[5]->Uint32Value();
+
+  WriteHeader(header, out + offset);
+  memmove(out + offset + kHeaderSize, payload, payload_len);
+
+  return scope.Close(Number::New(kHeaderSize + payload_len));
+}
+
+
+// decodeFrame(raw, out)
+// Fills `out` with header fields, returns false if `raw` isn't a frame.
+// Payload starts at `frameHeaderSize`.
+Handle<Value> Frame::Decode(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 2 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsObject()) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  Header header;
+  if (!ReadHeader(Buffer::Data(args[0].As<Object>()),
+                  Buffer::Length(args[0].As<Object>()),
+                  &header)) {
+    return scope.Close(False());
+  }
+
+  SetHeader(args[1].As<Object>(), header);
+
+  return scope.Close(True());
+}
+
+
+// new Sealer(txKey, rxKey)
+Handle<Value> Sealer::New(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 2 ||
+      !Buffer::HasInstance(args[0]) ||
+      !Buffer::HasInstance(args[1]) ||
+      Buffer::Length(args[0].As<Object>()) != Aead::kKeySize ||
+      Buffer::Length(args[1].As<Object>()) != Aead::kKeySize) {
+    return scope.Close(ThrowException(String::New(
+        "Both arguments should be 32 byte Buffers!")));
+  }
+
+  unsigned char* tx_key = reinterpret_cast<unsigned char*>(
+      Buffer::Data(args[0].As<Object>()));
+  unsigned char* rx_key = reinterpret_cast<unsigned char*>(
+      Buffer::Data(args[1].As<Object>()));
+
+  Sealer* s = new Sealer();
+  if (!s->aead_.Init(tx_key, rx_key)) {
+    delete s;
+    return scope.Close(ThrowException(String::New(
+        "Failed to initialize cipher!")));
+  }
+  s->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+
+ssize_t Sealer::SealOne(char* out,
+                        size_t out_len,
+                        uint8_t group,
+                        uint32_t seq,
+                        uint32_t ts,
+                        const char* payload,
+                        size_t payload_len) {
+  size_t size = kHeaderSize + payload_len;
+  if (out_len < size + Aead::kTagSize) return -1;
+
+  Header header;
+  header.group = group;
+  header.flags = kEncrypted;
+  header.seq = seq;
+  header.ts = ts;
+
+  WriteHeader(header, out);
+  memmove(out + kHeaderSize, payload, payload_len);
+  if (!aead_.Seal(out, size)) return -1;
+
+  return size + Aead::kTagSize;
+}
+
+
+// seal(out, offset, group, seq, ts, payload)
+// Writes sealed frame into `out` at `offset`, returns its size
+Handle<Value> Sealer::Seal(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 6 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsNumber() ||
+      !args[2]->IsNumber() ||
+      !args[3]->IsNumber() ||
+      !args[4]->IsNumber() ||
+      !Buffer::HasInstance(args[5])) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  char* out = Buffer::Data(args[0].As<Object>());
+  size_t out_len = Buffer::Length(args[0].As<Object>());
+  size_t offset = args[1]->Uint32Value();
+  if (offset > out_len) {
+    return scope.Close(ThrowException(String::New(
+        "Output buffer is too small!")));
+  }
+
+  ssize_t r = s->SealOne(out + offset,
+                         out_len - offset,
+                         args[2]->Uint32Value(),
+                         args[3]->Uint32Value(),
+                         args[4]->Uint32Value(),
+                         Buffer::Data(args[5].As<Object>()),
+                         Buffer::Length(args[5].As<Object>()));
+  if (r < 0) {
+    return scope.Close(ThrowException(String::New("Failed to seal frame!")));
+  }
+
+  return scope.Close(Number::New(r));
+}
+
+
+// sealBatch(out, offset, group, seq, ts, payloads)
+// Writes frames with consecutive seqs back to back into `out`,
+// returns Array of their sizes
+Handle<Value> Sealer::SealBatch(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 6 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsNumber() ||
+      !args[2]->IsNumber() ||
+      !args[3]->IsNumber() ||
+      !args[4]->IsNumber() ||
+      !args[5]->IsArray()) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  char* out = Buffer::Data(args[0].As<Object>());
+  size_t out_len = Buffer::Length(args[0].As<Object>());
+  size_t offset = args[1]->Uint32Value();
+  uint8_t group = args[2]->Uint32Value();
+  uint32_t seq = args[3]->Uint32Value();
+  uint32_t ts = args[4]->Uint32Value();
+  Local<Array> payloads = args[5].As<Array>();
+  Local<Array> sizes = Array::New(payloads->Length());
+
+  for (uint32_t i = 0; i < payloads->Length(); i++) {
+    Local<Value> payload = payloads->Get(i);
+    if (!Buffer::HasInstance(payload) || offset > out_len) {
+      return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+    }
+
+    ssize_t r = s->SealOne(out + offset,
+                           out_len - offset,
+                           group,
+                           seq + i,
+                           ts,
+                           Buffer::Data(payload.As<Object>()),
+                           Buffer::Length(payload.As<Object>()));
+    if (r < 0) {
+      return scope.Close(ThrowException(String::New(
+          "Failed to seal frame!")));
+    }
+
+    sizes->Set(i, Number::New(r));
+    offset += r;
+  }
+
+  return scope.Close(sizes);
+}
+
+
+ssize_t Sealer::OpenOne(Handle<Value> raw, Handle<Value> out) {
+  if (!Buffer::HasInstance(raw) || !out->IsObject()) return -1;
+
+  char* data = Buffer::Data(raw.As<Object>());
+  size_t size = Buffer::Length(raw.As<Object>());
+
+  Header header;
+  if (!ReadHeader(data, size, &header)) return -1;
+  if ((header.flags & kEncrypted) == 0) return -1;
+
+  ssize_t r = aead_.Open(data, size);
+  if (r < 0) return -1;
+
+  SetHeader(out.As<Object>(), header);
+  return r;
+}
+
+
+// open(raw, out)
+// Decrypts frame in place, fills `out` with header fields.
+// Returns payload size (it starts at `frameHeaderSize`) or -1.
+Handle<Value> Sealer::Open(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 2) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  return scope.Close(Number::New(s->OpenOne(args[0], args[1])));
+}
+
+
+// openBatch(raws, outs)
+// Same as open() for each frame, payload size goes to `outs[i].length`.
+// Returns number of successfully opened frames.
+Handle<Value> Sealer::OpenBatch(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 2 || !args[0]->IsArray() || !args[1]->IsArray()) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  Local<Array> raws = args[0].As<Array>();
+  Local<Array> outs = args[1].As<Array>();
+  if (raws->Length() != outs->Length()) {
+    return scope.Close(ThrowException(String::New(
+        "Arrays should have the same length!")));
+  }
+
+  int opened = 0;
+  for (uint32_t i = 0; i < raws->Length(); i++) {
+    Local<Value> out = outs->Get(i);
+    ssize_t r = s->OpenOne(raws->Get(i), out);
+
+    if (r >= 0) opened++;
+    if (out->IsObject()) out.As<Object>()->Set(length_sym, Number::New(r));
+  }
+
+  return scope.Close(Number::New(opened));
+}
+
+
+// sealRtp(out, offset, marker, seq, ts, ssrc, roc, payload)
+// Writes sealed RTP packet into `out` at `offset`, returns its size
+Handle<Value> Sealer::SealRtp(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 8 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsNumber() ||
+      !args[3]->IsNumber() ||
+      !args[4]->IsNumber() ||
+      !args[5]->IsNumber() ||
+      !args[6]->IsNumber() ||
+      !Buffer::HasInstance(args[7])) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  char* out = Buffer::Data(args[0].As<Object>());
+  size_t out_len = Buffer::Length(args[0].As<Object>());
+  size_t offset = args[1]->Uint32Value();
+  char* payload = Buffer::Data(args[7].As<Object>());
+  size_t payload_len = Buffer::Length(args[7].As<Object>());
+  size_t size = kRtpHeaderSize + payload_len;
+
+  if (offset > out_len || out_len - offset < size + Aead::kTagSize) {
+    return scope.Close(ThrowException(String::New(
+        "Output buffer is too small!")));
+  }
+  out += offset;
+
+  RtpHeader header;
+  header.marker = args[2]->IsTrue();
+  header.payload_type = kRtpPayloadType;
+  header.seq = args[3]->Uint32Value();
+  header.ts = args[4]->Uint32Value();
+  header.ssrc = args[5]->Uint32Value();
+
+  WriteRtpHeader(header, out);
+  memmove(out + kRtpHeaderSize, payload, payload_len);
+  if (!s->aead_.SealRtp(out, size, args[6]->Uint32Value())) {
+    return scope.Close(ThrowException(String::New("Failed to seal packet!")));
+  }
+
+  return scope.Close(Number::New(size + Aead::kTagSize));
+}
+
+
+// openRtp(raw, out, roc)
+// Decrypts RTP packet in place, fills `out` with marker, seq, ts and ssrc.
+// Returns payload size (it starts at `rtpHeaderSize`) or -1.
+Handle<Value> Sealer::OpenRtp(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 3 ||
+      !Buffer::HasInstance(args[0]) ||
+      !args[1]->IsObject() ||
+      !args[2]->IsNumber()) {
+    return scope.Close(ThrowException(String::New("Incorrect arguments!")));
+  }
+
+  char* data = Buffer::Data(args[0].As<Object>());
+  size_t size = Buffer::Length(args[0].As<Object>());
+
+  RtpHeader header;
+  if (!ReadRtpHeader(data, size, &header) ||
+      header.payload_type != kRtpPayloadType) {
+    return scope.Close(Number::New(-1));
+  }
+
+  ssize_t r = s->aead_.OpenRtp(data, size, args[2]->Uint32Value());
+  if (r < 0) return scope.Close(Number::New(-1));
+
+  Local<Object> out = args[1].As<Object>();
+  out->Set(marker_sym, header.marker ? True() : False());
+  out->Set(seq_sym, Number::New(header.seq));
+  out->Set(ts_sym, Number::New(header.ts));
+  out->Set(ssrc_sym, Number::New(header.ssrc));
+
+  return scope.Close(Number::New(r));
+}
+
+
+void Sealer::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<FunctionTemplate> t = FunctionTemplate::New(Sealer::New);
+
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->SetClassName(String::NewSymbol("Sealer"));
+
+  NODE_SET_PROTOTYPE_METHOD(t, "seal", Sealer::Seal);
+  NODE_SET_PROTOTYPE_METHOD(t, "sealBatch", Sealer::SealBatch);
+  NODE_SET_PROTOTYPE_METHOD(t, "open", Sealer::Open);
+  NODE_SET_PROTOTYPE_METHOD(t, "openBatch", Sealer::OpenBatch);
+  NODE_SET_PROTOTYPE_METHOD(t, "sealRtp", Sealer::SealRtp);
+  NODE_SET_PROTOTYPE_METHOD(t, "openRtp", Sealer::OpenRtp);
+
+  target->Set(String::NewSymbol("Sealer"), t->GetFunction());
+  target->Set(String::NewSymbol("sealerTagSize"), Number::New(Aead::kTagSize));
+}
+
+
+void Frame::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  group_sym = Persistent<String>::New(String::NewSymbol("group"));
+  flags_sym = Persistent<String>::New(String::NewSymbol("flags"));
+  seq_sym = Persistent<String>::New(String::NewSymbol("seq"));
+  ts_sym = Persistent<String>::New(String::NewSymbol("ts"));
+  length_sym = Persistent<String>::New(String::NewSymbol("length"));
+  marker_sym = Persistent<String>::New(String::NewSymbol("marker"));
+  ssrc_sym = Persistent<String>::New(String::NewSymbol("ssrc"));
+
+  NODE_SET_METHOD(target, "encodeFrame", Frame::Encode);
+  NODE_SET_METHOD(target, "decodeFrame", Frame::Decode);
+  target->Set(String::NewSymbol("frameHeaderSize"),
+              Number::New(kHeaderSize));
+  target->Set(String::NewSymbol("rtpHeaderSize"),
+              Number::New(kRtpHeaderSize));
+}
+
+} // namespace frame
+} // namespace vock
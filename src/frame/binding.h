@@ -0,0 +1,51 @@
+#ifndef _SRC_FRAME_BINDING_H_
+#define _SRC_FRAME_BINDING_H_
+
+#include "node.h"
+#include "v8.h"
+#include "node_object_wrap.h"
+#include "frame.h"
+#include "aead.h"
+
+namespace vock {
+namespace frame {
+
+using namespace node;
+
+class Frame {
+ public:
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> Encode(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Decode(const v8::Arguments& args);
+};
+
+class Sealer : public ObjectWrap {
+ public:
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> New(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Seal(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SealBatch(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Open(const v8::Arguments& args);
+  static v8::Handle<v8::Value> OpenBatch(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SealRtp(const v8::Arguments& args);
+  static v8::Handle<v8::Value> OpenRtp(const v8::Arguments& args);
+
+ protected:
+  ssize_t SealOne(char* out,
+                  size_t out_len,
+                  uint8_t group,
+                  uint32_t seq,
+                  uint32_t ts,
+                  const char* payload,
+                  size_t payload_len);
+  ssize_t OpenOne(v8::Handle<v8::Value> raw, v8::Handle<v8::Value> out);
+
+  Aead aead_;
+};
+
+} // namespace frame
+} // namespace vock
+
+#endif // _SRC_FRAME_BINDING_H_
@@ -0,0 +1,79 @@
+#ifndef _SRC_FRAME_FRAME_H_
+#define _SRC_FRAME_FRAME_H_
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace frame {
+
+// Binary frame layout (all numbers are big-endian):
+//
+//   0      1        2      3      4       8      12
+//   | 0xc1 | version | group | flags | seq u32 | ts u32 | payload...
+//
+// 0xc1 is never used by msgpack, so frames and msgpack packets can share
+// one socket.
+static const uint8_t kMagic = 0xc1;
+static const uint8_t kVersion = 1;
+static const size_t kHeaderSize = 12;
+
+enum Flags {
+  kEncrypted = 1
+};
+
+struct Header {
+  uint8_t group;
+  uint8_t flags;
+  uint32_t seq;
+  uint32_t ts;
+};
+
+
+inline void WriteUInt32(unsigned char* out, uint32_t value) {
+  out[0] = (value >> 24) & 0xff;
+  out[1] = (value >> 16) & 0xff;
+  out[2] = (value >> 8) & 0xff;
+  out[3] = value & 0xff;
+}
+
+
+inline uint32_t ReadUInt32(const unsigned char* data) {
+  return (static_cast<uint32_t>(data[0]) << 24) |
+         (static_cast<uint32_t>(data[1]) << 16) |
+         (static_cast<uint32_t>(data[2]) << 8) |
+         static_cast<uint32_t>(data[3]);
+}
+
+
+// `out` should have at least kHeaderSize bytes
+inline void WriteHeader(const Header& header, char* out) {
+  unsigned char* p = reinterpret_cast<unsigned char*>(out);
+
+  p[0] = kMagic;
+  p[1] = kVersion;
+  p[2] = header.group;
+  p[3] = header.flags;
+  WriteUInt32(p + 4, header.seq);
+  WriteUInt32(p + 8, header.ts);
+}
+
+
+// Returns false if data isn't a frame of known version
+inline bool ReadHeader(const char* data, size_t len, Header* header) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+  if (len < kHeaderSize || p[0] != kMagic || p[1] != kVersion) return false;
+
+  header->group = p[2];
+  header->flags = p[3];
+  header->seq = ReadUInt32(p + 4);
+  header->ts = ReadUInt32(p + 8);
+
+  return true;
+}
+
+} // namespace frame
+} // namespace vock
+
+#endif // _SRC_FRAME_FRAME_H_
@@ -0,0 +1,64 @@
+#ifndef _SRC_FRAME_RTP_H_
+#define _SRC_FRAME_RTP_H_
+
+#include "frame.h"
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace frame {
+
+// RTP header (RFC 3550) of Opus voice packets (RFC 7587),
+// CSRCs, padding and header extensions are never used:
+//
+//   0      1         2         4        8          12
+//   | 0x80 | M | PT  | seq u16 | ts u32 | ssrc u32 | payload...
+//
+// Media clock of Opus streams is always 48kHz, whatever the sample rate is.
+static const uint8_t kRtpVersion = 2;
+static const size_t kRtpHeaderSize = 12;
+static const uint8_t kRtpPayloadType = 111;
+static const uint32_t kRtpClockRate = 48000;
+
+struct RtpHeader {
+  bool marker;
+  uint8_t payload_type;
+  uint16_t seq;
+  uint32_t ts;
+  uint32_t ssrc;
+};
+
+
+// `out` should have at least kRtpHeaderSize bytes
+inline void WriteRtpHeader(const RtpHeader& header, char* out) {
+  unsigned char* p = reinterpret_cast<unsigned char*>(out);
+
+  p[0] = kRtpVersion << 6;
+  p[1] = (header.marker ? 0x80 : 0) | (header.payload_type & 0x7f);
+  p[2] = (header.seq >> 8) & 0xff;
+  p[3] = header.seq & 0xff;
+  WriteUInt32(p + 4, header.ts);
+  WriteUInt32(p + 8, header.ssrc);
+}
+
+
+// Returns false if data isn't an RTP packet in the form above
+inline bool ReadRtpHeader(const char* data, size_t len, RtpHeader* header) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+  if (len < kRtpHeaderSize || p[0] != (kRtpVersion << 6)) return false;
+
+  header->marker = (p[1] & 0x80) != 0;
+  header->payload_type = p[1] & 0x7f;
+  header->seq = (static_cast<uint16_t>(p[2]) << 8) | p[3];
+  header->ts = ReadUInt32(p + 4);
+  header->ssrc = ReadUInt32(p + 8);
+
+  return true;
+}
+
+} // namespace frame
+} // namespace vock
+
+#endif // _SRC_FRAME_RTP_H_
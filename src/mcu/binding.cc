@@ -0,0 +1,309 @@
+#include "binding.h"
+#include "mixer.h"
+#include "relay/relay.h"
+
+#include "node.h"
+#include "node_buffer.h"
+
+#include <arpa/inet.h> // inet_pton, inet_ntop
+#include <string.h> // memset
+#include <stdlib.h> // abort
+
+namespace vock {
+namespace mcu {
+
+using namespace node;
+using namespace v8;
+
+static Persistent<String> onmessages_sym;
+
+#define UNWRAP\
+    Mcu* m = ObjectWrap::Unwrap<Mcu>(args.This());
+
+Mcu::Mcu(opus_int32 rate, int threads) : poll_(NULL), mixer_(rate, threads) {
+}
+
+
+Mcu::~Mcu() {
+  DoClose();
+}
+
+
+static void OnPollClose(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_poll_t*>(handle);
+}
+
+
+// Parses (address, port) pair of arguments
+static bool ParseAddress(const Arguments& args, struct sockaddr_in* addr) {
+  if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsNumber()) {
+    return false;
+  }
+
+  String::AsciiValue address(args[0]);
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(args[1]->Uint32Value());
+
+  return *address != NULL && inet_pton(AF_INET, *address, &addr->sin_addr) == 1;
+}
+
+
+void Mcu::DoClose() {
+  // Workers are sending through socket
+  mixer_.Stop();
+
+  if (poll_ != NULL) {
+    uv_poll_stop(poll_);
+    uv_close(reinterpret_cast<uv_handle_t*>(poll_), OnPollClose);
+    poll_ = NULL;
+  }
+  socket_.Close();
+}
+
+
+// new Mcu(rate, threads)
+Handle<Value> Mcu::New(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "Both arguments should be numbers!")));
+  }
+
+  opus_int32 rate = args[0]->Int32Value();
+  if (rate != 8000 && rate != 12000 && rate != 16000 &&
+      rate != 24000 && rate != 48000) {
+    return scope.Close(ThrowException(String::New(
+        "Unsupported sample rate!")));
+  }
+
+  Mcu* m = new Mcu(rate, args[1]->Int32Value());
+  m->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+
+// bind(port)
+// Returns bound port number
+Handle<Value> Mcu::Bind(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number!")));
+  }
+
+  if (m->poll_ != NULL) {
+    return scope.Close(ThrowException(String::New(
+        "Mixer is already bound!")));
+  }
+
+  int r = m->socket_.Bind(args[0]->Uint32Value());
+  if (r != 0) return scope.Close(ThrowException(ErrnoException(-r, "bind")));
+
+  uint16_t port;
+  r = m->socket_.GetPort(&port);
+  if (r != 0) {
+    m->socket_.Close();
+    return scope.Close(ThrowException(ErrnoException(-r, "getsockname")));
+  }
+
+  m->poll_ = new uv_poll_t();
+  m->poll_->data = m;
+  if (uv_poll_init_socket(uv_default_loop(), m->poll_, m->socket_.fd()) ||
+      uv_poll_start(m->poll_, UV_READABLE, OnPoll)) {
+    abort();
+  }
+
+  m->mixer_.Start(&m->socket_);
+
+  // Keep object alive while socket is open
+  m->Ref();
+
+  return scope.Close(Number::New(port));
+}
+
+
+// join(address, port, room)
+// Adds participant to the room (moving it from the previous one)
+Handle<Value> Mcu::Join(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  struct sockaddr_in addr;
+  if (!ParseAddress(args, &addr) || args.Length() < 3 || !args[2]->IsString()) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be address, port and room!")));
+  }
+
+  String::Utf8Value room(args[2]);
+  m->mixer_.Join(addr, std::string(*room, room.length()));
+
+  return scope.Close(Null());
+}
+
+
+// leave(address, port)
+Handle<Value> Mcu::Leave(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  struct sockaddr_in addr;
+  if (!ParseAddress(args, &addr)) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be address and port!")));
+  }
+
+  m->mixer_.Leave(addr);
+
+  return scope.Close(Null());
+}
+
+
+// setFilter(maxLevel, maxSpeakers)
+Handle<Value> Mcu::SetFilter(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "Both arguments should be numbers!")));
+  }
+
+  uint32_t max_level = args[0]->Uint32Value();
+  if (max_level > relay::kSilence) max_level = relay::kSilence;
+
+  int max_speakers = args[1]->Int32Value();
+  if (max_speakers < 0) max_speakers = 0;
+
+  m->mixer_.SetFilter(max_level, max_speakers);
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Mcu::GetStats(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  Stats* stats = m->mixer_.stats();
+  Local<Object> res = Object::New();
+
+#define COUNTER(name, field)\
+  res->Set(String::NewSymbol(name),\
+           Number::New(static_cast<double>(stats->field.Get())));
+
+  COUNTER("received", received)
+  COUNTER("late", late)
+  COUNTER("decoded", decoded)
+  COUNTER("concealed", concealed)
+  COUNTER("encoded", encoded)
+  COUNTER("sent", sent)
+
+#undef COUNTER
+
+  Local<Object> tick = Object::New();
+  tick->Set(String::NewSymbol("count"),
+            Number::New(static_cast<double>(stats->tick_time.count())));
+  tick->Set(String::NewSymbol("sum"),
+            Number::New(static_cast<double>(stats->tick_time.sum())));
+  tick->Set(String::NewSymbol("max"),
+            Number::New(static_cast<double>(stats->tick_time.max())));
+  res->Set(String::NewSymbol("tickTime"), tick);
+
+  return scope.Close(res);
+}
+
+
+Handle<Value> Mcu::Close(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (m->poll_ != NULL) {
+    m->DoClose();
+    m->Unref();
+  }
+
+  return scope.Close(Null());
+}
+
+
+void Mcu::OnPoll(uv_poll_t* handle, int status, int events) {
+  HandleScope scope;
+  Mcu* m = reinterpret_cast<Mcu*>(handle->data);
+  udp::Datagram datagrams[udp::Socket::kBatchSize];
+
+  if (status != 0) return;
+
+  while (m->poll_ != NULL) {
+    int count = m->socket_.Receive(datagrams);
+    if (count <= 0) break;
+
+    // Voice goes to mixer threads without leaving C++
+    m->mixer_.Receive(datagrams, count);
+
+    // Everything else (control messages) goes to JS
+    int control = 0;
+    for (int i = 0; i < count; i++) {
+      if (!relay::Relay::IsRelayPacket(datagrams[i])) control++;
+    }
+    if (control == 0) continue;
+
+    Local<Array> buffers = Array::New(control);
+    Local<Array> addresses = Array::New(control);
+    Local<Array> ports = Array::New(control);
+
+    for (int i = 0, j = 0; i < count; i++) {
+      if (relay::Relay::IsRelayPacket(datagrams[i])) continue;
+
+      char address[INET_ADDRSTRLEN];
+      Buffer* buffer = Buffer::New(datagrams[i].data, datagrams[i].size);
+
+      inet_ntop(AF_INET,
+                &datagrams[i].addr.sin_addr,
+                address,
+                sizeof(address));
+      buffers->Set(j, buffer->handle_);
+      addresses->Set(j, String::New(address));
+      ports->Set(j, Number::New(ntohs(datagrams[i].addr.sin_port)));
+      j++;
+    }
+
+    Handle<Value> argv[3] = { buffers, addresses, ports };
+    MakeCallback(m->handle_, onmessages_sym, 3, argv);
+  }
+}
+
+
+void Mcu::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  onmessages_sym = Persistent<String>::New(String::NewSymbol("onmessages"));
+
+  Local<FunctionTemplate> t = FunctionTemplate::New(Mcu::New);
+
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->SetClassName(String::NewSymbol("Mcu"));
+
+  NODE_SET_PROTOTYPE_METHOD(t, "bind", Mcu::Bind);
+  NODE_SET_PROTOTYPE_METHOD(t, "join", Mcu::Join);
+  NODE_SET_PROTOTYPE_METHOD(t, "leave", Mcu::Leave);
+  NODE_SET_PROTOTYPE_METHOD(t, "setFilter", Mcu::SetFilter);
+  NODE_SET_PROTOTYPE_METHOD(t, "getStats", Mcu::GetStats);
+  NODE_SET_PROTOTYPE_METHOD(t, "close", Mcu::Close);
+
+  target->Set(String::NewSymbol("Mcu"), t->GetFunction());
+}
+
+} // namespace mcu
+} // namespace vock
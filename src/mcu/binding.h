@@ -0,0 +1,43 @@
+#ifndef _SRC_MCU_BINDING_H_
+#define _SRC_MCU_BINDING_H_
+
+#include "node.h"
+#include "v8.h"
+#include "node_object_wrap.h"
+#include "mixer.h"
+#include "udp/socket.h"
+
+namespace vock {
+namespace mcu {
+
+using namespace node;
+
+class Mcu : public ObjectWrap {
+ public:
+  Mcu(opus_int32 rate, int threads);
+  ~Mcu();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> New(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Bind(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Join(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Leave(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetFilter(const v8::Arguments& args);
+  static v8::Handle<v8::Value> GetStats(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Close(const v8::Arguments& args);
+
+  static void OnPoll(uv_poll_t* handle, int status, int events);
+
+ protected:
+  void DoClose();
+
+  udp::Socket socket_;
+  uv_poll_t* poll_;
+  Mixer mixer_;
+};
+
+} // namespace mcu
+} // namespace vock
+
+#endif // _SRC_MCU_BINDING_H_
@@ -0,0 +1,217 @@
+#include "mixer.h"
+#include "room.h"
+#include "relay/relay.h"
+#include "frame/frame.h"
+#include "uv.h"
+
+#include <stdlib.h> // abort
+#include <time.h> // nanosleep
+
+namespace vock {
+namespace mcu {
+
+Mixer::Mixer(opus_int32 rate, int threads) : rate_(rate),
+                                             frame_samples_(rate / 50),
+                                             max_level_(relay::kSilence),
+                                             max_speakers_(0),
+                                             worker_count_(threads),
+                                             running_(false),
+                                             socket_(NULL) {
+  if (worker_count_ < 1) worker_count_ = 1;
+  if (worker_count_ > kMaxThreads) worker_count_ = kMaxThreads;
+
+  for (int i = 0; i < worker_count_; i++) {
+    workers_[i].mixer = this;
+    workers_[i].participants = 0;
+    if (uv_mutex_init(&workers_[i].mutex) != 0) abort();
+  }
+}
+
+
+Mixer::~Mixer() {
+  Stop();
+
+  // Rooms that weren't picked up by workers
+  for (int i = 0; i < worker_count_; i++) {
+    Worker* w = &workers_[i];
+
+    for (size_t j = 0; j < w->added.size(); j++) delete w->added[j];
+    for (size_t j = 0; j < w->rooms.size(); j++) delete w->rooms[j];
+    uv_mutex_destroy(&w->mutex);
+  }
+}
+
+
+uint64_t Mixer::AddrKey(const struct sockaddr_in& addr) {
+  return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+
+void Mixer::Start(udp::Socket* socket) {
+  if (running_) return;
+  running_ = true;
+  socket_ = socket;
+
+  for (int i = 0; i < worker_count_; i++) {
+    uv_sem_init(&workers_[i].terminate, 0);
+    uv_thread_create(&workers_[i].thread, WorkerLoop, &workers_[i]);
+  }
+}
+
+
+void Mixer::Stop() {
+  if (!running_) return;
+  running_ = false;
+
+  for (int i = 0; i < worker_count_; i++) {
+    uv_sem_post(&workers_[i].terminate);
+    uv_thread_join(&workers_[i].thread);
+    uv_sem_destroy(&workers_[i].terminate);
+  }
+  socket_ = NULL;
+}
+
+
+void Mixer::Join(const struct sockaddr_in& addr, const std::string& room) {
+  ParticipantMap::iterator it = participants_.find(AddrKey(addr));
+
+  // Rejoin (keepalive) or room change
+  if (it != participants_.end()) {
+    if (it->second->room->id() == room) return;
+    Leave(addr);
+  }
+
+  Room* r;
+  RoomMap::iterator rit = rooms_.find(room);
+  if (rit == rooms_.end()) {
+    r = new Room(room, this);
+
+    // Put room on the least loaded worker
+    for (int i = 1; i < worker_count_; i++) {
+      if (workers_[i].participants < workers_[r->worker].participants) {
+        r->worker = i;
+      }
+    }
+
+    Worker* w = &workers_[r->worker];
+    uv_mutex_lock(&w->mutex);
+    w->added.push_back(r);
+    uv_mutex_unlock(&w->mutex);
+
+    rooms_[room] = r;
+  } else {
+    r = rit->second;
+  }
+
+  Participant* p = new Participant(addr, this);
+  p->room = r;
+  r->size++;
+  workers_[r->worker].participants++;
+
+  participants_[AddrKey(addr)] = p;
+  r->Join(p);
+}
+
+
+void Mixer::Leave(const struct sockaddr_in& addr) {
+  ParticipantMap::iterator it = participants_.find(AddrKey(addr));
+  if (it == participants_.end()) return;
+
+  Participant* p = it->second;
+  Room* r = p->room;
+  participants_.erase(it);
+
+  r->size--;
+  workers_[r->worker].participants--;
+
+  // Worker frees both of them
+  r->Leave(p);
+  if (r->size == 0) {
+    rooms_.erase(r->id());
+    r->Close();
+  }
+}
+
+
+void Mixer::SetFilter(uint8_t max_level, int max_speakers) {
+  max_level_ = max_level;
+  max_speakers_ = max_speakers;
+}
+
+
+void Mixer::Receive(udp::Datagram* in, int count) {
+  for (int i = 0; i < count; i++) {
+    udp::Datagram& d = in[i];
+    if (!relay::Relay::IsRelayPacket(d)) continue;
+
+    unsigned char* p = reinterpret_cast<unsigned char*>(d.data);
+    frame::Header header;
+    if (p[2] != relay::kPublish ||
+        !frame::ReadHeader(d.data + relay::kHeaderSize,
+                           d.size - relay::kHeaderSize,
+                           &header)) {
+      continue;
+    }
+
+    ParticipantMap::iterator it = participants_.find(AddrKey(d.addr));
+    if (it == participants_.end()) continue;
+
+    it->second->room->Push(it->second,
+                           header.seq,
+                           p[3],
+                           d.data + kPayloadOffset,
+                           d.size - kPayloadOffset);
+  }
+}
+
+
+void Mixer::WorkerLoop(void* arg) {
+  Worker* w = reinterpret_cast<Worker*>(arg);
+  Mixer* m = w->mixer;
+  uint64_t period = 1000000000ULL * m->frame_samples_ / m->rate_;
+  uint64_t deadline = uv_hrtime();
+  uint32_t ts = 0;
+
+  while (uv_sem_trywait(&w->terminate) != 0) {
+    m->Tick(w, ts);
+    ts += period / 1000000ULL;
+
+    // Sleep until the next frame, without accumulating drift
+    deadline += period;
+    uint64_t now = uv_hrtime();
+    if (deadline > now) {
+      struct timespec t;
+      t.tv_sec = (deadline - now) / 1000000000ULL;
+      t.tv_nsec = (deadline - now) % 1000000000ULL;
+      nanosleep(&t, NULL);
+    } else {
+      // Overloaded, don't try to catch up
+      deadline = now;
+    }
+  }
+}
+
+
+void Mixer::Tick(Worker* w, uint32_t ts) {
+  uv_mutex_lock(&w->mutex);
+  w->rooms.insert(w->rooms.end(), w->added.begin(), w->added.end());
+  w->added.clear();
+  uv_mutex_unlock(&w->mutex);
+
+  for (size_t i = 0; i < w->rooms.size(); i++) {
+    Room* r = w->rooms[i];
+    uint64_t start = uv_hrtime();
+
+    if (!r->Tick(socket_, ts)) {
+      delete r;
+      w->rooms.erase(w->rooms.begin() + i);
+      i--;
+      continue;
+    }
+
+    stats_.tick_time.Record(uv_hrtime() - start);
+  }
+}
+
+} // namespace mcu
+} // namespace vock
@@ -0,0 +1,108 @@
+#ifndef _SRC_MCU_MIXER_H_
+#define _SRC_MCU_MIXER_H_
+
+#include "uv.h"
+#include "room.h"
+#include "audio/stats.h"
+#include "udp/socket.h"
+
+#include <netinet/in.h> // sockaddr_in
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vock {
+namespace mcu {
+
+using audio::Counter;
+using audio::Histogram;
+
+struct Stats {
+  Counter received;
+  Counter late;
+  Counter decoded;
+  Counter concealed;
+  Counter encoded;
+  Counter sent;
+
+  // Nanoseconds spent mixing one room per frame
+  Histogram tick_time;
+};
+
+// Headless mixer: rooms are spread across worker threads, each mixing
+// its rooms once per frame and sending the results through shared socket.
+class Mixer {
+ public:
+  static const int kMaxThreads = 64;
+
+  Mixer(opus_int32 rate, int threads);
+  ~Mixer();
+
+  void Start(udp::Socket* socket);
+  void Stop();
+
+  // Event loop thread only
+  void Join(const struct sockaddr_in& addr, const std::string& room);
+  void Leave(const struct sockaddr_in& addr);
+
+  // Speakers quieter than `max_level` are not mixed, and only
+  // `max_speakers` loudest ones are (0 - everyone)
+  void SetFilter(uint8_t max_level, int max_speakers);
+
+  // Queues published packets from `in` for mixing,
+  // other datagrams are ignored
+  void Receive(udp::Datagram* in, int count);
+
+  inline Stats* stats() { return &stats_; }
+  inline opus_int32 rate() const { return rate_; }
+  inline int frame_samples() const { return frame_samples_; }
+  inline uint8_t max_level() const { return max_level_; }
+  inline int max_speakers() const { return max_speakers_; }
+
+ protected:
+  typedef std::map<uint64_t, Participant*> ParticipantMap;
+  typedef std::map<std::string, Room*> RoomMap;
+
+  struct Worker {
+    Mixer* mixer;
+    uv_thread_t thread;
+    uv_sem_t terminate;
+
+    // Rooms added by event loop
+    uv_mutex_t mutex;
+    std::vector<Room*> added;
+
+    // Worker thread only
+    std::vector<Room*> rooms;
+
+    // Event loop thread only
+    int participants;
+  };
+
+  static void WorkerLoop(void* arg);
+  void Tick(Worker* w, uint32_t ts);
+
+  static uint64_t AddrKey(const struct sockaddr_in& addr);
+
+  opus_int32 rate_;
+  int frame_samples_;
+  volatile uint8_t max_level_;
+  volatile int max_speakers_;
+
+  Worker workers_[kMaxThreads];
+  int worker_count_;
+  bool running_;
+  udp::Socket* socket_;
+
+  // Event loop thread only
+  ParticipantMap participants_;
+  RoomMap rooms_;
+
+  Stats stats_;
+};
+
+} // namespace mcu
+} // namespace vock
+
+#endif // _SRC_MCU_MIXER_H_
@@ -0,0 +1,355 @@
+#include "room.h"
+#include "mixer.h"
+#include "audio/mix.h"
+#include "opus/codec.h"
+#include "frame/frame.h"
+#include "relay/relay.h"
+
+#include <algorithm> // std::partial_sort
+#include <stdio.h> // fprintf
+#include <stdlib.h> // abort
+#include <string.h> // memcpy, memset
+
+namespace vock {
+namespace mcu {
+
+Participant::Participant(const struct sockaddr_in& addr, Mixer* mixer)
+    : addr(addr),
+      mixer(mixer),
+      codec(mixer->rate(), 1),
+      room(NULL),
+      started(false),
+      delay(0),
+      next_seq(0),
+      missing(0),
+      current(NULL),
+      level(relay::kSilence),
+      speaking(false),
+      out_seq(0) {
+  if (codec.Init() != OPUS_OK) {
+    fprintf(stderr, "Failed to allocate participant's codec!\n");
+    abort();
+  }
+
+  for (int i = 0; i < kQueueSize; i++) queue[i].used = false;
+  pcm = new float[mixer->frame_samples()];
+}
+
+
+Participant::~Participant() {
+  delete[] pcm;
+}
+
+
+bool Participant::Enqueue(uint32_t seq,
+                          uint8_t level,
+                          const char* data,
+                          size_t size) {
+  // (Re)start playout, one frame later to absorb network jitter
+  if (!started) {
+    started = true;
+    delay = 1;
+    next_seq = seq;
+    missing = 0;
+    for (int i = 0; i < kQueueSize; i++) queue[i].used = false;
+  }
+
+  int32_t ahead = static_cast<int32_t>(seq - next_seq);
+  if (ahead < 0) return false;
+
+  // Too far ahead - skip missing frames
+  if (ahead >= kQueueSize) {
+    next_seq = seq - kQueueSize + 1;
+    for (int i = 0; i < kQueueSize; i++) {
+      if (static_cast<int32_t>(queue[i].seq - next_seq) < 0) {
+        queue[i].used = false;
+      }
+    }
+  }
+
+  Slot* slot = &queue[seq % kQueueSize];
+  slot->used = true;
+  slot->seq = seq;
+  slot->level = level;
+  slot->size = size;
+  memcpy(slot->data, data, size);
+
+  return true;
+}
+
+
+bool Participant::Pop() {
+  if (!started) return false;
+  if (delay > 0) {
+    delay--;
+    return false;
+  }
+
+  Slot* slot = &queue[next_seq % kQueueSize];
+  if (slot->used && slot->seq == next_seq) {
+    // Data stays intact until the next Enqueue()
+    slot->used = false;
+    current = slot;
+    level = slot->level;
+    missing = 0;
+  } else if (++missing <= kMaxConcealed) {
+    current = NULL;
+  } else {
+    // Stopped publishing (i.e. muted), resync on the next packet
+    started = false;
+    level = relay::kSilence;
+    return false;
+  }
+  next_seq++;
+
+  return true;
+}
+
+
+bool Participant::Decode() {
+  int r;
+  if (current != NULL) {
+    r = codec.DecodeFloat(current->data,
+                          current->size,
+                          pcm,
+                          mixer->frame_samples());
+    mixer->stats()->decoded.Inc();
+  } else {
+    r = codec.DecodeFloat(NULL, 0, pcm, mixer->frame_samples());
+    mixer->stats()->concealed.Inc();
+  }
+
+  // Corrupted packet
+  return r == mixer->frame_samples();
+}
+
+
+Room::Room(const std::string& id, Mixer* mixer) : size(0),
+                                                   worker(0),
+                                                   id_(id),
+                                                   mixer_(mixer),
+                                                   closed_(false),
+                                                   shared_(mixer->rate(), 1) {
+  if (shared_.Init() != OPUS_OK) {
+    fprintf(stderr, "Failed to allocate room's codec!\n");
+    abort();
+  }
+
+  if (uv_mutex_init(&mutex_) != 0) abort();
+
+  mix_ = new float[mixer->frame_samples()];
+  minus_ = new float[mixer->frame_samples()];
+}
+
+
+Room::~Room() {
+  for (size_t i = 0; i < participants_.size(); i++) {
+    delete participants_[i];
+  }
+  uv_mutex_destroy(&mutex_);
+  delete[] mix_;
+  delete[] minus_;
+}
+
+
+void Room::Join(Participant* p) {
+  Event e;
+  e.type = Event::kJoin;
+  e.p = p;
+
+  uv_mutex_lock(&mutex_);
+  events_.push_back(e);
+  uv_mutex_unlock(&mutex_);
+}
+
+
+void Room::Leave(Participant* p) {
+  Event e;
+  e.type = Event::kLeave;
+  e.p = p;
+
+  uv_mutex_lock(&mutex_);
+  events_.push_back(e);
+  uv_mutex_unlock(&mutex_);
+}
+
+
+void Room::Push(Participant* p,
+                uint32_t seq,
+                uint8_t level,
+                const char* data,
+                size_t size) {
+  if (size > kMaxPacketSize) return;
+
+  uv_mutex_lock(&mutex_);
+  events_.resize(events_.size() + 1);
+
+  Event* e = &events_.back();
+  e->type = Event::kPacket;
+  e->p = p;
+  e->seq = seq;
+  e->level = level;
+  e->size = size;
+  memcpy(e->data, data, size);
+  uv_mutex_unlock(&mutex_);
+}
+
+
+void Room::Close() {
+  Event e;
+  e.type = Event::kClose;
+  e.p = NULL;
+
+  uv_mutex_lock(&mutex_);
+  events_.push_back(e);
+  uv_mutex_unlock(&mutex_);
+}
+
+
+void Room::Apply(Event* e) {
+  if (e->type == Event::kJoin) {
+    participants_.push_back(e->p);
+  } else if (e->type == Event::kLeave) {
+    for (size_t i = 0; i < participants_.size(); i++) {
+      if (participants_[i] != e->p) continue;
+      participants_.erase(participants_.begin() + i);
+      break;
+    }
+    delete e->p;
+  } else if (e->type == Event::kPacket) {
+    mixer_->stats()->received.Inc();
+    if (!e->p->Enqueue(e->seq,
+                       e->level,
+                       reinterpret_cast<char*>(e->data),
+                       e->size)) {
+      mixer_->stats()->late.Inc();
+    }
+  } else if (e->type == Event::kClose) {
+    closed_ = true;
+  }
+}
+
+
+static bool LouderThan(Participant* a, Participant* b) {
+  return a->level < b->level;
+}
+
+
+bool Room::Tick(udp::Socket* socket, uint32_t ts) {
+  // Take events queued by event loop, reusing both buffers
+  pending_.clear();
+  uv_mutex_lock(&mutex_);
+  pending_.swap(events_);
+  uv_mutex_unlock(&mutex_);
+
+  for (size_t i = 0; i < pending_.size(); i++) Apply(&pending_[i]);
+  if (closed_) return false;
+
+  // Pick speakers by level, quiet and filtered out ones aren't decoded
+  uint8_t max_level = mixer_->max_level();
+  size_t max_speakers = mixer_->max_speakers();
+
+  speakers_.clear();
+  for (size_t i = 0; i < participants_.size(); i++) {
+    Participant* p = participants_[i];
+    p->speaking = false;
+    if (p->Pop() && p->level <= max_level) speakers_.push_back(p);
+  }
+
+  if (max_speakers > 0 && speakers_.size() > max_speakers) {
+    std::partial_sort(speakers_.begin(),
+                      speakers_.begin() + max_speakers,
+                      speakers_.end(),
+                      LouderThan);
+    speakers_.resize(max_speakers);
+  }
+
+  for (size_t i = 0; i < speakers_.size(); i++) {
+    if (speakers_[i]->Decode()) {
+      speakers_[i]->speaking = true;
+      continue;
+    }
+    speakers_.erase(speakers_.begin() + i);
+    i--;
+  }
+  if (speakers_.empty()) return true;
+
+  size_t samples = mixer_->frame_samples();
+  memset(mix_, 0, samples * sizeof(*mix_));
+  for (size_t i = 0; i < speakers_.size(); i++) {
+    audio::MixFloat(mix_, speakers_[i]->pcm, samples);
+  }
+
+  unsigned char packet[kMaxPacketSize];
+  out_.clear();
+
+  // Speakers hear everyone but themselves
+  // (nothing, if they are the only speaker)
+  for (size_t i = 0; speakers_.size() > 1 && i < speakers_.size(); i++) {
+    Participant* p = speakers_[i];
+
+    for (size_t j = 0; j < samples; j++) minus_[j] = mix_[j] - p->pcm[j];
+    audio::ClipFloat(minus_, samples);
+
+    opus_int32 size = p->codec.EncodeFloat(minus_,
+                                           samples,
+                                           packet,
+                                           sizeof(packet));
+    mixer_->stats()->encoded.Inc();
+    if (size > 0) Send(p, packet, size, ts);
+  }
+
+  // Everyone else hears the same mix, encode it only once
+  if (participants_.size() > speakers_.size()) {
+    audio::ClipFloat(mix_, samples);
+
+    opus_int32 size = shared_.EncodeFloat(mix_,
+                                          samples,
+                                          packet,
+                                          sizeof(packet));
+    mixer_->stats()->encoded.Inc();
+
+    for (size_t i = 0; size > 0 && i < participants_.size(); i++) {
+      if (!participants_[i]->speaking) Send(participants_[i], packet, size, ts);
+    }
+  }
+
+  if (!out_.empty()) {
+    int sent = socket->Send(&out_[0], out_.size());
+    if (sent > 0) mixer_->stats()->sent.Add(sent);
+  }
+
+  return true;
+}
+
+
+void Room::Send(Participant* p,
+                const unsigned char* data,
+                size_t size,
+                uint32_t ts) {
+  unsigned char* out = reinterpret_cast<unsigned char*>(p->out);
+
+  out[0] = relay::kMagic;
+  out[1] = relay::kVersion;
+  out[2] = relay::kMix;
+  out[3] = 0;
+  frame::WriteUInt32(out + 4, 0);
+
+  frame::Header header;
+  header.group = 1;
+  header.flags = 0;
+  header.seq = p->out_seq++;
+  header.ts = ts;
+  frame::WriteHeader(header, p->out + relay::kHeaderSize);
+
+  memcpy(out + kPayloadOffset, data, size);
+
+  udp::Datagram d;
+  d.data = p->out;
+  d.size = kPayloadOffset + size;
+  d.addr = p->addr;
+  out_.push_back(d);
+}
+
+} // namespace mcu
+} // namespace vock
@@ -0,0 +1,155 @@
+#ifndef _SRC_MCU_ROOM_H_
+#define _SRC_MCU_ROOM_H_
+
+#include "uv.h"
+#include "opus/codec.h"
+#include "udp/socket.h"
+#include "relay/relay.h"
+#include "frame/frame.h"
+
+#include <netinet/in.h> // sockaddr_in
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vock {
+namespace mcu {
+
+class Mixer;
+class Room;
+
+// MCU packets use relay header (relay::kPublish from clients,
+// relay::kMix back to them) followed by an unsealed binary frame with
+// Opus packet.
+static const size_t kPayloadOffset = relay::kHeaderSize + frame::kHeaderSize;
+static const size_t kMaxPacketSize = 1275;
+
+struct Participant {
+  Participant(const struct sockaddr_in& addr, Mixer* mixer);
+  ~Participant();
+
+  // Worker thread only.
+  // Enqueue returns false for late packets.
+  bool Enqueue(uint32_t seq, uint8_t level, const char* data, size_t size);
+
+  // Takes the next frame from queue, returns false if there is nothing
+  // to play. Only frames that will be mixed are decoded afterwards.
+  bool Pop();
+  bool Decode();
+
+  static const int kQueueSize = 8;
+
+  // Frames concealed before participant is considered silent
+  static const int kMaxConcealed = 3;
+
+  struct Slot {
+    bool used;
+    uint32_t seq;
+    uint8_t level;
+    size_t size;
+    unsigned char data[kMaxPacketSize];
+  };
+
+  struct sockaddr_in addr;
+  Mixer* mixer;
+  opus::Codec codec;
+
+  // Event loop thread only
+  Room* room;
+
+  // Jitter queue, indexed by seq
+  Slot queue[kQueueSize];
+  bool started;
+  int delay;
+  uint32_t next_seq;
+  int missing;
+
+  // Popped frame, NULL - conceal lost one
+  Slot* current;
+
+  // Last decoded frame
+  float* pcm;
+  uint8_t level;
+  bool speaking;
+
+  // Outgoing frames
+  uint32_t out_seq;
+  char out[kPayloadOffset + kMaxPacketSize];
+};
+
+// All participants of a room are mixed by one worker thread. Every
+// listener hears the mix of active speakers without its own voice
+// (mix-minus), listeners hearing the same mix share an encoder.
+class Room {
+ public:
+  Room(const std::string& id, Mixer* mixer);
+  ~Room();
+
+  // Event loop thread, takes ownership of participant
+  void Join(Participant* p);
+  void Leave(Participant* p);
+  void Push(Participant* p,
+            uint32_t seq,
+            uint8_t level,
+            const char* data,
+            size_t size);
+  void Close();
+
+  // Worker thread, returns false once room is closed and may be deleted
+  bool Tick(udp::Socket* socket, uint32_t ts);
+
+  inline const std::string& id() const { return id_; }
+
+  // Event loop thread only
+  int size;
+  int worker;
+
+ protected:
+  struct Event {
+    enum Type {
+      kJoin,
+      kLeave,
+      kPacket,
+      kClose
+    };
+
+    Type type;
+    Participant* p;
+    uint32_t seq;
+    uint8_t level;
+    size_t size;
+    unsigned char data[kMaxPacketSize];
+  };
+
+  void Apply(Event* e);
+  void Send(Participant* p,
+            const unsigned char* data,
+            size_t size,
+            uint32_t ts);
+
+  std::string id_;
+  Mixer* mixer_;
+
+  // Guarded by mutex_
+  uv_mutex_t mutex_;
+  std::vector<Event> events_;
+
+  // Worker thread only
+  std::vector<Event> pending_;
+  std::vector<Participant*> participants_;
+  std::vector<Participant*> speakers_;
+  std::vector<udp::Datagram> out_;
+  bool closed_;
+
+  // Encoder for listeners that aren't speaking,
+  // speakers are encoded with their own encoders
+  opus::Codec shared_;
+  float* mix_;
+  float* minus_;
+};
+
+} // namespace mcu
+} // namespace vock
+
+#endif // _SRC_MCU_ROOM_H_
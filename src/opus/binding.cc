@@ -18,29 +18,10 @@ using namespace v8;
     ThrowException(String::Concat(String::New("Opus error: "),\
                                   String::New(opus_strerror(err))))
 
-Opus::Opus(opus_int32 rate, int channels) : rate_(rate),
-                                            channels_(channels),
-                                            enc_(NULL),
-                                            dec_(NULL) {
-  int err;
+// Event loop thread only
+static Repacketizer* repacketizer;
 
-  enc_ = opus_encoder_create(rate, channels, OPUS_APPLICATION_VOIP, &err);
-  if (err != OPUS_OK) {
-    THROW_OPUS_ERROR(err);
-    return;
-  }
-
-  dec_ = opus_decoder_create(rate, channels, &err);
-  if (err != OPUS_OK) {
-    THROW_OPUS_ERROR(err);
-    return;
-  }
-}
-
-
-Opus::~Opus() {
-  if (enc_ != NULL) opus_encoder_destroy(enc_);
-  if (dec_ != NULL) opus_decoder_destroy(dec_);
+Opus::Opus(opus_int32 rate, int channels) : codec_(rate, channels) {
 }
 
 
@@ -52,6 +33,12 @@ Handle<Value> Opus::New(const Arguments& args) {
   }
 
   Opus* o = new Opus(args[0]->Int32Value(), args[1]->Int32Value());
+
+  int err = o->codec_.Init();
+  if (err != OPUS_OK) {
+    delete o;
+    return scope.Close(THROW_OPUS_ERROR(err));
+  }
   o->Wrap(args.Holder());
 
   return scope.Close(args.This());
@@ -80,11 +67,10 @@ Handle<Value> Opus::Encode(const Arguments& args) {
 
   opus_int32 ret;
 
-  ret = opus_encode(o->enc_,
-                    reinterpret_cast<opus_int16*>(data),
-                    len / sizeof(opus_int16),
-                    out,
-                    sizeof(out));
+  ret = o->codec_.Encode(reinterpret_cast<opus_int16*>(data),
+                         len / sizeof(opus_int16),
+                         out,
+                         sizeof(out));
   if (ret < 0) {
     return scope.Close(THROW_OPUS_ERROR(ret));
   }
@@ -121,12 +107,84 @@ Handle<Value> Opus::Decode(const Arguments& args) {
   opus_int16 out[10 * 1024];
   opus_int16 ret;
 
-  ret = opus_decode(o->dec_,
-                    reinterpret_cast<const unsigned char*>(data),
-                    len,
-                    out,
-                    sizeof(out) / sizeof(out[0]),
-                    0);
+  ret = o->codec_.Decode(reinterpret_cast<const unsigned char*>(data),
+                         len,
+                         out,
+                         sizeof(out) / sizeof(out[0]),
+                         args.Length() >= 2 && args[1]->IsTrue());
+  if (ret < 0) {
+    return scope.Close(THROW_OPUS_ERROR(ret));
+  }
+
+  return scope.Close(Buffer::New(reinterpret_cast<char*>(out),
+                                 ret * sizeof(out[0]))->handle_);
+}
+
+
+Handle<Value> Opus::EncodeFloat(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !Buffer::HasInstance(args[0])) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Buffer")));
+  }
+
+  char* data = Buffer::Data(args[0].As<Object>());
+  size_t len = Buffer::Length(args[0].As<Object>());
+
+  if ((len % sizeof(float)) != 0) {
+    return scope.Close(ThrowException(String::New(
+            "Buffer has incorrect size!")));
+  }
+
+  unsigned char out[4096];
+
+  opus_int32 ret;
+
+  ret = o->codec_.EncodeFloat(reinterpret_cast<float*>(data),
+                              len / sizeof(float),
+                              out,
+                              sizeof(out));
+  if (ret < 0) {
+    return scope.Close(THROW_OPUS_ERROR(ret));
+  }
+
+  return scope.Close(Buffer::New(reinterpret_cast<char*>(out), ret)->handle_);
+}
+
+
+Handle<Value> Opus::DecodeFloat(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 ||
+      (!Buffer::HasInstance(args[0]) && !args[0]->IsNull())) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Buffer")));
+  }
+
+  char* data;
+  size_t len;
+
+  if (Buffer::HasInstance(args[0])) {
+    data = Buffer::Data(args[0].As<Object>());
+    len = Buffer::Length(args[0].As<Object>());
+  } else {
+    data = NULL;
+    len = 0;
+  }
+
+  float out[5 * 1024];
+  int ret;
+
+  ret = o->codec_.DecodeFloat(reinterpret_cast<const unsigned char*>(data),
+                              len,
+                              out,
+                              sizeof(out) / sizeof(out[0]),
+                              args.Length() >= 2 && args[1]->IsTrue());
   if (ret < 0) {
     return scope.Close(THROW_OPUS_ERROR(ret));
   }
@@ -147,7 +205,64 @@ Handle<Value> Opus::SetBitrate(const Arguments& args) {
   }
 
   // TODO: Consider checking return value there?
-  opus_encoder_ctl(o->enc_, OPUS_SET_BITRATE(args[0]->Int32Value()));
+  o->codec_.SetBitrate(args[0]->Int32Value());
+
+  return scope.Close(Null());
+}
+
+
+// setFec(enabled)
+// Toggles in-band forward error correction
+Handle<Value> Opus::SetFec(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsBoolean()) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Boolean")));
+  }
+
+  int err = o->codec_.SetFec(args[0]->IsTrue());
+  if (err != OPUS_OK) return scope.Close(THROW_OPUS_ERROR(err));
+
+  return scope.Close(Null());
+}
+
+
+// setPacketLoss(percent)
+// Expected packet loss, encoder spends more bits on redundancy for higher ones
+Handle<Value> Opus::SetPacketLoss(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Number")));
+  }
+
+  int err = o->codec_.SetPacketLoss(args[0]->Int32Value());
+  if (err != OPUS_OK) return scope.Close(THROW_OPUS_ERROR(err));
+
+  return scope.Close(Null());
+}
+
+
+// setComplexity(complexity)
+// Encoder complexity, 0-10
+Handle<Value> Opus::SetComplexity(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Number")));
+  }
+
+  int err = o->codec_.SetComplexity(args[0]->Int32Value());
+  if (err != OPUS_OK) return scope.Close(THROW_OPUS_ERROR(err));
 
   return scope.Close(Null());
 }
@@ -163,12 +278,105 @@ void Opus::Init(Handle<Object> target) {
 
   NODE_SET_PROTOTYPE_METHOD(t, "encode", Opus::Encode);
   NODE_SET_PROTOTYPE_METHOD(t, "decode", Opus::Decode);
+  NODE_SET_PROTOTYPE_METHOD(t, "encodeFloat", Opus::EncodeFloat);
+  NODE_SET_PROTOTYPE_METHOD(t, "decodeFloat", Opus::DecodeFloat);
   NODE_SET_PROTOTYPE_METHOD(t, "setBitrate", Opus::SetBitrate);
+  NODE_SET_PROTOTYPE_METHOD(t, "setFec", Opus::SetFec);
+  NODE_SET_PROTOTYPE_METHOD(t, "setPacketLoss", Opus::SetPacketLoss);
+  NODE_SET_PROTOTYPE_METHOD(t, "setComplexity", Opus::SetComplexity);
 
   target->Set(String::NewSymbol("Opus"), t->GetFunction());
 }
 
 
+// opusMerge([packets])
+// Returns multi-frame packet or null if packets can't be merged
+Handle<Value> Packet::Merge(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 1 || !args[0]->IsArray()) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Array")));
+  }
+
+  Local<Array> list = args[0].As<Array>();
+  const unsigned char* packets[48];
+  opus_int32 sizes[48];
+  int count = list->Length();
+
+  // Opus packet can't have more than 48 frames
+  if (count == 0 || count > 48) {
+    return scope.Close(ThrowException(String::New(
+            "Array should have 1-48 packets")));
+  }
+
+  for (int i = 0; i < count; i++) {
+    Local<Value> packet = list->Get(i);
+    if (!Buffer::HasInstance(packet)) {
+      return scope.Close(ThrowException(String::New(
+              "Array should contain only Buffers")));
+    }
+
+    packets[i] = reinterpret_cast<unsigned char*>(
+        Buffer::Data(packet.As<Object>()));
+    sizes[i] = Buffer::Length(packet.As<Object>());
+  }
+
+  unsigned char out[4096];
+  opus_int32 ret = repacketizer->Merge(packets, sizes, count, out, sizeof(out));
+  if (ret < 0) return scope.Close(Null());
+
+  return scope.Close(Buffer::New(reinterpret_cast<char*>(out), ret)->handle_);
+}
+
+
+// opusSplit(packet)
+// Returns array of single frame packets or null if packet is corrupted
+Handle<Value> Packet::Split(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 1 || !Buffer::HasInstance(args[0])) {
+    return scope.Close(ThrowException(String::New(
+            "First argument should be Buffer")));
+  }
+
+  const unsigned char* data = reinterpret_cast<unsigned char*>(
+      Buffer::Data(args[0].As<Object>()));
+  opus_int32 len = Buffer::Length(args[0].As<Object>());
+
+  int count = repacketizer->Split(data, len);
+  if (count < 0) return scope.Close(Null());
+
+  Local<Array> res = Array::New(count);
+
+  // Nothing to split
+  if (count == 1) {
+    res->Set(0, args[0]);
+    return scope.Close(res);
+  }
+
+  for (int i = 0; i < count; i++) {
+    unsigned char out[1500];
+    opus_int32 ret = repacketizer->Frame(i, out, sizeof(out));
+    if (ret < 0) return scope.Close(Null());
+
+    res->Set(i, Buffer::New(reinterpret_cast<char*>(out), ret)->handle_);
+  }
+
+  return scope.Close(res);
+}
+
+
+void Packet::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  repacketizer = new Repacketizer();
+
+  NODE_SET_METHOD(target, "opusMerge", Packet::Merge);
+  NODE_SET_METHOD(target, "opusSplit", Packet::Split);
+}
+
+
 NODE_MODULE(opus, Opus::Init);
 
 } // namespace opus
@@ -5,6 +5,7 @@
 #include "v8.h"
 #include "node_object_wrap.h"
 #include "opus.h"
+#include "codec.h"
 
 namespace vock {
 namespace opus {
@@ -14,20 +15,29 @@ using namespace node;
 class Opus : public ObjectWrap {
  public:
   Opus(opus_int32 rate, int channels);
-  ~Opus();
 
   static void Init(v8::Handle<v8::Object> target);
 
   static v8::Handle<v8::Value> New(const v8::Arguments& args);
   static v8::Handle<v8::Value> Encode(const v8::Arguments& args);
   static v8::Handle<v8::Value> Decode(const v8::Arguments& args);
+  static v8::Handle<v8::Value> EncodeFloat(const v8::Arguments& args);
+  static v8::Handle<v8::Value> DecodeFloat(const v8::Arguments& args);
   static v8::Handle<v8::Value> SetBitrate(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetFec(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetPacketLoss(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetComplexity(const v8::Arguments& args);
 
  protected:
-  opus_int32 rate_;
-  int channels_;
-  OpusEncoder* enc_;
-  OpusDecoder* dec_;
+  Codec codec_;
+};
+
+class Packet {
+ public:
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> Merge(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Split(const v8::Arguments& args);
 };
 
 } // namespace opus
@@ -0,0 +1,150 @@
+#include "codec.h"
+#include "opus.h"
+
+#include <stdio.h> // fprintf
+#include <stdlib.h> // NULL, abort
+
+namespace vock {
+namespace opus {
+
+Codec::Codec(opus_int32 rate, int channels) : rate_(rate),
+                                              channels_(channels),
+                                              enc_(NULL),
+                                              dec_(NULL) {
+}
+
+
+Codec::~Codec() {
+  if (enc_ != NULL) opus_encoder_destroy(enc_);
+  if (dec_ != NULL) opus_decoder_destroy(dec_);
+}
+
+
+int Codec::Init() {
+  int err;
+
+  enc_ = opus_encoder_create(rate_, channels_, OPUS_APPLICATION_VOIP, &err);
+  if (err != OPUS_OK) return err;
+
+  return InitDecoder();
+}
+
+
+int Codec::InitDecoder() {
+  int err;
+
+  dec_ = opus_decoder_create(rate_, channels_, &err);
+  if (err != OPUS_OK) return err;
+
+  return OPUS_OK;
+}
+
+
+opus_int32 Codec::Encode(const opus_int16* pcm,
+                         int samples,
+                         unsigned char* out,
+                         opus_int32 size) {
+  return opus_encode(enc_, pcm, samples / channels_, out, size);
+}
+
+
+opus_int32 Codec::EncodeFloat(const float* pcm,
+                              int samples,
+                              unsigned char* out,
+                              opus_int32 size) {
+  return opus_encode_float(enc_, pcm, samples / channels_, out, size);
+}
+
+
+int Codec::Decode(const unsigned char* data,
+                  opus_int32 len,
+                  opus_int16* out,
+                  int max_samples,
+                  bool fec) {
+  return opus_decode(dec_, data, len, out, max_samples / channels_, fec);
+}
+
+
+int Codec::DecodeFloat(const unsigned char* data,
+                       opus_int32 len,
+                       float* out,
+                       int max_samples,
+                       bool fec) {
+  return opus_decode_float(dec_,
+                           data,
+                           len,
+                           out,
+                           max_samples / channels_,
+                           fec);
+}
+
+
+int Codec::ResetDecoder() {
+  return opus_decoder_ctl(dec_, OPUS_RESET_STATE);
+}
+
+
+int Codec::SetBitrate(opus_int32 bitrate) {
+  return opus_encoder_ctl(enc_, OPUS_SET_BITRATE(bitrate));
+}
+
+
+int Codec::SetFec(bool enabled) {
+  return opus_encoder_ctl(enc_, OPUS_SET_INBAND_FEC(enabled ? 1 : 0));
+}
+
+
+int Codec::SetPacketLoss(int percent) {
+  return opus_encoder_ctl(enc_, OPUS_SET_PACKET_LOSS_PERC(percent));
+}
+
+
+int Codec::SetComplexity(int complexity) {
+  return opus_encoder_ctl(enc_, OPUS_SET_COMPLEXITY(complexity));
+}
+
+
+Repacketizer::Repacketizer() : rp_(opus_repacketizer_create()) {
+  if (rp_ == NULL) {
+    fprintf(stderr, "Failed to allocate repacketizer!\n");
+    abort();
+  }
+}
+
+
+Repacketizer::~Repacketizer() {
+  opus_repacketizer_destroy(rp_);
+}
+
+
+opus_int32 Repacketizer::Merge(const unsigned char* const* packets,
+                               const opus_int32* sizes,
+                               int count,
+                               unsigned char* out,
+                               opus_int32 size) {
+  opus_repacketizer_init(rp_);
+  for (int i = 0; i < count; i++) {
+    int r = opus_repacketizer_cat(rp_, packets[i], sizes[i]);
+    if (r != OPUS_OK) return r;
+  }
+
+  return opus_repacketizer_out(rp_, out, size);
+}
+
+
+int Repacketizer::Split(const unsigned char* data, opus_int32 len) {
+  opus_repacketizer_init(rp_);
+
+  int r = opus_repacketizer_cat(rp_, data, len);
+  if (r != OPUS_OK) return r;
+
+  return opus_repacketizer_get_nb_frames(rp_);
+}
+
+
+opus_int32 Repacketizer::Frame(int index, unsigned char* out, opus_int32 size) {
+  return opus_repacketizer_out_range(rp_, index, index + 1, out, size);
+}
+
+} // namespace opus
+} // namespace vock
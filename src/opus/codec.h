@@ -0,0 +1,97 @@
+#ifndef _SRC_OPUS_CODEC_H_
+#define _SRC_OPUS_CODEC_H_
+
+#include "opus.h"
+
+namespace vock {
+namespace opus {
+
+// Encoder/decoder pair without any V8 dependencies,
+// shared by the `Opus` binding and native benchmarks.
+class Codec {
+ public:
+  Codec(opus_int32 rate, int channels);
+  ~Codec();
+
+  // Returns OPUS_OK or opus error code
+  int Init();
+
+  // Same as above, for playback-only codecs
+  int InitDecoder();
+
+  opus_int32 Encode(const opus_int16* pcm,
+                    int samples,
+                    unsigned char* out,
+                    opus_int32 size);
+  opus_int32 EncodeFloat(const float* pcm,
+                         int samples,
+                         unsigned char* out,
+                         opus_int32 size);
+
+  // `data` may be NULL to conceal a lost packet.
+  // With `fec` set, previous (lost) frame is recovered from redundancy
+  // data in `data` instead of decoding it
+  int Decode(const unsigned char* data,
+             opus_int32 len,
+             opus_int16* out,
+             int max_samples,
+             bool fec = false);
+  int DecodeFloat(const unsigned char* data,
+                  opus_int32 len,
+                  float* out,
+                  int max_samples,
+                  bool fec = false);
+
+  // Drops decoder's state (i.e. when a channel is reused for another peer)
+  int ResetDecoder();
+
+  int SetBitrate(opus_int32 bitrate);
+  int SetFec(bool enabled);
+  int SetPacketLoss(int percent);
+  int SetComplexity(int complexity);
+
+  inline opus_int32 rate() const { return rate_; }
+  inline int channels() const { return channels_; }
+  inline OpusEncoder* encoder() const { return enc_; }
+  inline OpusDecoder* decoder() const { return dec_; }
+
+ protected:
+  opus_int32 rate_;
+  int channels_;
+  OpusEncoder* enc_;
+  OpusDecoder* dec_;
+};
+
+// Merges consecutive packets of one stream into a single multi-frame
+// packet and splits such packets back into single frame ones.
+// Packets can be merged only if they were encoded with the same
+// mode, bandwidth and frame size, up to 120 ms in total.
+class Repacketizer {
+ public:
+  Repacketizer();
+  ~Repacketizer();
+
+  // Returns size of merged packet or opus error code
+  // (OPUS_INVALID_PACKET if packets can't be merged)
+  opus_int32 Merge(const unsigned char* const* packets,
+                   const opus_int32* sizes,
+                   int count,
+                   unsigned char* out,
+                   opus_int32 size);
+
+  // Returns number of frames in `data` or opus error code,
+  // `data` must stay intact until the last Frame() call
+  int Split(const unsigned char* data, opus_int32 len);
+
+  // Writes `index`th frame of the split packet as a standalone packet,
+  // returns its size or opus error code
+  opus_int32 Frame(int index, unsigned char* out, opus_int32 size);
+
+ protected:
+  OpusRepacketizer* rp_;
+};
+
+} // namespace opus
+} // namespace vock
+
+#endif // _SRC_OPUS_CODEC_H_
@@ -0,0 +1,278 @@
+#include "binding.h"
+#include "relay.h"
+
+#include "node.h"
+#include "node_buffer.h"
+
+#include <arpa/inet.h> // inet_pton, inet_ntop
+#include <string.h> // memset
+#include <stdlib.h> // abort
+
+namespace vock {
+namespace relay {
+
+using namespace node;
+using namespace v8;
+
+static Persistent<String> onmessages_sym;
+
+#define UNWRAP\
+    Server* s = ObjectWrap::Unwrap<Server>(args.This());
+
+Server::Server() : poll_(NULL) {
+}
+
+
+Server::~Server() {
+  DoClose();
+}
+
+
+static void OnPollClose(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_poll_t*>(handle);
+}
+
+
+// Parses (address, port) pair of arguments
+static bool ParseAddress(const Arguments& args, struct sockaddr_in* addr) {
+  if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsNumber()) {
+    return false;
+  }
+
+  String::AsciiValue address(args[0]);
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(args[1]->Uint32Value());
+
+  return *address != NULL && inet_pton(AF_INET, *address, &addr->sin_addr) == 1;
+}
+
+
+void Server::DoClose() {
+  if (poll_ != NULL) {
+    uv_poll_stop(poll_);
+    uv_close(reinterpret_cast<uv_handle_t*>(poll_), OnPollClose);
+    poll_ = NULL;
+  }
+  socket_.Close();
+}
+
+
+Handle<Value> Server::New(const Arguments& args) {
+  HandleScope scope;
+
+  Server* s = new Server();
+  s->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+
+// bind(port)
+// Returns bound port number
+Handle<Value> Server::Bind(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number!")));
+  }
+
+  if (s->poll_ != NULL) {
+    return scope.Close(ThrowException(String::New(
+        "Server is already bound!")));
+  }
+
+  int r = s->socket_.Bind(args[0]->Uint32Value());
+  if (r != 0) return scope.Close(ThrowException(ErrnoException(-r, "bind")));
+
+  uint16_t port;
+  r = s->socket_.GetPort(&port);
+  if (r != 0) {
+    s->socket_.Close();
+    return scope.Close(ThrowException(ErrnoException(-r, "getsockname")));
+  }
+
+  s->poll_ = new uv_poll_t();
+  s->poll_->data = s;
+  if (uv_poll_init_socket(uv_default_loop(), s->poll_, s->socket_.fd()) ||
+      uv_poll_start(s->poll_, UV_READABLE, OnPoll)) {
+    abort();
+  }
+
+  // Keep object alive while socket is open
+  s->Ref();
+
+  return scope.Close(Number::New(port));
+}
+
+
+// join(address, port, room, source)
+// Adds member to the room (moving it from the previous one)
+Handle<Value> Server::Join(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  struct sockaddr_in addr;
+  if (!ParseAddress(args, &addr) ||
+      args.Length() < 4 ||
+      !args[2]->IsString() ||
+      !args[3]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be address, port, room and source!")));
+  }
+
+  String::Utf8Value room(args[2]);
+  s->relay_.Join(addr, std::string(*room, room.length()),
+                 args[3]->Uint32Value());
+
+  return scope.Close(Null());
+}
+
+
+// leave(address, port)
+Handle<Value> Server::Leave(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  struct sockaddr_in addr;
+  if (!ParseAddress(args, &addr)) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be address and port!")));
+  }
+
+  s->relay_.Leave(addr);
+
+  return scope.Close(Null());
+}
+
+
+// setFilter(maxLevel, maxSpeakers)
+Handle<Value> Server::SetFilter(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "Both arguments should be numbers!")));
+  }
+
+  uint32_t max_level = args[0]->Uint32Value();
+  if (max_level > kSilence) max_level = kSilence;
+
+  s->relay_.SetFilter(max_level, args[1]->Int32Value());
+
+  return scope.Close(Null());
+}
+
+
+Handle<Value> Server::GetStats(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  Stats* stats = s->relay_.stats();
+  Local<Object> res = Object::New();
+
+  res->Set(String::NewSymbol("received"),
+           Number::New(static_cast<double>(stats->received)));
+  res->Set(String::NewSymbol("forwarded"),
+           Number::New(static_cast<double>(stats->forwarded)));
+  res->Set(String::NewSymbol("filtered"),
+           Number::New(static_cast<double>(stats->filtered)));
+  res->Set(String::NewSymbol("unknown"),
+           Number::New(static_cast<double>(stats->unknown)));
+
+  return scope.Close(res);
+}
+
+
+Handle<Value> Server::Close(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (s->poll_ != NULL) {
+    s->DoClose();
+    s->Unref();
+  }
+
+  return scope.Close(Null());
+}
+
+
+void Server::OnPoll(uv_poll_t* handle, int status, int events) {
+  HandleScope scope;
+  Server* s = reinterpret_cast<Server*>(handle->data);
+  udp::Datagram datagrams[udp::Socket::kBatchSize];
+
+  if (status != 0) return;
+
+  while (s->poll_ != NULL) {
+    int count = s->socket_.Receive(datagrams);
+    if (count <= 0) break;
+
+    // Media is forwarded without leaving C++
+    s->relay_.Process(&s->socket_, datagrams, count, uv_hrtime());
+
+    // Everything else (control messages) goes to JS
+    int control = 0;
+    for (int i = 0; i < count; i++) {
+      if (!Relay::IsRelayPacket(datagrams[i])) control++;
+    }
+    if (control == 0) continue;
+
+    Local<Array> buffers = Array::New(control);
+    Local<Array> addresses = Array::New(control);
+    Local<Array> ports = Array::New(control);
+
+    for (int i = 0, j = 0; i < count; i++) {
+      if (Relay::IsRelayPacket(datagrams[i])) continue;
+
+      char address[INET_ADDRSTRLEN];
+      Buffer* buffer = Buffer::New(datagrams[i].data, datagrams[i].size);
+
+      inet_ntop(AF_INET,
+                &datagrams[i].addr.sin_addr,
+                address,
+                sizeof(address));
+      buffers->Set(j, buffer->handle_);
+      addresses->Set(j, String::New(address));
+      ports->Set(j, Number::New(ntohs(datagrams[i].addr.sin_port)));
+      j++;
+    }
+
+    Handle<Value> argv[3] = { buffers, addresses, ports };
+    MakeCallback(s->handle_, onmessages_sym, 3, argv);
+  }
+}
+
+
+void Server::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  onmessages_sym = Persistent<String>::New(String::NewSymbol("onmessages"));
+
+  Local<FunctionTemplate> t = FunctionTemplate::New(Server::New);
+
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->SetClassName(String::NewSymbol("RelayServer"));
+
+  NODE_SET_PROTOTYPE_METHOD(t, "bind", Server::Bind);
+  NODE_SET_PROTOTYPE_METHOD(t, "join", Server::Join);
+  NODE_SET_PROTOTYPE_METHOD(t, "leave", Server::Leave);
+  NODE_SET_PROTOTYPE_METHOD(t, "setFilter", Server::SetFilter);
+  NODE_SET_PROTOTYPE_METHOD(t, "getStats", Server::GetStats);
+  NODE_SET_PROTOTYPE_METHOD(t, "close", Server::Close);
+
+  target->Set(String::NewSymbol("RelayServer"), t->GetFunction());
+}
+
+} // namespace relay
+} // namespace vock
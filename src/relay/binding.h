@@ -0,0 +1,43 @@
+#ifndef _SRC_RELAY_BINDING_H_
+#define _SRC_RELAY_BINDING_H_
+
+#include "node.h"
+#include "v8.h"
+#include "node_object_wrap.h"
+#include "relay.h"
+#include "udp/socket.h"
+
+namespace vock {
+namespace relay {
+
+using namespace node;
+
+class Server : public ObjectWrap {
+ public:
+  Server();
+  ~Server();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> New(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Bind(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Join(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Leave(const v8::Arguments& args);
+  static v8::Handle<v8::Value> SetFilter(const v8::Arguments& args);
+  static v8::Handle<v8::Value> GetStats(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Close(const v8::Arguments& args);
+
+  static void OnPoll(uv_poll_t* handle, int status, int events);
+
+ protected:
+  void DoClose();
+
+  udp::Socket socket_;
+  uv_poll_t* poll_;
+  Relay relay_;
+};
+
+} // namespace relay
+} // namespace vock
+
+#endif // _SRC_RELAY_BINDING_H_
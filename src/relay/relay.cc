@@ -0,0 +1,179 @@
+#include "relay.h"
+
+#include <string.h> // memset
+
+namespace vock {
+namespace relay {
+
+Relay::Relay() : max_level_(kSilence), max_speakers_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+
+Relay::~Relay() {
+  for (MemberMap::iterator it = members_.begin(); it != members_.end(); it++) {
+    delete it->second;
+  }
+  for (RoomMap::iterator it = rooms_.begin(); it != rooms_.end(); it++) {
+    delete it->second;
+  }
+}
+
+
+uint64_t Relay::AddrKey(const struct sockaddr_in& addr) {
+  return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+
+void Relay::Join(const struct sockaddr_in& addr,
+                 const std::string& room,
+                 uint32_t source) {
+  MemberMap::iterator it = members_.find(AddrKey(addr));
+
+  // Rejoin (keepalive) or room change
+  if (it != members_.end()) {
+    if (it->second->room->id == room) {
+      it->second->source = source;
+      return;
+    }
+    Leave(addr);
+  }
+
+  Room* r;
+  RoomMap::iterator rit = rooms_.find(room);
+  if (rit == rooms_.end()) {
+    r = new Room();
+    r->id = room;
+    rooms_[room] = r;
+  } else {
+    r = rit->second;
+  }
+
+  Member* m = new Member();
+  m->addr = addr;
+  m->source = source;
+  m->room = r;
+  m->level = kSilence;
+  m->level_time = 0;
+  m->filtered = false;
+
+  r->members.push_back(m);
+  members_[AddrKey(addr)] = m;
+}
+
+
+void Relay::Leave(const struct sockaddr_in& addr) {
+  MemberMap::iterator it = members_.find(AddrKey(addr));
+  if (it == members_.end()) return;
+
+  Member* m = it->second;
+  Room* r = m->room;
+
+  for (size_t i = 0; i < r->members.size(); i++) {
+    if (r->members[i] != m) continue;
+    r->members.erase(r->members.begin() + i);
+    break;
+  }
+
+  if (r->members.empty()) {
+    rooms_.erase(r->id);
+    delete r;
+  }
+
+  members_.erase(it);
+  delete m;
+}
+
+
+void Relay::SetFilter(uint8_t max_level, int max_speakers) {
+  max_level_ = max_level;
+  max_speakers_ = max_speakers;
+}
+
+
+bool Relay::IsRelayPacket(const Datagram& d) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(d.data);
+  return d.size >= kHeaderSize && p[0] == kMagic && p[1] == kVersion;
+}
+
+
+bool Relay::ShouldForward(Member* member, uint64_t now) {
+  if (member->level > max_level_) return false;
+  if (max_speakers_ == 0) return true;
+
+  // Count active speakers that are louder
+  int rank = 0;
+  std::vector<Member*>& members = member->room->members;
+  for (size_t i = 0; i < members.size(); i++) {
+    Member* other = members[i];
+    if (other == member || now - other->level_time > kLevelTimeout) continue;
+
+    if (other->level < member->level ||
+        (other->level == member->level && other->source < member->source)) {
+      rank++;
+    }
+  }
+
+  return rank < max_speakers_;
+}
+
+
+int Relay::Process(udp::Socket* socket,
+                   Datagram* in,
+                   int count,
+                   uint64_t now) {
+  out_.clear();
+
+  for (int i = 0; i < count; i++) {
+    Datagram& d = in[i];
+    if (!IsRelayPacket(d)) continue;
+
+    stats_.received++;
+
+    unsigned char* p = reinterpret_cast<unsigned char*>(d.data);
+    MemberMap::iterator it = members_.find(AddrKey(d.addr));
+    if (it == members_.end() || p[2] != kPublish) {
+      stats_.unknown++;
+      continue;
+    }
+
+    Member* m = it->second;
+    m->level = p[3];
+    m->level_time = now;
+
+    if (!ShouldForward(m, now)) {
+      m->filtered = true;
+      stats_.filtered++;
+      continue;
+    }
+
+    // Rewrite header once, the same bytes go to every subscriber
+    p[2] = m->filtered ? kResume : kForward;
+    m->filtered = false;
+    p[4] = (m->source >> 24) & 0xff;
+    p[5] = (m->source >> 16) & 0xff;
+    p[6] = (m->source >> 8) & 0xff;
+    p[7] = m->source & 0xff;
+
+    std::vector<Member*>& members = m->room->members;
+    for (size_t j = 0; j < members.size(); j++) {
+      if (members[j] == m) continue;
+
+      Datagram o;
+      o.data = d.data;
+      o.size = d.size;
+      o.addr = members[j]->addr;
+      out_.push_back(o);
+    }
+  }
+
+  if (out_.empty()) return 0;
+
+  int sent = socket->Send(&out_[0], out_.size());
+  if (sent > 0) stats_.forwarded += sent;
+
+  return sent;
+}
+
+} // namespace relay
+} // namespace vock
@@ -0,0 +1,121 @@
+#ifndef _SRC_RELAY_RELAY_H_
+#define _SRC_RELAY_RELAY_H_
+
+#include "udp/socket.h"
+
+#include <netinet/in.h> // sockaddr_in
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vock {
+namespace relay {
+
+using udp::Datagram;
+
+// Relay packet layout (all numbers are big-endian):
+//
+//   0      1         2    3       4            8
+//   | 0xc2 | version | op | level | source u32 | sealed frame...
+//
+// Relay only looks at this header, frame is sealed with sender's
+// media key and is opaque to it.
+static const uint8_t kMagic = 0xc2;
+static const uint8_t kVersion = 1;
+static const size_t kHeaderSize = 8;
+
+enum Op {
+  kPublish = 1,
+  kForward = 2,
+
+  // Mixed stream from MCU (see mcu/room.h)
+  kMix = 3,
+
+  // Forward, previous frames of the source were filtered out: receivers
+  // shouldn't take the gap in seq for loss
+  kResume = 4
+};
+
+// Speaker level is in -dBov (RFC 6464): 0 - loudest, 127 - silence
+static const uint8_t kSilence = 127;
+
+struct Member;
+
+struct Room {
+  std::string id;
+  std::vector<Member*> members;
+};
+
+struct Member {
+  struct sockaddr_in addr;
+  uint32_t source;
+  Room* room;
+
+  // Level of the last published packet and when it was received
+  uint8_t level;
+  uint64_t level_time;
+
+  // Some of its packets were filtered out since the last forwarded one
+  bool filtered;
+};
+
+struct Stats {
+  uint64_t received;
+  uint64_t forwarded;
+  uint64_t filtered;
+  uint64_t unknown;
+};
+
+// Selective forwarding unit: every packet published by a room member
+// is forwarded to all other members of the room, with nothing more than
+// a header rewrite.
+class Relay {
+ public:
+  Relay();
+  ~Relay();
+
+  void Join(const struct sockaddr_in& addr,
+            const std::string& room,
+            uint32_t source);
+  void Leave(const struct sockaddr_in& addr);
+
+  // Packets quieter than `max_level` are dropped, and only `max_speakers`
+  // loudest members of room are forwarded (0 - everyone)
+  void SetFilter(uint8_t max_level, int max_speakers);
+
+  static bool IsRelayPacket(const Datagram& d);
+
+  // Forwards relay packets from `in` through `socket`,
+  // returns number of datagrams sent
+  int Process(udp::Socket* socket, Datagram* in, int count, uint64_t now);
+
+  inline Stats* stats() { return &stats_; }
+
+ protected:
+  typedef std::map<uint64_t, Member*> MemberMap;
+  typedef std::map<std::string, Room*> RoomMap;
+
+  // Member stays an active speaker for this long after its last packet
+  static const uint64_t kLevelTimeout = 500 * 1000000ULL;
+
+  static uint64_t AddrKey(const struct sockaddr_in& addr);
+  bool ShouldForward(Member* member, uint64_t now);
+
+  MemberMap members_;
+  RoomMap rooms_;
+
+  uint8_t max_level_;
+  int max_speakers_;
+
+  Stats stats_;
+
+  // Outgoing batch, datagrams point into the incoming batch
+  std::vector<Datagram> out_;
+};
+
+} // namespace relay
+} // namespace vock
+
+#endif // _SRC_RELAY_RELAY_H_
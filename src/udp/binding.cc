@@ -0,0 +1,241 @@
+#include "binding.h"
+#include "socket.h"
+
+#include "node.h"
+#include "node_buffer.h"
+
+#include <arpa/inet.h> // inet_pton, inet_ntop
+#include <string.h> // memset
+#include <stdlib.h> // abort
+
+namespace vock {
+namespace udp {
+
+using namespace node;
+using namespace v8;
+
+static Persistent<String> onmessages_sym;
+
+#define UNWRAP\
+    Udp* u = ObjectWrap::Unwrap<Udp>(args.This());
+
+Udp::Udp() : poll_(NULL) {
+}
+
+
+Udp::~Udp() {
+  DoClose();
+}
+
+
+static void OnPollClose(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_poll_t*>(handle);
+}
+
+
+void Udp::DoClose() {
+  if (poll_ != NULL) {
+    uv_poll_stop(poll_);
+    uv_close(reinterpret_cast<uv_handle_t*>(poll_), OnPollClose);
+    poll_ = NULL;
+  }
+  socket_.Close();
+}
+
+
+Handle<Value> Udp::New(const Arguments& args) {
+  HandleScope scope;
+
+  Udp* u = new Udp();
+  u->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+
+// bind(port)
+// Returns bound port number
+Handle<Value> Udp::Bind(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    return scope.Close(ThrowException(String::New(
+        "First argument should be a number!")));
+  }
+
+  if (u->poll_ != NULL) {
+    return scope.Close(ThrowException(String::New(
+        "Socket is already bound!")));
+  }
+
+  int r = u->socket_.Bind(args[0]->Uint32Value());
+  if (r != 0) return scope.Close(ThrowException(ErrnoException(-r, "bind")));
+
+  uint16_t port;
+  r = u->socket_.GetPort(&port);
+  if (r != 0) {
+    u->socket_.Close();
+    return scope.Close(ThrowException(ErrnoException(-r, "getsockname")));
+  }
+
+  u->poll_ = new uv_poll_t();
+  u->poll_->data = u;
+  if (uv_poll_init_socket(uv_default_loop(), u->poll_, u->socket_.fd()) ||
+      uv_poll_start(u->poll_, UV_READABLE, OnPoll)) {
+    abort();
+  }
+
+  // Keep object alive while socket is open
+  u->Ref();
+
+  return scope.Close(Number::New(port));
+}
+
+
+// send(buffers, ports, addresses)
+// Sends datagrams with as few syscalls as possible,
+// returns number of sent datagrams or -errno
+Handle<Value> Udp::Send(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (args.Length() < 3 ||
+      !args[0]->IsArray() ||
+      !args[1]->IsArray() ||
+      !args[2]->IsArray()) {
+    return scope.Close(ThrowException(String::New(
+        "Arguments should be Arrays!")));
+  }
+
+  Local<Array> buffers = args[0].As<Array>();
+  Local<Array> ports = args[1].As<Array>();
+  Local<Array> addresses = args[2].As<Array>();
+  int count = buffers->Length();
+
+  if (ports->Length() != buffers->Length() ||
+      addresses->Length() != buffers->Length()) {
+    return scope.Close(ThrowException(String::New(
+        "Arrays should have the same length!")));
+  }
+
+  if (u->poll_ == NULL) {
+    return scope.Close(ThrowException(String::New("Socket isn't bound!")));
+  }
+
+  Datagram datagrams[Socket::kBatchSize];
+  int sent = 0;
+  int err = 0;
+
+  for (int start = 0; start < count; start += Socket::kBatchSize) {
+    int batch = count - start;
+    if (batch > Socket::kBatchSize) batch = Socket::kBatchSize;
+
+    int valid = 0;
+    for (int i = 0; i < batch; i++) {
+      Local<Value> buffer = buffers->Get(start + i);
+      String::AsciiValue address(addresses->Get(start + i));
+      Datagram* d = &datagrams[valid];
+
+      if (!Buffer::HasInstance(buffer)) {
+        return scope.Close(ThrowException(String::New(
+            "Datagram should be a Buffer!")));
+      }
+
+      memset(&d->addr, 0, sizeof(d->addr));
+      d->addr.sin_family = AF_INET;
+      d->addr.sin_port = htons(ports->Get(start + i)->Uint32Value());
+
+      // Skip invalid addresses
+      if (*address == NULL ||
+          inet_pton(AF_INET, *address, &d->addr.sin_addr) != 1) {
+        continue;
+      }
+
+      d->data = Buffer::Data(buffer.As<Object>());
+      d->size = Buffer::Length(buffer.As<Object>());
+      valid++;
+    }
+
+    int r = u->socket_.Send(datagrams, valid);
+    if (r < 0) {
+      err = r;
+    } else {
+      sent += r;
+    }
+  }
+
+  return scope.Close(Number::New(sent == 0 && err != 0 ? err : sent));
+}
+
+
+Handle<Value> Udp::Close(const Arguments& args) {
+  HandleScope scope;
+
+  UNWRAP
+
+  if (u->poll_ != NULL) {
+    u->DoClose();
+    u->Unref();
+  }
+
+  return scope.Close(Null());
+}
+
+
+void Udp::OnPoll(uv_poll_t* handle, int status, int events) {
+  HandleScope scope;
+  Udp* u = reinterpret_cast<Udp*>(handle->data);
+  Datagram datagrams[Socket::kBatchSize];
+
+  if (status != 0) return;
+
+  // Drain socket, invoking JS once per batch
+  while (u->poll_ != NULL) {
+    int count = u->socket_.Receive(datagrams);
+    if (count <= 0) break;
+
+    Local<Array> buffers = Array::New(count);
+    Local<Array> addresses = Array::New(count);
+    Local<Array> ports = Array::New(count);
+
+    for (int i = 0; i < count; i++) {
+      char address[INET_ADDRSTRLEN];
+      Buffer* buffer = Buffer::New(datagrams[i].data, datagrams[i].size);
+
+      inet_ntop(AF_INET,
+                &datagrams[i].addr.sin_addr,
+                address,
+                sizeof(address));
+      buffers->Set(i, buffer->handle_);
+      addresses->Set(i, String::New(address));
+      ports->Set(i, Number::New(ntohs(datagrams[i].addr.sin_port)));
+    }
+
+    Handle<Value> argv[3] = { buffers, addresses, ports };
+    MakeCallback(u->handle_, onmessages_sym, 3, argv);
+  }
+}
+
+
+void Udp::Init(Handle<Object> target) {
+  HandleScope scope;
+
+  onmessages_sym = Persistent<String>::New(String::NewSymbol("onmessages"));
+
+  Local<FunctionTemplate> t = FunctionTemplate::New(Udp::New);
+
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->SetClassName(String::NewSymbol("Udp"));
+
+  NODE_SET_PROTOTYPE_METHOD(t, "bind", Udp::Bind);
+  NODE_SET_PROTOTYPE_METHOD(t, "send", Udp::Send);
+  NODE_SET_PROTOTYPE_METHOD(t, "close", Udp::Close);
+
+  target->Set(String::NewSymbol("Udp"), t->GetFunction());
+}
+
+} // namespace udp
+} // namespace vock
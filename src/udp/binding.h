@@ -0,0 +1,38 @@
+#ifndef _SRC_UDP_BINDING_H_
+#define _SRC_UDP_BINDING_H_
+
+#include "node.h"
+#include "v8.h"
+#include "node_object_wrap.h"
+#include "socket.h"
+
+namespace vock {
+namespace udp {
+
+using namespace node;
+
+class Udp : public ObjectWrap {
+ public:
+  Udp();
+  ~Udp();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static v8::Handle<v8::Value> New(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Bind(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Send(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Close(const v8::Arguments& args);
+
+  static void OnPoll(uv_poll_t* handle, int status, int events);
+
+ protected:
+  void DoClose();
+
+  Socket socket_;
+  uv_poll_t* poll_;
+};
+
+} // namespace udp
+} // namespace vock
+
+#endif // _SRC_UDP_BINDING_H_
@@ -0,0 +1,233 @@
+#include "socket.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h> // memset
+#include <unistd.h> // close
+
+namespace vock {
+namespace udp {
+
+Socket::Socket() : fd_(-1) {
+}
+
+
+Socket::~Socket() {
+  Close();
+}
+
+
+int Socket::Bind(uint16_t port) {
+  if (fd_ != -1) return -EINVAL;
+
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ == -1) return -errno;
+
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags == -1 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) == -1 ||
+      fcntl(fd_, F_SETFD, FD_CLOEXEC) == -1) {
+    int err = errno;
+    Close();
+    return -err;
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+
+  if (bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+    int err = errno;
+    Close();
+    return -err;
+  }
+
+  return 0;
+}
+
+
+int Socket::GetPort(uint16_t* port) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+
+  if (getsockname(fd_, reinterpret_cast<struct sockaddr*>(&addr), &len)) {
+    return -errno;
+  }
+  *port = ntohs(addr.sin_port);
+
+  return 0;
+}
+
+
+void Socket::Close() {
+  if (fd_ == -1) return;
+  close(fd_);
+  fd_ = -1;
+}
+
+
+#ifdef __linux__
+
+int Socket::Send(Datagram* datagrams, int count) {
+  struct mmsghdr msgs[kBatchSize];
+  struct iovec iovs[kBatchSize];
+  int done = 0;
+  int sent = 0;
+  int err = 0;
+
+  while (done < count) {
+    int batch = count - done;
+    if (batch > kBatchSize) batch = kBatchSize;
+
+    memset(msgs, 0, sizeof(msgs[0]) * batch);
+    for (int i = 0; i < batch; i++) {
+      Datagram* d = &datagrams[done + i];
+
+      iovs[i].iov_base = d->data;
+      iovs[i].iov_len = d->size;
+      msgs[i].msg_hdr.msg_name = &d->addr;
+      msgs[i].msg_hdr.msg_namelen = sizeof(d->addr);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int r;
+    do {
+      r = sendmmsg(fd_, msgs, batch, 0);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) {
+      // Socket buffer is full - drop the rest, it's realtime traffic
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+      // Skip the first datagram, it has failed (i.e. unreachable address)
+      err = -errno;
+      done++;
+      continue;
+    }
+
+    done += r;
+    sent += r;
+  }
+
+  return sent == 0 && err != 0 ? err : sent;
+}
+
+
+int Socket::Receive(Datagram* datagrams) {
+  struct mmsghdr msgs[kBatchSize];
+  struct iovec iovs[kBatchSize];
+  int count = 0;
+
+  // Retry if everything received was truncated
+  while (count == 0) {
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatchSize; i++) {
+      iovs[i].iov_base = buffers_[i];
+      iovs[i].iov_len = kMaxDatagramSize;
+      msgs[i].msg_hdr.msg_name = &datagrams[i].addr;
+      msgs[i].msg_hdr.msg_namelen = sizeof(datagrams[i].addr);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int r;
+    do {
+      r = recvmmsg(fd_, msgs, kBatchSize, 0, NULL);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+      return -errno;
+    }
+    if (r == 0) return 0;
+
+    // Compact, skipping truncated datagrams
+    for (int i = 0; i < r; i++) {
+      if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+
+      datagrams[count].data = buffers_[i];
+      datagrams[count].size = msgs[i].msg_len;
+      if (count != i) datagrams[count].addr = datagrams[i].addr;
+      count++;
+    }
+  }
+
+  return count;
+}
+
+#else // !__linux__
+
+int Socket::Send(Datagram* datagrams, int count) {
+  int sent = 0;
+  int err = 0;
+
+  for (int i = 0; i < count; i++) {
+    ssize_t r;
+    do {
+      r = sendto(fd_,
+                 datagrams[i].data,
+                 datagrams[i].size,
+                 0,
+                 reinterpret_cast<struct sockaddr*>(&datagrams[i].addr),
+                 sizeof(datagrams[i].addr));
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) {
+      // Socket buffer is full - drop the rest, it's realtime traffic
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+      err = -errno;
+      continue;
+    }
+    sent++;
+  }
+
+  return sent == 0 && err != 0 ? err : sent;
+}
+
+
+int Socket::Receive(Datagram* datagrams) {
+  int count = 0;
+
+  while (count < kBatchSize) {
+    struct msghdr msg;
+    struct iovec iov;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buffers_[count];
+    iov.iov_len = kMaxDatagramSize;
+    msg.msg_name = &datagrams[count].addr;
+    msg.msg_namelen = sizeof(datagrams[count].addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    ssize_t r;
+    do {
+      r = recvmsg(fd_, &msg, 0);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (count == 0) return -errno;
+      break;
+    }
+
+    if (msg.msg_flags & MSG_TRUNC) continue;
+
+    datagrams[count].data = buffers_[count];
+    datagrams[count].size = r;
+    count++;
+  }
+
+  return count;
+}
+
+#endif // __linux__
+
+} // namespace udp
+} // namespace vock
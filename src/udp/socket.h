@@ -0,0 +1,52 @@
+#ifndef _SRC_UDP_SOCKET_H_
+#define _SRC_UDP_SOCKET_H_
+
+#include <netinet/in.h> // sockaddr_in
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+namespace vock {
+namespace udp {
+
+struct Datagram {
+  char* data;
+  size_t size;
+  struct sockaddr_in addr;
+};
+
+// Non-blocking IPv4 UDP socket, sending and receiving datagrams in
+// batches: one sendmmsg()/recvmmsg() syscall per batch on linux,
+// plain sendto()/recvfrom() loop elsewhere.
+class Socket {
+ public:
+  static const int kBatchSize = 32;
+  static const size_t kMaxDatagramSize = 2048;
+
+  Socket();
+  ~Socket();
+
+  // Both return 0 or -errno
+  int Bind(uint16_t port);
+  int GetPort(uint16_t* port);
+  void Close();
+
+  // Returns number of sent datagrams or -errno,
+  // datagrams that can't be sent without blocking are dropped
+  int Send(Datagram* datagrams, int count);
+
+  // Receives up to kBatchSize datagrams into internal buffers
+  // (valid until next call), returns their count, 0 if there're no more
+  // or -errno. Truncated datagrams are dropped.
+  int Receive(Datagram* datagrams);
+
+  inline int fd() { return fd_; }
+
+ protected:
+  int fd_;
+  char buffers_[kBatchSize][kMaxDatagramSize];
+};
+
+} // namespace udp
+} // namespace vock
+
+#endif // _SRC_UDP_SOCKET_H_
@@ -1,5 +1,9 @@
 #include "audio/binding.h"
 #include "opus/binding.h"
+#include "frame/binding.h"
+#include "udp/binding.h"
+#include "relay/binding.h"
+#include "mcu/binding.h"
 
 #include "node.h"
 
@@ -10,6 +14,12 @@ using namespace node;
 static void Init(v8::Handle<v8::Object> target) {
   vock::audio::Audio::Init(target);
   vock::opus::Opus::Init(target);
+  vock::opus::Packet::Init(target);
+  vock::frame::Frame::Init(target);
+  vock::frame::Sealer::Init(target);
+  vock::udp::Udp::Init(target);
+  vock::relay::Server::Init(target);
+  vock::mcu::Mcu::Init(target);
 }
 
 NODE_MODULE(vock, Init);